@@ -1,6 +1,8 @@
 #include <iostream>
 #include <string>
+#include <cstdlib>
 #include "xfile_transcoder.h"
+#include "xsegment_worker.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -11,7 +13,16 @@ extern "C" {
 
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // ֶת workerxtranscoder --worker <Ŀ¼> [--numa-node <ڵ>]
+    if (argc >= 3 && std::string(argv[1]) == "--worker") {
+        XSegmentWorker worker;
+        if (argc >= 5 && std::string(argv[3]) == "--numa-node") {
+            worker.SetNumaNode(atoi(argv[4]));
+        }
+        return worker.Run(argv[2]) ? 0 : 1;
+    }
+
     XFileTranscoder trans = XFileTranscoder();
     for (int i = 0; i < 1; i++)
     {
@@ -0,0 +1,162 @@
+// xnuma_bench.cpp
+// NUMA û׼ͬһ벢ж XFileTranscoder 񣬷ֱڲú SetNumaPlacement()
+// ¸֣ýУٻزӰ죩Ƚ֡ʺ͵֡ʡ
+// ʱ󶨵ڵ㣬ʱɲϵͳȡ
+//
+// 룺g++ -std=c++17 -O2 -I.. xnuma_bench.cpp ../xfile_transcoder.cpp ../xdemuxer.cpp ../xmuxer.cpp
+//       ../xdecoder.cpp ../xencoder.cpp ../xcodec.cpp ../xavformat.cpp ../xlock_stats.cpp ../xlog.cpp ../xstats.cpp
+//       ../xspeed_controller.cpp ../xmemory_budget.cpp ../xnuma.cpp ../xframe_diff.cpp ../xpixel_ops.cpp
+//       ../xaudio_resampler.cpp ../xfilter_graph.cpp ../xconcat_source.cpp ../xtiled_scaler.cpp ../xquality_meter.cpp
+//       ../xframe_stats_writer.cpp ../xcomplexity_analyzer.cpp ../xframe_tap.cpp ../xpacket_trace.cpp
+//       ../xcheckpoint.cpp ../xtranscode_cache.cpp
+//       -lavformat -lavcodec -lswscale -lswresample -lavfilter -lavutil -lpthread -o xnuma_bench
+// У./xnuma_bench input.mp4 [jobs rounds width height]
+//       jobs ĬΪ NUMA ڵ x 2תΪ width x heightĬ 1280x720H.264
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include "xfile_transcoder.h"
+#include "xnuma.h"
+
+// תͳϢӡ std::coutڼ䶪
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c) override { return c; }
+};
+
+struct PassResult
+{
+	int failed{ 0 };
+	double wall_seconds{ 0 };
+	double aggregate_fps{ 0 };
+	double min_job_fps{ 0 };
+	double avg_job_fps{ 0 };
+	std::vector<int> jobs_per_node;		// ڵ󶨵δ󶨵Ĳƣ
+};
+
+static PassResult RunPass(const std::string& input, int jobs, bool numa, int width, int height)
+{
+	struct JobResult {
+		bool ok{ false };
+		int64_t frames{ 0 };
+		double seconds{ 0 };
+		int node{ -1 };
+	};
+	std::vector<JobResult> results(jobs);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < jobs; i++)
+	{
+		threads.emplace_back([&, i]() {
+			XFileTranscoder trans;
+			trans.SetNumaPlacement(numa);
+			std::string output = "xnuma_job" + std::to_string(i) + ".mp4";
+			results[i].ok = trans.Transcode(input, output, width, height, AV_CODEC_ID_H264, 2000);
+			results[i].frames = trans.GetStats().video_frames;
+			results[i].seconds = trans.GetStats().elapsed_seconds;
+			results[i].node = trans.GetStats().numa_node;
+			std::remove(output.c_str());
+		});
+	}
+	for (std::thread& t : threads) t.join();
+
+	PassResult pass;
+	pass.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	pass.jobs_per_node.assign(XNuma::Instance().node_count() > 0 ? XNuma::Instance().node_count() : 1, 0);
+	int64_t total_frames = 0;
+	pass.min_job_fps = -1;
+	for (const JobResult& r : results)
+	{
+		if (!r.ok || r.seconds <= 0)
+		{
+			pass.failed++;
+			continue;
+		}
+		double fps = r.frames / r.seconds;
+		total_frames += r.frames;
+		pass.avg_job_fps += fps;
+		if (pass.min_job_fps < 0 || fps < pass.min_job_fps) pass.min_job_fps = fps;
+		if (r.node >= 0 && r.node < (int)pass.jobs_per_node.size()) pass.jobs_per_node[r.node]++;
+	}
+	int succeeded = jobs - pass.failed;
+	if (succeeded > 0) pass.avg_job_fps /= succeeded;
+	if (pass.min_job_fps < 0) pass.min_job_fps = 0;
+	pass.aggregate_fps = total_frames / pass.wall_seconds;
+	return pass;
+}
+
+static void PrintPass(const char* name, int round, const PassResult& pass)
+{
+	std::string nodes;
+	for (size_t n = 0; n < pass.jobs_per_node.size(); n++)
+	{
+		if (pass.jobs_per_node[n] == 0) continue;
+		nodes += " n" + std::to_string(n) + ":" + std::to_string(pass.jobs_per_node[n]);
+	}
+	char buff[256] = { 0 };
+	snprintf(buff, sizeof(buff), "%-9s %5d %8.1f %8.1f/%-8.1f %8.2f %s%s",
+		name, round, pass.aggregate_fps, pass.min_job_fps, pass.avg_job_fps, pass.wall_seconds,
+		nodes.empty() ? "-" : nodes.c_str() + 1, pass.failed > 0 ? "  (jobs failed)" : "");
+	std::cout << buff << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: xnuma_bench input.mp4 [jobs rounds width height]" << std::endl;
+		return 1;
+	}
+	XNuma& numa = XNuma::Instance();
+	std::string input = argv[1];
+	int jobs = argc > 2 ? atoi(argv[2]) : (numa.node_count() > 1 ? numa.node_count() * 2 : 2);
+	int rounds = argc > 3 ? atoi(argv[3]) : 3;
+	int width = argc > 4 ? atoi(argv[4]) : 1280;
+	int height = argc > 5 ? atoi(argv[5]) : 720;
+	if (jobs < 1 || rounds < 1 || width < 16 || height < 16)
+	{
+		std::cerr << "Usage: xnuma_bench input.mp4 [jobs rounds width height]" << std::endl;
+		return 1;
+	}
+
+	std::cout << "NUMA nodes: " << numa.node_count() << ", jobs: " << jobs << ", rounds: " << rounds
+		<< ", output " << width << "x" << height << " H.264" << std::endl;
+	if (numa.node_count() < 2)
+	{
+		std::cout << "single node machine, placement is a no-op (both passes should match)" << std::endl;
+	}
+
+	std::cout << "policy    round  agg fps  job fps min/avg     wall  jobs per node" << std::endl;
+	double best_off = 0;
+	double best_on = 0;
+	NullBuffer null_buffer;
+	for (int r = 1; r <= rounds; r++)
+	{
+		for (bool placement : { false, true })
+		{
+			std::streambuf* saved = std::cout.rdbuf(&null_buffer);
+			PassResult pass = RunPass(input, jobs, placement, width, height);
+			std::cout.rdbuf(saved);
+			PrintPass(placement ? "numa" : "none", r, pass);
+			double& best = placement ? best_on : best_off;
+			if (pass.failed == 0 && pass.aggregate_fps > best) best = pass.aggregate_fps;
+		}
+	}
+
+	if (best_off <= 0 || best_on <= 0)
+	{
+		std::cerr << "Error: every round of a policy had failed jobs" << std::endl;
+		return 1;
+	}
+	// ȡõһֱȽ
+	std::cout << "best aggregate: none " << best_off << " fps, numa " << best_on << " fps, gain "
+		<< (best_on / best_off - 1) * 100 << "%" << std::endl;
+	return 0;
+}
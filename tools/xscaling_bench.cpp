@@ -0,0 +1,406 @@
+// xscaling_bench.cpp
+// չ׼ɺϳ루H.264 Ƶ + AAC Ƶβ 1..N  XFileTranscoder 
+// ÿͳ֡ʡ֡ʡCPU ʡлֵڴ XCodec/XAvFormat 
+// ҳ֡ʲı͵㣨ɳеĲ
+//
+// 룺g++ -std=c++17 -O2 -I.. xscaling_bench.cpp ../xfile_transcoder.cpp ../xdemuxer.cpp ../xmuxer.cpp
+//       ../xdecoder.cpp ../xencoder.cpp ../xcodec.cpp ../xavformat.cpp ../xlock_stats.cpp ../xlog.cpp ../xstats.cpp
+//       ../xspeed_controller.cpp ../xmemory_budget.cpp ../xnuma.cpp ../xframe_diff.cpp ../xpixel_ops.cpp
+//       ../xaudio_resampler.cpp ../xfilter_graph.cpp ../xconcat_source.cpp ../xtiled_scaler.cpp ../xquality_meter.cpp
+//       ../xframe_stats_writer.cpp ../xcomplexity_analyzer.cpp ../xframe_tap.cpp ../xpacket_trace.cpp
+//       ../xcheckpoint.cpp ../xtranscode_cache.cpp
+//       -lavformat -lavcodec -lswscale -lswresample -lavfilter -lavutil -lpthread -o xscaling_bench
+// У./xscaling_bench [max_jobs seconds width height]
+//       max_jobs ĬΪ CPU Ϊ seconds  width x height 25fps ϳƬԴתΪ 1280x720 H.264
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include "xfile_transcoder.h"
+#include "xencoder.h"
+#include "xmuxer.h"
+#include "xlock_stats.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+}
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+static const double kPi = 3.14159265358979323846;
+static const int kFps = 25;
+static const int kOutputWidth = 1280;
+static const int kOutputHeight = 720;
+// ֡ʴﵽֵĸñΪ
+static const double kSaturationRatio = 0.95;
+
+// Դ̺߳ϼƣ
+struct Usage
+{
+	double cpu_seconds{ 0 };
+	int64_t context_switches{ -1 };		// ƽ̨ṩʱΪ -1
+	int64_t peak_rss_kb{ 0 };
+};
+
+// ֵڴ水ͳƣLinux д /proc/self/clear_refs  VmHWMƽ̨Ϊڵķֵ
+static void ResetPeakRss()
+{
+#ifdef __linux__
+	FILE* file = fopen("/proc/self/clear_refs", "w");
+	if (file)
+	{
+		fputs("5", file);
+		fclose(file);
+	}
+#endif
+}
+
+static Usage ReadUsage()
+{
+	Usage usage;
+#ifdef _WIN32
+	FILETIME create_time, exit_time, kernel_time, user_time;
+	if (GetProcessTimes(GetCurrentProcess(), &create_time, &exit_time, &kernel_time, &user_time))
+	{
+		auto to_seconds = [](const FILETIME& t) {
+			return (((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) / 1e7;
+		};
+		usage.cpu_seconds = to_seconds(kernel_time) + to_seconds(user_time);
+	}
+	PROCESS_MEMORY_COUNTERS mem{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &mem, sizeof(mem)))
+	{
+		usage.peak_rss_kb = (int64_t)(mem.PeakWorkingSetSize / 1024);
+	}
+#else
+	rusage ru{};
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+	{
+		usage.cpu_seconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+		usage.context_switches = ru.ru_nvcsw + ru.ru_nivcsw;
+		usage.peak_rss_kb = ru.ru_maxrss;
+	}
+#ifdef __linux__
+	FILE* file = fopen("/proc/self/status", "r");
+	if (file)
+	{
+		char line[256];
+		long long kb = 0;
+		while (fgets(line, sizeof(line), file))
+		{
+			if (sscanf(line, "VmHWM: %lld kB", &kb) == 1) usage.peak_rss_kb = kb;
+		}
+		fclose(file);
+	}
+#endif
+#endif
+	return usage;
+}
+
+// תͳϢӡ std::coutڼ䶪
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c) override { return c; }
+};
+
+static uint32_t XorShift(uint32_t& seed)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// ˶Ľ + ÿ֡ввɱ࣬ʵƬԴӽ
+static void FillVideoFrame(AVFrame* frame, int index, uint32_t& seed)
+{
+	av_frame_make_writable(frame);
+	for (int y = 0; y < frame->height; y++)
+	{
+		uint8_t* row = frame->data[0] + y * frame->linesize[0];
+		for (int x = 0; x < frame->width; x++)
+		{
+			row[x] = (uint8_t)(((x + 2 * index) ^ (y + index)) + (XorShift(seed) & 15));
+		}
+	}
+	for (int plane = 1; plane < 3; plane++)
+	{
+		for (int y = 0; y < frame->height / 2; y++)
+		{
+			uint8_t* row = frame->data[plane] + y * frame->linesize[plane];
+			for (int x = 0; x < frame->width / 2; x++)
+			{
+				row[x] = (uint8_t)(128 + ((x + y + index * plane) & 63) - 32);
+			}
+		}
+	}
+	frame->pts = index;
+}
+
+// ʽΪƽʽAAC ǣ
+static void FillAudioFrame(AVFrame* frame, int64_t first_sample)
+{
+	av_frame_make_writable(frame);
+	for (int c = 0; c < frame->ch_layout.nb_channels; c++)
+	{
+		float* samples = (float*)frame->extended_data[c];
+		for (int i = 0; i < frame->nb_samples; i++)
+		{
+			samples[i] = (float)(0.3 * sin(2 * kPi * 440 * (first_sample + i) / frame->sample_rate));
+		}
+	}
+	frame->pts = first_sample;
+}
+
+// ȡеİдװflush ʱ frame Ϊ nullptr
+static bool EncodeAndWrite(XEncoder& encoder, AVFrame* frame, XMuxer& muxer, int stream_index, AVPacket* pkt)
+{
+	if (encoder.SendFrame(frame) == XEncoder::SendResult::Failed) return false;
+	while (true)
+	{
+		auto ret = encoder.ReceivePacket(pkt);
+		if (ret == XEncoder::ReceiveResult::Failed) return false;
+		if (ret != XEncoder::ReceiveResult::Success) return true;
+		pkt->stream_index = stream_index;
+		av_packet_rescale_ts(pkt, encoder.GetContext()->time_base,
+			muxer.GetAVFormatContext()->streams[stream_index]->time_base);
+		if (!muxer.Write(pkt)) return false;
+	}
+}
+
+static bool WriteSyntheticInput(const std::string& path, int width, int height, int seconds)
+{
+	XEncoder video;
+	XEncoder audio;
+	XMuxer muxer;
+	AVFrame* video_frame = nullptr;
+	AVFrame* audio_frame = nullptr;
+	AVPacket* pkt = av_packet_alloc();
+	bool ok = false;
+	uint32_t seed = 0x2545f491;
+	int64_t audio_samples = 0;
+	int frames = seconds * kFps;
+
+	if (!video.Create(AV_CODEC_ID_H264) || !audio.Create(AV_CODEC_ID_AAC))
+	{
+		std::cerr << "Error: H.264/AAC encoder not found" << std::endl;
+		goto cleanup;
+	}
+	video.SetVideoParam(width, height, AV_PIX_FMT_YUV420P);
+	video.SetTimeBase(1, kFps);
+	video.SetFrameRate(kFps, 1);
+	video.SetBitRate((int64_t)width * height * kFps / 8);
+	video.SetGopSize(kFps * 2);
+	video.GetContext()->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	audio.GetContext()->sample_rate = 48000;
+	audio.GetContext()->sample_fmt = AV_SAMPLE_FMT_FLTP;
+	av_channel_layout_default(&audio.GetContext()->ch_layout, 2);
+	audio.SetTimeBase(1, 48000);
+	audio.SetBitRate(128000);
+	audio.GetContext()->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	if (!video.Open() || !audio.Open() ||
+		!muxer.Open(path, video.GetContext(), audio.GetContext()) || !muxer.WriteHeader())
+	{
+		std::cerr << "Error: open synthetic input '" << path << "' failed" << std::endl;
+		goto cleanup;
+	}
+
+	video_frame = video.CreateFrame();
+	audio_frame = av_frame_alloc();
+	audio_frame->nb_samples = audio.GetContext()->frame_size > 0 ? audio.GetContext()->frame_size : 1024;
+	audio_frame->format = AV_SAMPLE_FMT_FLTP;
+	audio_frame->sample_rate = 48000;
+	av_channel_layout_copy(&audio_frame->ch_layout, &audio.GetContext()->ch_layout);
+	if (!video_frame || av_frame_get_buffer(audio_frame, 0) < 0) goto cleanup;
+
+	for (int i = 0; i < frames; i++)
+	{
+		FillVideoFrame(video_frame, i, seed);
+		if (!EncodeAndWrite(video, video_frame, muxer, muxer.video_index(), pkt)) goto cleanup;
+		// ƵƵʱ
+		while (audio_samples * kFps < (int64_t)(i + 1) * 48000)
+		{
+			FillAudioFrame(audio_frame, audio_samples);
+			audio_samples += audio_frame->nb_samples;
+			if (!EncodeAndWrite(audio, audio_frame, muxer, muxer.audio_index(), pkt)) goto cleanup;
+		}
+	}
+	ok = EncodeAndWrite(video, nullptr, muxer, muxer.video_index(), pkt) &&
+		EncodeAndWrite(audio, nullptr, muxer, muxer.audio_index(), pkt) &&
+		muxer.WriteTrailer();
+
+cleanup:
+	muxer.Close();
+	video.Close();
+	audio.Close();
+	av_frame_free(&video_frame);
+	av_frame_free(&audio_frame);
+	av_packet_free(&pkt);
+	return ok;
+}
+
+struct LevelResult
+{
+	int jobs{ 0 };
+	int failed{ 0 };
+	double wall_seconds{ 0 };
+	double aggregate_fps{ 0 };
+	double min_job_fps{ 0 };
+	double avg_job_fps{ 0 };
+	double cpu_percent{ 0 };			// ռȫı
+	double switches_per_second{ -1 };
+	int64_t peak_rss_kb{ 0 };
+	int64_t codec_contended{ 0 };
+	int64_t format_contended{ 0 };
+	double lock_wait_percent{ 0 };		// ȴʱռʱ֮͵ı
+};
+
+static LevelResult RunLevel(const std::string& input, int jobs)
+{
+	struct JobResult {
+		bool ok{ false };
+		int64_t frames{ 0 };
+		double seconds{ 0 };
+	};
+	std::vector<JobResult> results(jobs);
+
+	XLockStats::Codec().Reset();
+	XLockStats::Format().Reset();
+	ResetPeakRss();
+	Usage before = ReadUsage();
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < jobs; i++)
+	{
+		threads.emplace_back([&input, &results, i]() {
+			XFileTranscoder trans;
+			std::string output = "xscaling_job" + std::to_string(i) + ".mp4";
+			results[i].ok = trans.Transcode(input, output, kOutputWidth, kOutputHeight, AV_CODEC_ID_H264, 2000, kFps);
+			results[i].frames = trans.GetStats().video_frames;
+			results[i].seconds = trans.GetStats().elapsed_seconds;
+			std::remove(output.c_str());
+		});
+	}
+	for (std::thread& t : threads) t.join();
+
+	LevelResult level;
+	level.jobs = jobs;
+	level.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	Usage after = ReadUsage();
+
+	int64_t total_frames = 0;
+	double job_seconds = 0;
+	level.min_job_fps = -1;
+	for (const JobResult& r : results)
+	{
+		if (!r.ok || r.seconds <= 0)
+		{
+			level.failed++;
+			continue;
+		}
+		double fps = r.frames / r.seconds;
+		total_frames += r.frames;
+		job_seconds += r.seconds;
+		level.avg_job_fps += fps;
+		if (level.min_job_fps < 0 || fps < level.min_job_fps) level.min_job_fps = fps;
+	}
+	int succeeded = jobs - level.failed;
+	if (succeeded > 0) level.avg_job_fps /= succeeded;
+	if (level.min_job_fps < 0) level.min_job_fps = 0;
+	level.aggregate_fps = total_frames / level.wall_seconds;
+
+	unsigned int cores = std::thread::hardware_concurrency();
+	level.cpu_percent = (after.cpu_seconds - before.cpu_seconds) / (level.wall_seconds * (cores > 0 ? cores : 1)) * 100;
+	if (before.context_switches >= 0)
+	{
+		level.switches_per_second = (after.context_switches - before.context_switches) / level.wall_seconds;
+	}
+	level.peak_rss_kb = after.peak_rss_kb;
+	level.codec_contended = XLockStats::Codec().contended;
+	level.format_contended = XLockStats::Format().contended;
+	double wait_seconds = (XLockStats::Codec().wait_ns + XLockStats::Format().wait_ns) / 1e9;
+	level.lock_wait_percent = job_seconds > 0 ? wait_seconds / job_seconds * 100 : 0;
+	return level;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	int max_jobs = argc > 1 ? atoi(argv[1]) : (cores > 0 ? (int)cores : 4);
+	int seconds = argc > 2 ? atoi(argv[2]) : 10;
+	int width = argc > 3 ? atoi(argv[3]) : 1920;
+	int height = argc > 4 ? atoi(argv[4]) : 1080;
+	if (max_jobs < 1 || seconds < 1 || width < 16 || height < 16)
+	{
+		std::cerr << "Usage: xscaling_bench [max_jobs seconds width height]" << std::endl;
+		return 1;
+	}
+
+	const std::string input = "xscaling_input.mp4";
+	std::cout << "synthetic input: " << width << "x" << height << " " << kFps << "fps H.264 + AAC, "
+		<< seconds << "s; output " << kOutputWidth << "x" << kOutputHeight << " H.264; "
+		<< cores << " cores" << std::endl;
+	if (!WriteSyntheticInput(input, width, height, seconds))
+	{
+		std::cerr << "Error: write synthetic input failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "jobs  agg fps  job fps min/avg  scaling   cpu%   csw/s  peak MB  codec lk  format lk  lk wait%" << std::endl;
+	std::vector<LevelResult> levels;
+	NullBuffer null_buffer;
+	for (int jobs = 1; jobs <= max_jobs; jobs++)
+	{
+		std::streambuf* saved = std::cout.rdbuf(&null_buffer);
+		LevelResult level = RunLevel(input, jobs);
+		std::cout.rdbuf(saved);
+		levels.push_back(level);
+
+		// չЧʣ֡ 1 ֡ x 
+		double scaling = levels[0].aggregate_fps > 0 ? level.aggregate_fps / (levels[0].aggregate_fps * jobs) : 0;
+		char buff[256] = { 0 };
+		snprintf(buff, sizeof(buff), "%4d %8.1f %8.1f/%-8.1f %7.0f%% %6.1f %7.0f %8.1f %9lld %10lld %9.2f%s",
+			jobs, level.aggregate_fps, level.min_job_fps, level.avg_job_fps, scaling * 100, level.cpu_percent,
+			level.switches_per_second, level.peak_rss_kb / 1024.0,
+			(long long)level.codec_contended, (long long)level.format_contended, level.lock_wait_percent,
+			level.failed > 0 ? "  (jobs failed)" : "");
+		std::cout << buff << std::endl;
+	}
+	std::remove(input.c_str());
+
+	// ͵㣺֡ʴﵽֵ kSaturationRatio 
+	double best = 0;
+	for (const LevelResult& level : levels) best = std::max(best, level.aggregate_fps);
+	for (const LevelResult& level : levels)
+	{
+		if (best > 0 && level.aggregate_fps >= best * kSaturationRatio)
+		{
+			std::cout << "saturation: " << level.jobs << " concurrent jobs (" << level.aggregate_fps
+				<< " fps aggregate, best " << best << " fps)" << std::endl;
+			if (level.jobs == max_jobs)
+			{
+				std::cout << "not saturated yet, rerun with a larger max_jobs" << std::endl;
+			}
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,813 @@
+// xtrace_replay.cpp
+// ׷ٻطţȡ XFileTranscoder::SetPacketTrace() ¼׷ļ
+// Ѽ¼İаԭ˳ XDecoder -> XEncoder -> XMuxerȡ׷ļͷеת
+// Աȼ¼뱾ػطŵĸ׶κʱڱĺʱ֡
+//
+//   info   ׷ٸſʡؼ֡׶κʱϼƣİ
+//   dump    CSV ÿ¼
+//   synth  Ϊݵ׷ɺϳɸأԭıʽֱʡʡʱ͹ؼ֡λ
+//          ϳɻ棨ǿԭС仯ͺϳƵ滻¼ҪԭƬԴ
+//   run    طţҪݣ¼ʱ with_data  synth ɣ--pace ¼ĶʱͰͣ
+//
+// 룺g++ -std=c++17 -O2 -I.. xtrace_replay.cpp ../xpacket_trace.cpp ../xdecoder.cpp ../xencoder.cpp ../xcodec.cpp
+//       ../xmuxer.cpp ../xavformat.cpp ../xlock_stats.cpp ../xaudio_resampler.cpp ../xmemory_budget.cpp ../xlog.cpp
+//       -lavformat -lavcodec -lswscale -lswresample -lavutil -lpthread -o xtrace_replay
+// У./xtrace_replay info job.trace
+//       ./xtrace_replay synth job.trace job_synth.trace
+//       ./xtrace_replay run job_synth.trace replay.mp4 [--pace]
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include "xpacket_trace.h"
+#include "xdecoder.h"
+#include "xencoder.h"
+#include "xmuxer.h"
+#include "xaudio_resampler.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+static const double kPi = 3.14159265358979323846;
+
+static int64_t NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ¼ʱʱpts ȱʧʱ dts
+static int64_t RecordTime(const XTraceRecord& rec)
+{
+	return rec.pts != AV_NOPTS_VALUE ? rec.pts : rec.dts;
+}
+
+// һİͳ
+struct StreamSummary
+{
+	int64_t packets{ 0 };
+	int64_t keyframes{ 0 };
+	int64_t bytes{ 0 };
+	int64_t first{ AV_NOPTS_VALUE };	// 硢ʱʱ
+	int64_t end{ AV_NOPTS_VALUE };
+
+	double seconds(AVRational tb) const
+	{
+		return (first == AV_NOPTS_VALUE || end <= first) ? 0 : (end - first) * av_q2d(tb);
+	}
+	double kbps(AVRational tb) const
+	{
+		double s = seconds(tb);
+		return s > 0 ? bytes * 8 / s / 1000 : 0;
+	}
+};
+
+static void Accumulate(StreamSummary& s, const XTraceRecord& rec)
+{
+	s.packets++;
+	s.bytes += rec.size;
+	if (rec.flags & AV_PKT_FLAG_KEY) s.keyframes++;
+	int64_t t = RecordTime(rec);
+	if (t == AV_NOPTS_VALUE) return;
+	if (s.first == AV_NOPTS_VALUE || t < s.first) s.first = t;
+	int64_t end = t + (rec.duration > 0 ? rec.duration : 0);
+	if (s.end == AV_NOPTS_VALUE || end > s.end) s.end = end;
+}
+
+static bool Summarize(XPacketTraceReader& reader, std::vector<StreamSummary>& streams)
+{
+	streams.assign(reader.inputs().size(), StreamSummary());
+	if (!reader.Rewind()) return false;
+	XTraceRecord rec;
+	while (reader.Next(rec))
+	{
+		if (rec.stream >= 0 && rec.stream < (int)streams.size()) Accumulate(streams[rec.stream], rec);
+	}
+	return reader.Rewind();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// info / dump
+
+static int Info(const std::string& path)
+{
+	XPacketTraceReader reader;
+	if (!reader.Open(path)) return 1;
+
+	std::vector<StreamSummary> streams(reader.inputs().size());
+	int64_t records = 0;
+	int64_t read_us = 0, decode_us = 0, encode_us = 0, last_us = 0;
+	std::vector<XTraceRecord> slowest;
+	XTraceRecord rec;
+	while (reader.Next(rec))
+	{
+		records++;
+		if (rec.stream >= 0 && rec.stream < (int)streams.size()) Accumulate(streams[rec.stream], rec);
+		read_us += rec.read_us;
+		decode_us += rec.decode_us;
+		encode_us += rec.encode_us;
+		last_us = std::max(last_us, rec.time_us + rec.read_us + rec.decode_us + rec.encode_us);
+
+		// ܺʱ 10 
+		slowest.push_back(rec);
+		auto slower = [](const XTraceRecord& a, const XTraceRecord& b) {
+			return a.read_us + a.decode_us + a.encode_us > b.read_us + b.decode_us + b.encode_us;
+		};
+		std::sort(slowest.begin(), slowest.end(), slower);
+		if (slowest.size() > 10) slowest.pop_back();
+	}
+
+	const XTraceHeader& header = reader.header();
+	printf("trace: %s, %lld packets%s\n", path.c_str(), (long long)records,
+		reader.has_data() ? ", with packet data" : "");
+	for (size_t i = 0; i < reader.inputs().size(); i++)
+	{
+		const XTraceStream& st = reader.inputs()[i].stream;
+		const StreamSummary& s = streams[i];
+		const char* role = (int)i == header.video_index ? " (video)" : (int)i == header.audio_index ? " (audio)" : "";
+		printf("  input %zu%s: %s", i, role, avcodec_get_name((AVCodecID)st.codec_id));
+		if (st.media_type == AVMEDIA_TYPE_VIDEO) printf(" %dx%d", st.width, st.height);
+		if (st.media_type == AVMEDIA_TYPE_AUDIO) printf(" %d Hz %d ch", st.sample_rate, st.channels);
+		AVRational tb = reader.inputs()[i].time_base();
+		printf(", %lld packets, %lld key, %.2fs, %.0f kbps\n", (long long)s.packets, (long long)s.keyframes,
+			s.seconds(tb), s.kbps(tb));
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		const XTraceStream& st = reader.output(i).stream;
+		if (st.codec_id == AV_CODEC_ID_NONE) continue;
+		printf("  output %s: %s", i == 0 ? "video" : "audio", avcodec_get_name((AVCodecID)st.codec_id));
+		if (i == 0) printf(" %dx%d", st.width, st.height);
+		else printf(" %d Hz %d ch", st.sample_rate, st.channels);
+		printf(", %lld kbps\n", (long long)(st.bit_rate / 1000));
+	}
+	printf("stages: read %.3fs, decode %.3fs, encode %.3fs, wall %.3fs\n",
+		read_us / 1e6, decode_us / 1e6, encode_us / 1e6, last_us / 1e6);
+	printf("slowest packets:\n");
+	for (const XTraceRecord& r : slowest)
+	{
+		printf("  #%lld stream %d at %.3fs: read %.3fms, decode %.3fms, encode %.3fms, %d bytes%s\n",
+			(long long)r.index, r.stream, r.time_us / 1e6, r.read_us / 1e3, r.decode_us / 1e3, r.encode_us / 1e3,
+			r.size, (r.flags & AV_PKT_FLAG_KEY) ? " key" : "");
+	}
+	return 0;
+}
+
+static int Dump(const std::string& path)
+{
+	XPacketTraceReader reader;
+	if (!reader.Open(path)) return 1;
+	printf("index,stream,pts,dts,duration,size,key,time_us,read_us,decode_us,encode_us,frames\n");
+	XTraceRecord rec;
+	while (reader.Next(rec))
+	{
+		printf("%lld,%d,%lld,%lld,%lld,%d,%d,%lld,%d,%d,%d,%d\n",
+			(long long)rec.index, rec.stream, (long long)rec.pts, (long long)rec.dts, (long long)rec.duration,
+			rec.size, (rec.flags & AV_PKT_FLAG_KEY) ? 1 : 0, (long long)rec.time_us,
+			rec.read_us, rec.decode_us, rec.encode_us, rec.frames);
+	}
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// synthϳɸ
+
+// ϳһİԭıʽͲ˳滻ԭ¼ĸ
+struct SynthStream
+{
+	XEncoder encoder;
+	bool opened{ false };
+	bool audio{ false };
+	AVRational stream_tb{ 1, 1 };		// ԭʱ¼еʱ
+	AVFrame* frame{ nullptr };
+	std::deque<AVPacket*> packets;
+	bool flushed{ false };
+	uint32_t seed{ 12345 };
+
+	// Ƶ pts ֡ʱԭСǷؼ֡
+	struct Frame {
+		int64_t pts;
+		int size;
+		bool key;
+	};
+	std::vector<Frame> frames;
+	size_t next_frame{ 0 };
+	double avg_size{ 1 };
+
+	// ƵϳɵĲ
+	int64_t next_sample{ 0 };
+	int64_t total_samples{ 0 };
+};
+
+static uint32_t NextRandom(uint32_t& seed)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static bool OpenVideoSynth(SynthStream& synth, const XTraceStreamInfo& info, const StreamSummary& summary)
+{
+	const XTraceStream& st = info.stream;
+	if (!synth.encoder.Create((AVCodecID)st.codec_id))
+	{
+		std::cerr << "Warning: no encoder for " << avcodec_get_name((AVCodecID)st.codec_id)
+			<< ", video packets left without data" << std::endl;
+		return false;
+	}
+	AVCodecContext* ctx = synth.encoder.GetContext();
+	// ԭʽ֧ʱȡĵһʽ
+	AVPixelFormat pix_fmt = (AVPixelFormat)st.format;
+	if (ctx->codec->pix_fmts)
+	{
+		bool supported = false;
+		for (const AVPixelFormat* p = ctx->codec->pix_fmts; *p != AV_PIX_FMT_NONE; p++)
+		{
+			if (*p == pix_fmt) supported = true;
+		}
+		if (!supported) pix_fmt = ctx->codec->pix_fmts[0];
+	}
+	synth.stream_tb = info.time_base();
+	synth.encoder.SetVideoParam(st.width, st.height, pix_fmt);
+	synth.encoder.SetTimeBase(synth.stream_tb);
+	if (st.frame_rate_num > 0 && st.frame_rate_den > 0) synth.encoder.SetFrameRate(info.frame_rate());
+	double kbps = summary.kbps(synth.stream_tb);
+	if (kbps > 0) synth.encoder.SetBitRate((int64_t)(kbps * 1000));
+	// û B ֡ pts ˳֡һһӦؼ֡ɼ¼
+	ctx->max_b_frames = 0;
+	ctx->gop_size = 100000;
+	ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	if (!synth.encoder.Open())
+	{
+		std::cerr << "Warning: synthetic video encoder open failed" << std::endl;
+		synth.encoder.Close();
+		return false;
+	}
+	synth.frame = av_frame_alloc();
+	synth.frame->width = ctx->width;
+	synth.frame->height = ctx->height;
+	synth.frame->format = ctx->pix_fmt;
+	if (av_frame_get_buffer(synth.frame, 0) < 0) return false;
+
+	std::sort(synth.frames.begin(), synth.frames.end(),
+		[](const SynthStream::Frame& a, const SynthStream::Frame& b) { return a.pts < b.pts; });
+	double total = 0;
+	for (const SynthStream::Frame& f : synth.frames) total += f.size;
+	synth.avg_size = synth.frames.empty() ? 1 : std::max(1.0, total / synth.frames.size());
+	synth.opened = true;
+	return true;
+}
+
+static bool OpenAudioSynth(SynthStream& synth, const XTraceStreamInfo& info, const StreamSummary& summary)
+{
+	const XTraceStream& st = info.stream;
+	if (st.sample_rate <= 0 || st.channels <= 0 || !synth.encoder.Create((AVCodecID)st.codec_id))
+	{
+		std::cerr << "Warning: no encoder for " << avcodec_get_name((AVCodecID)st.codec_id)
+			<< ", audio packets left without data" << std::endl;
+		return false;
+	}
+	AVCodecContext* ctx = synth.encoder.GetContext();
+	ctx->sample_rate = st.sample_rate;
+	ctx->sample_fmt = ctx->codec->sample_fmts ? ctx->codec->sample_fmts[0] : (AVSampleFormat)st.format;
+	av_channel_layout_default(&ctx->ch_layout, st.channels);
+	synth.stream_tb = info.time_base();
+	synth.encoder.SetTimeBase(1, st.sample_rate);
+	double kbps = summary.kbps(synth.stream_tb);
+	if (kbps > 0) synth.encoder.SetBitRate((int64_t)(kbps * 1000));
+	ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	if (!synth.encoder.Open())
+	{
+		std::cerr << "Warning: synthetic audio encoder open failed" << std::endl;
+		synth.encoder.Close();
+		return false;
+	}
+	synth.frame = av_frame_alloc();
+	synth.frame->nb_samples = ctx->frame_size > 0 ? ctx->frame_size : 1024;
+	synth.frame->format = ctx->sample_fmt;
+	synth.frame->sample_rate = ctx->sample_rate;
+	av_channel_layout_copy(&synth.frame->ch_layout, &ctx->ch_layout);
+	if (av_frame_get_buffer(synth.frame, 0) < 0) return false;
+
+	synth.audio = true;
+	synth.total_samples = (int64_t)(summary.seconds(synth.stream_tb) * st.sample_rate);
+	synth.opened = true;
+	return true;
+}
+
+// ϳɻ棺ƽƵĽǿԭС仯İС֮
+static void FillVideoFrame(SynthStream& synth, const SynthStream::Frame& f)
+{
+	AVFrame* frame = synth.frame;
+	av_frame_make_writable(frame);
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+	int amplitude = (int)std::min(96.0, 24.0 * f.size / synth.avg_size);
+	int shift = (int)(synth.next_frame * 2);
+	for (int p = 0; p < AV_NUM_DATA_POINTERS && frame->data[p]; p++)
+	{
+		bool chroma = (p == 1 || p == 2) && desc && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+		int rows = chroma ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+		for (int y = 0; y < rows; y++)
+		{
+			uint8_t* line = frame->data[p] + (int64_t)y * frame->linesize[p];
+			for (int x = 0; x < frame->linesize[p]; x++)
+			{
+				int base = chroma ? 128 : ((x + y + shift) & 0xFF);
+				int noise = amplitude > 0 ? (int)(NextRandom(synth.seed) % (amplitude + 1)) - amplitude / 2 : 0;
+				line[x] = (uint8_t)std::max(0, std::min(255, base + noise));
+			}
+		}
+	}
+	frame->pts = f.pts;
+	frame->pict_type = f.key ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+}
+
+// ϳƵ440Hz ңʽ
+static void FillAudioFrame(SynthStream& synth)
+{
+	AVFrame* frame = synth.frame;
+	av_frame_make_writable(frame);
+	AVSampleFormat fmt = (AVSampleFormat)frame->format;
+	int channels = frame->ch_layout.nb_channels;
+	bool planar = av_sample_fmt_is_planar(fmt) != 0;
+	AVSampleFormat packed = av_get_packed_sample_fmt(fmt);
+	for (int i = 0; i < frame->nb_samples; i++)
+	{
+		double v = 0.3 * sin(2 * kPi * 440 * (synth.next_sample + i) / frame->sample_rate);
+		for (int c = 0; c < channels; c++)
+		{
+			uint8_t* plane = frame->extended_data[planar ? c : 0];
+			int index = planar ? i : i * channels + c;
+			if (packed == AV_SAMPLE_FMT_FLT) ((float*)plane)[index] = (float)v;
+			else if (packed == AV_SAMPLE_FMT_DBL) ((double*)plane)[index] = v;
+			else if (packed == AV_SAMPLE_FMT_S16) ((int16_t*)plane)[index] = (int16_t)(v * 32767);
+			else if (packed == AV_SAMPLE_FMT_S32) ((int32_t*)plane)[index] = (int32_t)(v * 2147483647.0);
+			else if (packed == AV_SAMPLE_FMT_U8) plane[index] = (uint8_t)(128 + v * 127);
+		}
+	}
+	int64_t pts = av_rescale_q(synth.next_sample, AVRational{ 1, frame->sample_rate }, synth.encoder.GetContext()->time_base);
+	frame->pts = pts;
+	synth.next_sample += frame->nb_samples;
+}
+
+// ȡеİʱתΪԭʱ
+static bool ReceiveSynthPackets(SynthStream& synth)
+{
+	while (true)
+	{
+		AVPacket* pkt = av_packet_alloc();
+		auto ret = synth.encoder.ReceivePacket(pkt);
+		if (ret != XEncoder::ReceiveResult::Success)
+		{
+			av_packet_free(&pkt);
+			return ret != XEncoder::ReceiveResult::Failed;
+		}
+		av_packet_rescale_ts(pkt, synth.encoder.GetContext()->time_base, synth.stream_tb);
+		synth.packets.push_back(pkt);
+	}
+}
+
+// һϳɰûʱ֡ȫ֡ˢ£ûиİʱ nullptr
+static AVPacket* NextSynthPacket(SynthStream& synth)
+{
+	while (synth.packets.empty() && !synth.flushed)
+	{
+		AVFrame* frame = nullptr;
+		if (!synth.audio && synth.next_frame < synth.frames.size())
+		{
+			FillVideoFrame(synth, synth.frames[synth.next_frame++]);
+			frame = synth.frame;
+		}
+		else if (synth.audio && synth.next_sample < synth.total_samples)
+		{
+			FillAudioFrame(synth);
+			frame = synth.frame;
+		}
+		auto send_ret = synth.encoder.SendFrame(frame);
+		if (!frame || send_ret == XEncoder::SendResult::Ended) synth.flushed = true;
+		if (send_ret == XEncoder::SendResult::Failed || !ReceiveSynthPackets(synth))
+		{
+			synth.flushed = true;
+			break;
+		}
+	}
+	if (synth.packets.empty()) return nullptr;
+	AVPacket* pkt = synth.packets.front();
+	synth.packets.pop_front();
+	return pkt;
+}
+
+static void CloseSynth(SynthStream& synth)
+{
+	for (AVPacket* pkt : synth.packets) av_packet_free(&pkt);
+	synth.packets.clear();
+	av_frame_free(&synth.frame);
+	if (synth.opened) synth.encoder.Close();
+}
+
+static int Synth(const std::string& in_path, const std::string& out_path)
+{
+	XPacketTraceReader reader;
+	if (!reader.Open(in_path)) return 1;
+	std::vector<StreamSummary> streams;
+	if (!Summarize(reader, streams)) return 1;
+
+	const XTraceHeader& header = reader.header();
+	SynthStream synth[2];
+	int indexes[2] = { header.video_index, header.audio_index };
+
+	// Ƶ֡б pts ͱ
+	XTraceRecord rec;
+	while (reader.Next(rec))
+	{
+		if (rec.stream == header.video_index && RecordTime(rec) != AV_NOPTS_VALUE)
+		{
+			synth[0].frames.push_back({ RecordTime(rec), rec.size, (rec.flags & AV_PKT_FLAG_KEY) != 0 });
+		}
+	}
+	reader.Rewind();
+
+	std::vector<XTraceStreamInfo> inputs = reader.inputs();
+	for (int i = 0; i < 2; i++)
+	{
+		int s = indexes[i];
+		if (s < 0 || s >= (int)inputs.size()) continue;
+		bool ok = (i == 0) ? OpenVideoSynth(synth[i], inputs[s], streams[s])
+			: OpenAudioSynth(synth[i], inputs[s], streams[s]);
+		if (!ok) continue;
+		// طŰϳɱĲ루/ʽextradata ԭͬ
+		XTraceStreamInfo info = XTraceStreamInfo::FromContext(synth[i].encoder.GetContext());
+		info.stream.time_base_num = inputs[s].stream.time_base_num;
+		info.stream.time_base_den = inputs[s].stream.time_base_den;
+		inputs[s] = info;
+	}
+
+	XTraceStreamInfo outputs[2] = { reader.output(0), reader.output(1) };
+	XPacketTraceWriter writer;
+	if (!writer.Open(out_path, header, inputs, outputs, true))
+	{
+		CloseSynth(synth[0]);
+		CloseSynth(synth[1]);
+		return 1;
+	}
+
+	// ԭ¼˳򡢺ʱ䣬 k Ƶ/Ƶ¼ĸʱɵ k ϳɰ
+	int64_t replaced = 0, empty = 0;
+	while (reader.Next(rec))
+	{
+		int i = (rec.stream == header.video_index) ? 0 : (rec.stream == header.audio_index) ? 1 : -1;
+		AVPacket* pkt = (i >= 0 && synth[i].opened) ? NextSynthPacket(synth[i]) : nullptr;
+		if (pkt)
+		{
+			rec.pts = pkt->pts;
+			rec.dts = pkt->dts;
+			rec.duration = pkt->duration;
+			rec.flags = pkt->flags;
+			rec.size = pkt->size;
+			replaced++;
+		}
+		else
+		{
+			empty++;
+		}
+		writer.Write(rec, pkt);
+		av_packet_free(&pkt);
+	}
+	writer.Close();
+	CloseSynth(synth[0]);
+	CloseSynth(synth[1]);
+
+	printf("synthetic trace: %s, %lld packets with synthetic data, %lld without\n",
+		out_path.c_str(), (long long)replaced, (long long)empty);
+	return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// runط
+
+// طһĽ롢
+struct ReplayStream
+{
+	XDecoder decoder;
+	XEncoder encoder;
+	bool decoder_open{ false };
+	bool encoder_open{ false };
+	bool audio{ false };
+	AVRational in_tb{ 1, 1 };
+	int out_index{ -1 };
+
+	// ׶κʱ¼ / طŵģ΢
+	int64_t packets{ 0 };
+	int64_t frames{ 0 };
+	int64_t recorded_decode_us{ 0 };
+	int64_t recorded_encode_us{ 0 };
+	int64_t decode_us{ 0 };
+	int64_t encode_us{ 0 };
+};
+
+struct Replay
+{
+	ReplayStream streams[2];
+	XMuxer muxer;
+	bool muxer_open{ false };
+	XAudioResampler resampler;
+	SwsContext* sws{ nullptr };
+	AVFrame* scaled{ nullptr };
+	AVFrame* audio_frame{ nullptr };
+	AVPacket* out_pkt{ nullptr };
+};
+
+static bool OpenReplayStream(ReplayStream& rs, const XTraceStreamInfo& in, const XTraceStreamInfo& out, bool audio)
+{
+	rs.audio = audio;
+	rs.in_tb = in.time_base();
+	AVCodecParameters* par = avcodec_parameters_alloc();
+	bool ok = par && rs.decoder.Create((AVCodecID)in.stream.codec_id, false) && in.ToParameters(par) &&
+		avcodec_parameters_to_context(rs.decoder.GetContext(), par) >= 0;
+	avcodec_parameters_free(&par);
+	if (!ok || !rs.decoder.Open())
+	{
+		std::cerr << "Error: cannot open " << avcodec_get_name((AVCodecID)in.stream.codec_id) << " decoder" << std::endl;
+		return false;
+	}
+	rs.decoder_open = true;
+
+	const XTraceStream& st = out.stream;
+	if (!rs.encoder.Create((AVCodecID)st.codec_id))
+	{
+		std::cerr << "Error: no encoder for " << avcodec_get_name((AVCodecID)st.codec_id) << std::endl;
+		return false;
+	}
+	AVCodecContext* ctx = rs.encoder.GetContext();
+	if (audio)
+	{
+		ctx->sample_rate = st.sample_rate;
+		ctx->sample_fmt = (AVSampleFormat)st.format;
+		av_channel_layout_default(&ctx->ch_layout, st.channels);
+	}
+	else
+	{
+		rs.encoder.SetVideoParam(st.width, st.height, (AVPixelFormat)st.format);
+		if (st.frame_rate_num > 0 && st.frame_rate_den > 0) rs.encoder.SetFrameRate(out.frame_rate());
+	}
+	rs.encoder.SetTimeBase(out.time_base());
+	if (st.bit_rate > 0) rs.encoder.SetBitRate(st.bit_rate);
+	if (!rs.encoder.Open())
+	{
+		std::cerr << "Error: cannot open " << avcodec_get_name((AVCodecID)st.codec_id) << " encoder" << std::endl;
+		return false;
+	}
+	rs.encoder_open = true;
+	return true;
+}
+
+static bool WritePackets(Replay& replay, ReplayStream& rs)
+{
+	AVStream* out_stream = replay.muxer.GetAVFormatContext()->streams[rs.out_index];
+	while (true)
+	{
+		av_packet_unref(replay.out_pkt);
+		auto ret = rs.encoder.ReceivePacket(replay.out_pkt);
+		if (ret == XEncoder::ReceiveResult::Failed) return false;
+		if (ret != XEncoder::ReceiveResult::Success) return true;
+		av_packet_rescale_ts(replay.out_pkt, rs.encoder.GetContext()->time_base, out_stream->time_base);
+		replay.out_pkt->stream_index = rs.out_index;
+		if (!replay.muxer.Write(replay.out_pkt)) return false;
+	}
+}
+
+// һ֡ĺ/ز롢װframe Ϊ nullptr ʱˢ
+static bool EncodeFrame(Replay& replay, ReplayStream& rs, AVFrame* frame)
+{
+	AVCodecContext* ctx = rs.encoder.GetContext();
+	if (rs.audio)
+	{
+		if (!replay.resampler.Push(frame)) return false;
+		while (replay.resampler.Pop(replay.audio_frame, frame == nullptr))
+		{
+			if (rs.encoder.SendFrame(replay.audio_frame) == XEncoder::SendResult::Failed) return false;
+			if (!WritePackets(replay, rs)) return false;
+		}
+		if (frame) return true;
+		rs.encoder.SendFrame(nullptr);
+		return WritePackets(replay, rs);
+	}
+
+	AVFrame* to_encode = frame;
+	if (frame && (frame->width != ctx->width || frame->height != ctx->height || frame->format != ctx->pix_fmt))
+	{
+		replay.sws = sws_getCachedContext(replay.sws, frame->width, frame->height, (AVPixelFormat)frame->format,
+			ctx->width, ctx->height, ctx->pix_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr);
+		if (!replay.sws) return false;
+		if (!replay.scaled->data[0])
+		{
+			replay.scaled->width = ctx->width;
+			replay.scaled->height = ctx->height;
+			replay.scaled->format = ctx->pix_fmt;
+			if (av_frame_get_buffer(replay.scaled, 0) < 0) return false;
+		}
+		if (av_frame_make_writable(replay.scaled) < 0) return false;
+		sws_scale(replay.sws, frame->data, frame->linesize, 0, frame->height,
+			replay.scaled->data, replay.scaled->linesize);
+		replay.scaled->pts = frame->pts;
+		to_encode = replay.scaled;
+	}
+	if (rs.encoder.SendFrame(to_encode) == XEncoder::SendResult::Failed) return false;
+	return WritePackets(replay, rs);
+}
+
+// һnullptr ˢ½֡
+static bool DecodePacket(Replay& replay, ReplayStream& rs, AVPacket* pkt, AVFrame* frame)
+{
+	int64_t start = NowUs();
+	int64_t encode_us = 0;
+	auto send_ret = rs.decoder.SendPacket(pkt);
+	// ϳɸػ𻵵İʱðط
+	if (send_ret == XDecoder::SendResult::Failed) return true;
+	while (true)
+	{
+		av_frame_unref(frame);
+		auto recv_ret = rs.decoder.ReceiveFrame(frame);
+		if (recv_ret != XDecoder::ReceiveResult::Success) break;
+		int64_t pts = frame->best_effort_timestamp;
+		frame->pts = (pts == AV_NOPTS_VALUE) ? AV_NOPTS_VALUE
+			: av_rescale_q(pts, rs.in_tb, rs.encoder.GetContext()->time_base);
+		frame->pict_type = AV_PICTURE_TYPE_NONE;
+		rs.frames++;
+		int64_t encode_start = NowUs();
+		bool ok = EncodeFrame(replay, rs, frame);
+		encode_us += NowUs() - encode_start;
+		if (!ok) return false;
+	}
+	rs.decode_us += NowUs() - start - encode_us;
+	rs.encode_us += encode_us;
+	return true;
+}
+
+static void CloseReplay(Replay& replay)
+{
+	for (ReplayStream& rs : replay.streams)
+	{
+		if (rs.decoder_open) rs.decoder.Close();
+		if (rs.encoder_open) rs.encoder.Close();
+	}
+	if (replay.muxer_open) replay.muxer.Close();
+	replay.resampler.Close();
+	sws_freeContext(replay.sws);
+	replay.sws = nullptr;
+	av_frame_free(&replay.scaled);
+	av_frame_free(&replay.audio_frame);
+	av_packet_free(&replay.out_pkt);
+}
+
+static int Run(const std::string& path, const std::string& output, bool pace)
+{
+	XPacketTraceReader reader;
+	if (!reader.Open(path)) return 1;
+	if (!reader.has_data())
+	{
+		std::cerr << "Error: trace has no packet data, create synthetic payloads first: xtrace_replay synth "
+			<< path << " <out.trace>" << std::endl;
+		return 1;
+	}
+
+	const XTraceHeader& header = reader.header();
+	int indexes[2] = { header.video_index, header.audio_index };
+	Replay replay;
+	replay.scaled = av_frame_alloc();
+	replay.audio_frame = av_frame_alloc();
+	replay.out_pkt = av_packet_alloc();
+	bool ok = true;
+	for (int i = 0; i < 2 && ok; i++)
+	{
+		int s = indexes[i];
+		if (s < 0 || s >= (int)reader.inputs().size() || reader.output(i).stream.codec_id == AV_CODEC_ID_NONE)
+		{
+			indexes[i] = -1;
+			continue;
+		}
+		ok = OpenReplayStream(replay.streams[i], reader.inputs()[s], reader.output(i), i == 1);
+	}
+	ok = ok && indexes[0] >= 0;
+	if (ok && indexes[1] >= 0)
+	{
+		ok = replay.resampler.Open(replay.streams[1].decoder.GetContext(), replay.streams[1].encoder.GetContext());
+	}
+	if (ok)
+	{
+		ok = replay.muxer.Open(output, replay.streams[0].encoder.GetContext(),
+			indexes[1] >= 0 ? replay.streams[1].encoder.GetContext() : nullptr);
+		replay.muxer_open = ok;
+		ok = ok && replay.muxer.WriteHeader();
+		replay.streams[0].out_index = replay.muxer.video_index();
+		replay.streams[1].out_index = replay.muxer.audio_index();
+	}
+	if (!ok)
+	{
+		std::cerr << "Error: cannot set up replay pipeline" << std::endl;
+		CloseReplay(replay);
+		return 1;
+	}
+
+	AVPacket* pkt = av_packet_alloc();
+	AVFrame* frame = av_frame_alloc();
+	XTraceRecord rec;
+	int64_t records = 0, read_us = 0, recorded_read_us = 0, recorded_wall_us = 0;
+	int64_t start = NowUs();
+	while (ok)
+	{
+		int64_t read_start = NowUs();
+		if (!reader.Next(rec, pkt)) break;
+		// ¼ĶʱͰ˵ͣ٣ȡԴļ
+		if (pace)
+		{
+			int64_t wait = rec.time_us + rec.read_us - (NowUs() - start);
+			if (wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+		}
+		read_us += NowUs() - read_start;
+		records++;
+		recorded_read_us += rec.read_us;
+		recorded_wall_us = std::max(recorded_wall_us, rec.time_us + rec.read_us + rec.decode_us + rec.encode_us);
+
+		int i = (rec.stream == indexes[0]) ? 0 : (rec.stream == indexes[1]) ? 1 : -1;
+		if (i < 0 || rec.data_size == 0) continue;
+		ReplayStream& rs = replay.streams[i];
+		rs.packets++;
+		rs.recorded_decode_us += rec.decode_us;
+		rs.recorded_encode_us += rec.encode_us;
+		ok = DecodePacket(replay, rs, pkt, frame);
+	}
+
+	// ˢ½ͱ
+	for (int i = 0; i < 2 && ok; i++)
+	{
+		if (indexes[i] < 0) continue;
+		ok = DecodePacket(replay, replay.streams[i], nullptr, frame);
+		int64_t encode_start = NowUs();
+		ok = ok && EncodeFrame(replay, replay.streams[i], nullptr);
+		replay.streams[i].encode_us += NowUs() - encode_start;
+	}
+	ok = ok && replay.muxer.WriteTrailer();
+	int64_t wall_us = NowUs() - start;
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+
+	printf("replay: %s -> %s, %lld packets%s%s\n", path.c_str(), output.c_str(), (long long)records,
+		pace ? ", paced" : "", ok ? "" : ", FAILED");
+	printf("%-14s %12s %12s\n", "stage", "recorded(s)", "replay(s)");
+	printf("%-14s %12.3f %12.3f\n", "read", recorded_read_us / 1e6, read_us / 1e6);
+	for (int i = 0; i < 2; i++)
+	{
+		if (indexes[i] < 0) continue;
+		const ReplayStream& rs = replay.streams[i];
+		std::string name = (i == 0) ? "video" : "audio";
+		printf("%-14s %12.3f %12.3f\n", (name + " decode").c_str(), rs.recorded_decode_us / 1e6, rs.decode_us / 1e6);
+		printf("%-14s %12.3f %12.3f\n", (name + " encode").c_str(), rs.recorded_encode_us / 1e6, rs.encode_us / 1e6);
+	}
+	printf("%-14s %12.3f %12.3f\n", "wall", recorded_wall_us / 1e6, wall_us / 1e6);
+	printf("video: %lld packets -> %lld frames", (long long)replay.streams[0].packets, (long long)replay.streams[0].frames);
+	if (indexes[1] >= 0)
+	{
+		printf(", audio: %lld packets -> %lld frames", (long long)replay.streams[1].packets, (long long)replay.streams[1].frames);
+	}
+	printf("\n");
+
+	CloseReplay(replay);
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string command = argc > 1 ? argv[1] : "";
+	if (command == "info" && argc > 2) return Info(argv[2]);
+	if (command == "dump" && argc > 2) return Dump(argv[2]);
+	if (command == "synth" && argc > 3) return Synth(argv[2], argv[3]);
+	if (command == "run" && argc > 2)
+	{
+		std::string output = "replay.mp4";
+		bool pace = false;
+		for (int i = 3; i < argc; i++)
+		{
+			if (std::string(argv[i]) == "--pace") pace = true;
+			else output = argv[i];
+		}
+		return Run(argv[2], output, pace);
+	}
+	std::cerr << "usage: xtrace_replay info|dump <trace>\n"
+		"       xtrace_replay synth <trace> <out.trace>\n"
+		"       xtrace_replay run <trace> [output.mp4] [--pace]" << std::endl;
+	return 1;
+}
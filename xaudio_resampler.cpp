@@ -0,0 +1,222 @@
+// xaudio_resampler.cpp
+#include "xaudio_resampler.h"
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/audio_fifo.h>
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libswresample/swresample.h>
+}
+
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+#pragma comment(lib, "swresample.lib")
+
+XAudioResampler::~XAudioResampler()
+{
+	Close();
+}
+
+bool XAudioResampler::Open(const AVCodecContext* dec_ctx, const AVCodecContext* enc_ctx)
+{
+	Close();
+	if (!dec_ctx || !enc_ctx) return false;
+
+	out_sample_fmt_ = enc_ctx->sample_fmt;
+	out_sample_rate_ = enc_ctx->sample_rate;
+	av_channel_layout_copy(&out_ch_layout_, &enc_ctx->ch_layout);
+	// PCM ȿɱ֡ frame_size Ϊ 0 1024 һ֡
+	frame_size_ = enc_ctx->frame_size > 0 ? enc_ctx->frame_size : 1024;
+	small_last_frame_ = enc_ctx->codec &&
+		(enc_ctx->codec->capabilities & (AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_VARIABLE_FRAME_SIZE));
+
+	fifo_ = av_audio_fifo_alloc(out_sample_fmt_, out_ch_layout_.nb_channels, frame_size_ * 2);
+	if (!fifo_)
+	{
+		std::cerr << "Error: audio fifo alloc failed!" << std::endl;
+		return false;
+	}
+	next_pts_ = AV_NOPTS_VALUE;
+
+	// ڽһ֡ǰPush() ʱٰ֡ʵʲȷ
+	in_sample_fmt_ = AV_SAMPLE_FMT_NONE;
+	return SetupConverter(dec_ctx->sample_fmt, dec_ctx->sample_rate, &dec_ctx->ch_layout);
+}
+
+void XAudioResampler::Close()
+{
+	swr_free(&swr_ctx_);
+	if (fifo_)
+	{
+		av_audio_fifo_free(fifo_);
+		fifo_ = nullptr;
+	}
+	if (conv_data_)
+	{
+		av_freep(&conv_data_[0]);
+		av_freep(&conv_data_);
+	}
+	conv_capacity_ = 0;
+	av_channel_layout_uninit(&in_ch_layout_);
+	av_channel_layout_uninit(&out_ch_layout_);
+	passthrough_ = false;
+}
+
+bool XAudioResampler::SetupConverter(AVSampleFormat sample_fmt, int sample_rate, const AVChannelLayout* ch_layout)
+{
+	if (sample_fmt == in_sample_fmt_ && sample_rate == in_sample_rate_ &&
+		av_channel_layout_compare(ch_layout, &in_ch_layout_) == 0)
+	{
+		return true;
+	}
+	in_sample_fmt_ = sample_fmt;
+	in_sample_rate_ = sample_rate;
+	av_channel_layout_uninit(&in_ch_layout_);
+	av_channel_layout_copy(&in_ch_layout_, ch_layout);
+
+	swr_free(&swr_ctx_);
+	passthrough_ = in_sample_fmt_ == out_sample_fmt_ && in_sample_rate_ == out_sample_rate_ &&
+		av_channel_layout_compare(&in_ch_layout_, &out_ch_layout_) == 0;
+	if (passthrough_) return true;
+
+	int ret = swr_alloc_set_opts2(&swr_ctx_,
+		&out_ch_layout_, out_sample_fmt_, out_sample_rate_,
+		&in_ch_layout_, in_sample_fmt_, in_sample_rate_,
+		0, nullptr);
+	if (ret < 0 || swr_init(swr_ctx_) < 0)
+	{
+		std::cerr << "Error: swresample init failed!" << std::endl;
+		swr_free(&swr_ctx_);
+		return false;
+	}
+	return true;
+}
+
+bool XAudioResampler::ReserveBuffer(int nb_samples)
+{
+	if (nb_samples <= conv_capacity_) return true;
+	if (conv_data_)
+	{
+		av_freep(&conv_data_[0]);
+		av_freep(&conv_data_);
+	}
+	conv_capacity_ = 0;
+	if (av_samples_alloc_array_and_samples(&conv_data_, nullptr,
+		out_ch_layout_.nb_channels, nb_samples, out_sample_fmt_, 0) < 0)
+	{
+		std::cerr << "Error: audio sample buffer alloc failed!" << std::endl;
+		return false;
+	}
+	conv_capacity_ = nb_samples;
+	return true;
+}
+
+bool XAudioResampler::WriteFifo(uint8_t** data, int nb_samples)
+{
+	if (nb_samples <= 0) return true;
+	if (av_audio_fifo_write(fifo_, (void**)data, nb_samples) < nb_samples)
+	{
+		std::cerr << "Error: audio fifo write failed!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool XAudioResampler::Push(const AVFrame* frame)
+{
+	if (!fifo_) return false;
+
+	const uint8_t** in_data = nullptr;
+	int in_samples = 0;
+	if (frame)
+	{
+		// ;仯ı䣩ʱ³ʼ
+		if (!SetupConverter((AVSampleFormat)frame->format, frame->sample_rate, &frame->ch_layout)) return false;
+
+		// FIFO ȡһ֡ʱ۳زδĲ
+		if (next_pts_ == AV_NOPTS_VALUE && frame->pts != AV_NOPTS_VALUE)
+		{
+			next_pts_ = frame->pts;
+			if (swr_ctx_) next_pts_ -= swr_get_delay(swr_ctx_, out_sample_rate_);
+		}
+		if (passthrough_) return WriteFifo(frame->extended_data, frame->nb_samples);
+
+		in_data = (const uint8_t**)frame->extended_data;
+		in_samples = frame->nb_samples;
+	}
+	// ȡزڲĲ
+	if (!swr_ctx_) return true;
+
+	int out_samples = swr_get_out_samples(swr_ctx_, in_samples);
+	if (out_samples <= 0) return true;
+	if (!ReserveBuffer(out_samples)) return false;
+
+	int converted = swr_convert(swr_ctx_, conv_data_, out_samples, in_data, in_samples);
+	if (converted < 0)
+	{
+		std::cerr << "Error: swr_convert failed!" << std::endl;
+		return false;
+	}
+	return WriteFifo(conv_data_, converted);
+}
+
+bool XAudioResampler::PadTo(int64_t pts)
+{
+	if (!fifo_ || !Push(nullptr)) return false;
+	swr_free(&swr_ctx_);
+	in_sample_fmt_ = AV_SAMPLE_FMT_NONE;
+	in_sample_rate_ = 0;
+	av_channel_layout_uninit(&in_ch_layout_);
+
+	if (next_pts_ == AV_NOPTS_VALUE) next_pts_ = 0;
+	int64_t silence = pts - (next_pts_ + av_audio_fifo_size(fifo_));
+	while (silence > 0)
+	{
+		int nb_samples = silence < frame_size_ ? (int)silence : frame_size_;
+		if (!ReserveBuffer(nb_samples)) return false;
+		av_samples_set_silence(conv_data_, 0, nb_samples, out_ch_layout_.nb_channels, out_sample_fmt_);
+		if (!WriteFifo(conv_data_, nb_samples)) return false;
+		silence -= nb_samples;
+	}
+	return true;
+}
+
+bool XAudioResampler::Pop(AVFrame* frame, bool flush)
+{
+	if (!fifo_) return false;
+	int available = av_audio_fifo_size(fifo_);
+	if (available <= 0) return false;
+	if (available < frame_size_ && !flush) return false;
+
+	int nb_samples = available < frame_size_ ? available : frame_size_;
+	// ܶ֡ʱ֡
+	int alloc_samples = (nb_samples < frame_size_ && !small_last_frame_) ? frame_size_ : nb_samples;
+
+	av_frame_unref(frame);
+	frame->nb_samples = alloc_samples;
+	frame->format = out_sample_fmt_;
+	frame->sample_rate = out_sample_rate_;
+	av_channel_layout_copy(&frame->ch_layout, &out_ch_layout_);
+	if (av_frame_get_buffer(frame, 0) < 0)
+	{
+		std::cerr << "Error: audio frame alloc failed!" << std::endl;
+		return false;
+	}
+	if (av_audio_fifo_read(fifo_, (void**)frame->extended_data, nb_samples) < nb_samples)
+	{
+		std::cerr << "Error: audio fifo read failed!" << std::endl;
+		return false;
+	}
+	if (alloc_samples > nb_samples)
+	{
+		av_samples_set_silence(frame->extended_data, nb_samples, alloc_samples - nb_samples,
+			out_ch_layout_.nb_channels, out_sample_fmt_);
+	}
+
+	if (next_pts_ == AV_NOPTS_VALUE) next_pts_ = 0;
+	frame->pts = next_pts_;
+	next_pts_ += nb_samples;
+	return true;
+}
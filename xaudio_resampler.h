@@ -0,0 +1,72 @@
+// xaudio_resampler.h
+#pragma once
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+struct AVFrame;
+struct AVCodecContext;
+struct SwrContext;
+struct AVAudioFifo;
+
+/**
+ * @brief Ƶת飺֡ -> swresampleʽ//-> AVAudioFifo -> ֡
+ *
+ * ÿ֡ĲҪ frame_size һͬ MP3 1152 -> AAC 1024
+ * תĲд FIFO frame_size ȡͱ
+ * ֡ pts ۼƲ㣨ʱ 1/sample_rate߽Ӱ졣
+ */
+class XAudioResampler
+{
+public:
+	~XAudioResampler();
+
+	// dec_ctx Ϊenc_ctx Ѵ򿪣frame_size ȷ
+	bool Open(const AVCodecContext* dec_ctx, const AVCodecContext* enc_ctx);
+	void Close();
+
+	// дһ֡frame->pts Ϊʱnullptr ʾȡزʣĲ
+	bool Push(const AVFrame* frame);
+	// ȡһ֡FIFO в frame_size ʱ false
+	// flush Ϊ true ʱȡʣ಻һ֡Ĳֶ֧֡ʱ
+	bool Pop(AVFrame* frame, bool flush = false);
+
+	// ƴӣһƵȡزʣĲ ptsʱ
+	// ʹһƵ pts ʼһĵһ֡³ʼ swresample
+	bool PadTo(int64_t pts);
+
+	// ȫͬʱֻ飬 swresample
+	bool passthrough() const { return passthrough_; }
+
+private:
+	// 뵱ǰòͬʱ³ʼ swresample
+	bool SetupConverter(AVSampleFormat sample_fmt, int sample_rate, const AVChannelLayout* ch_layout);
+	bool ReserveBuffer(int nb_samples);
+	bool WriteFifo(uint8_t** data, int nb_samples);
+
+private:
+	SwrContext* swr_ctx_{ nullptr };
+	AVAudioFifo* fifo_{ nullptr };
+
+	// 
+	AVSampleFormat in_sample_fmt_{ AV_SAMPLE_FMT_NONE };
+	int in_sample_rate_{ 0 };
+	AVChannelLayout in_ch_layout_{};
+
+	// 
+	AVSampleFormat out_sample_fmt_{ AV_SAMPLE_FMT_NONE };
+	int out_sample_rate_{ 0 };
+	AVChannelLayout out_ch_layout_{};
+	int frame_size_{ 1024 };
+	bool small_last_frame_{ false };	// һ֡
+
+	bool passthrough_{ false };
+	int64_t next_pts_{ AV_NOPTS_VALUE };	// FIFO еһ pts
+
+	// ת
+	uint8_t** conv_data_{ nullptr };
+	int conv_capacity_{ 0 };
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include <mutex>
+#include "xlock_stats.h"
 
 extern "C" {
 #include <libavcodec/codec_id.h>
@@ -12,7 +13,7 @@ class XAvFormat
 {
 public:
 	AVFormatContext* GetAVFormatContext() {
-		std::lock_guard<std::mutex> lock(mtx_);
+		std::lock_guard<XCountedMutex> lock(mtx_);
 		return fmt_ctx_;
 	}
 	int audio_index() { return audio_index_; };
@@ -24,6 +25,6 @@ protected:
 	int audio_index_{ -1 };
 	int video_index_{ -1 };
 	AVCodecID codec_id_{ AV_CODEC_ID_NONE };
-	std::mutex mtx_;
+	XCountedMutex mtx_{ XLockStats::Format() };
 };
 
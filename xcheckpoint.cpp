@@ -0,0 +1,92 @@
+// xcheckpoint.cpp
+#include "xcheckpoint.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+
+// 汾 2ֶԵһ֡Ϊê㣨汾 1 ɶϵ㲻ʹ
+static const int kCheckpointVersion = 2;
+
+bool XCheckpoint::Load(const std::string& path)
+{
+	std::ifstream ifs(path);
+	if (!ifs) return false;
+
+	bool has_params = false;
+	int version = 0;
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		size_t pos = line.find('=');
+		if (pos == std::string::npos) continue;
+		std::string key = line.substr(0, pos);
+		std::string value = line.substr(pos + 1);
+		if (key == "version") version = (int)std::strtol(value.c_str(), nullptr, 10);
+		else if (key == "params") { params = value; has_params = true; }
+		else if (key == "first_pts") first_pts = std::strtoll(value.c_str(), nullptr, 10);
+		else if (key == "keyframe_interval") keyframe_interval = std::strtoll(value.c_str(), nullptr, 10);
+		else if (key == "segment") segment = (int)std::strtol(value.c_str(), nullptr, 10);
+		else if (key == "resume_pts") resume_pts = std::strtoll(value.c_str(), nullptr, 10);
+		else if (key == "input_ts") input_ts = std::strtoll(value.c_str(), nullptr, 10);
+	}
+	return version == kCheckpointVersion && has_params && keyframe_interval > 0;
+}
+
+bool XCheckpoint::Save(const std::string& path) const
+{
+	std::string tmp_path = path + ".tmp";
+	{
+		std::ofstream ofs(tmp_path, std::ios::trunc);
+		if (!ofs) return false;
+		ofs << "version=" << kCheckpointVersion << "\n"
+			<< "params=" << params << "\n"
+			<< "first_pts=" << first_pts << "\n"
+			<< "keyframe_interval=" << keyframe_interval << "\n"
+			<< "segment=" << segment << "\n"
+			<< "resume_pts=" << resume_pts << "\n"
+			<< "input_ts=" << input_ts << "\n";
+		ofs.flush();
+		if (!ofs) return false;
+	}
+	// Windows  rename ܸļ
+	if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		std::remove(path.c_str());
+		if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+		{
+			std::cerr << "Error: Failed to save checkpoint '" << path << "'" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void XCheckpoint::Remove(const std::string& path)
+{
+	std::remove(path.c_str());
+}
+
+int XCheckpoint::CountPlaylistSegments(const std::string& playlist, bool* ended)
+{
+	if (ended) *ended = false;
+	std::ifstream ifs(playlist);
+	if (!ifs) return 0;
+
+	// װֻڷֶļرպŰдббеķֶζ
+	int count = 0;
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		if (line.compare(0, 8, "#EXTINF:") == 0) count++;
+		else if (ended && line.compare(0, 14, "#EXT-X-ENDLIST") == 0) *ended = true;
+	}
+	return count;
+}
+
+int64_t XCheckpoint::SegmentStartPts(int index) const
+{
+	// ֶԵһ֡Ϊê㣨ҪǼװһۼʱзֵһ
+	if (index <= 0 || keyframe_interval <= 0) return first_pts;
+	return first_pts + (int64_t)index * keyframe_interval;
+}
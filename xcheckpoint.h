@@ -0,0 +1,34 @@
+// xcheckpoint.h
+#pragma once
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief תϵϢļԵı߳ļУkey=value ı
+ *
+ * ϵ HLS ֶΪλÿֶǿ IDR ʼֶ֮״̬
+ * ָʱһֶ֮ǰؼ֡ʼ룬֮ǰ֡
+ * ´򿪱ڲб׷·ֶΡ
+ */
+class XCheckpoint
+{
+public:
+	bool Load(const std::string& path);
+	// дʱļٸд;˳Ҳ²Ķϵļ
+	bool Save(const std::string& path) const;
+	static void Remove(const std::string& path);
+
+	// ͳ HLS бдķֶended бǷѽEXT-X-ENDLIST
+	static int CountPlaylistSegments(const std::string& playlist, bool* ended);
+
+	//  index ֶε㣨ʱ ForceSegmentKeyFrame() ǿƹؼ֡λһ
+	int64_t SegmentStartPts(int index) const;
+
+public:
+	std::string params;				// ļ뱾ת벻һʱϵ
+	int64_t first_pts{ 0 };			// һƵ֡ ptsʱֶê
+	int64_t keyframe_interval{ 0 };	// ֶγȣʱ
+	int segment{ 0 };				// ύװķֶһֶ
+	int64_t resume_pts{ 0 };		// һֶ㣨ʱ
+	int64_t input_ts{ 0 };			// Ƶеʱʱ
+};
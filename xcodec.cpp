@@ -41,7 +41,7 @@ bool XCodec::Create(AVCodecID codec_id, bool is_encoder)
 
 bool XCodec::Open() 
 {
-	std::unique_lock<std::mutex> lock(mtx_);
+	std::unique_lock<XCountedMutex> lock(mtx_);
 	if (!context_) return false;
 
 	if (is_encoder_)
@@ -99,12 +99,14 @@ bool XCodec::Close()
 {
 	if (!context_) return false;
 	avcodec_free_context(&context_);
+	pending_units_ = 0;
+	memory_.Set(0);
 	return true;
 }
 
 bool XCodec::SetVideoParam(int width, int height, AVPixelFormat pix_fmt)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!context_) return false;
 	if (width <= 0 || height <= 0) return false;
 	if (pix_fmt == AV_PIX_FMT_NONE) return false;
@@ -121,7 +123,7 @@ bool XCodec::SetVideoParam(int width, int height, AVPixelFormat pix_fmt)
 
 bool XCodec::SetTimeBase(int num, int den) 
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	// У
 	if (num <= 0 || den <= 0) {
 		std::cerr << "Invalid time base: " << num << "/" << den << std::endl;
@@ -150,7 +152,7 @@ bool XCodec::SetTimeBase(AVRational time_base)
 
 bool XCodec::SetFrameRate(int num, int den)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!context_) return false;
 	if (num <= 0 || den <= 0) return false;
 	context_->framerate = {num, den};
@@ -164,7 +166,7 @@ bool XCodec::SetFrameRate(AVRational framerate)
 }
 
 bool XCodec::SetBitRate(int64_t bit_rate) {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!context_) return false;
 	if (bit_rate <= 0) return false;
 	context_->bit_rate = bit_rate;
@@ -172,7 +174,7 @@ bool XCodec::SetBitRate(int64_t bit_rate) {
 }
 
 bool XCodec::SetGopSize(int gop_size) {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!context_) return false;
 	context_->gop_size = gop_size;
 	return true;
@@ -180,7 +182,7 @@ bool XCodec::SetGopSize(int gop_size) {
 
 bool XCodec::SetOpt(const std::string& key, const std::string& value)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	int ret = av_opt_set(context_->priv_data, key.c_str(), value.c_str(), 0);
 	if (ret == 0) return true;
 	return false;
@@ -188,7 +190,7 @@ bool XCodec::SetOpt(const std::string& key, const std::string& value)
 
 bool XCodec::SetOpt(const std::string& key, int value)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	int ret = av_opt_set_int(context_->priv_data, key.c_str(), value, 0);
 	if (ret == 0) return true;
 	return false;
@@ -196,7 +198,7 @@ bool XCodec::SetOpt(const std::string& key, int value)
 
 AVFrame* XCodec::CreateFrame()
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	AVFrame* frame = av_frame_alloc();
 	if (!frame) return nullptr;
 
@@ -214,3 +216,27 @@ AVFrame* XCodec::CreateFrame()
 	return frame;
 }
 
+int64_t XCodec::FrameBytes(const AVFrame* frame)
+{
+	if (!frame) return 0;
+	int64_t bytes = 0;
+	for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+	{
+		if (frame->buf[i]) bytes += frame->buf[i]->size;
+	}
+	return bytes;
+}
+
+void XCodec::OnInput(int64_t unit_bytes)
+{
+	pending_units_++;
+	if (unit_bytes > 0) unit_bytes_ = unit_bytes;
+	memory_.Set(pending_units_ * unit_bytes_);
+}
+
+void XCodec::OnOutput(int64_t unit_bytes)
+{
+	if (pending_units_ > 0) pending_units_--;
+	if (unit_bytes > 0) unit_bytes_ = unit_bytes;
+	memory_.Set(pending_units_ * unit_bytes_);
+}
@@ -2,6 +2,8 @@
 #pragma once
 #include <iostream>
 #include <mutex>
+#include "xmemory_budget.h"
+#include "xlock_stats.h"
 
 extern "C" {
 #include <libavcodec/codec_id.h>
@@ -41,7 +43,7 @@ public:
 
 	// ȡģ
 	AVCodecContext* GetContext() {
-		std::lock_guard<std::mutex> lock(mtx_);
+		std::lock_guard<XCountedMutex> lock(mtx_);
 		return context_;
 	}
 
@@ -65,10 +67,23 @@ public:
 	// ֡frame
 	AVFrame* CreateFrame();
 
+	// ڲ֡㣺δȡĵԪ x һֽ֡
+	XMemoryCounter& memory() { return memory_; }
+	static int64_t FrameBytes(const AVFrame* frame);
+
+protected:
+	// һԪ֡/ ȡһԪڴ
+	void OnInput(int64_t unit_bytes);
+	void OnOutput(int64_t unit_bytes);
+
 protected:
 	AVCodecContext* context_{ nullptr };	//
-	std::mutex mtx_;
+	XCountedMutex mtx_{ XLockStats::Codec() };
 	bool is_encoder_{ true };
 
+	XMemoryCounter memory_;
+	int64_t pending_units_{ 0 };
+	int64_t unit_bytes_{ 0 };
+
 };
 
@@ -0,0 +1,240 @@
+// xcomplexity_analyzer.cpp
+#include "xcomplexity_analyzer.h"
+#include "xdemuxer.h"
+#include "xdecoder.h"
+#include "xpixel_ops.h"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#pragma comment(lib, "avformat.lib")
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+#pragma comment(lib, "swscale.lib")
+
+// ֱʵ
+static const int kAnalysisWidth = 640;
+
+XComplexityAnalyzer::~XComplexityAnalyzer()
+{
+	sws_freeContext(sws_ctx_);
+}
+
+void XComplexityAnalyzer::SetSampling(int samples, int burst_frames)
+{
+	samples_ = samples > 0 ? samples : 1;
+	burst_frames_ = burst_frames > 0 ? burst_frames : 1;
+}
+
+bool XComplexityAnalyzer::Analyze(const std::string& input_file)
+{
+	auto start_time = std::chrono::steady_clock::now();
+	result_ = XComplexity();
+	spatial_sum_ = 0;
+	temporal_sum_ = 0;
+	temporal_count_ = 0;
+
+	XDemuxer demuxer;
+	XDecoder decoder;
+	AVPacket* pkt = nullptr;
+	AVFrame* frame = nullptr;
+	AVStream* stream = nullptr;
+	int video_index = -1;
+	int64_t start_ts = 0;
+	int64_t duration = 0;
+	int samples = 1;
+	int64_t last_key_ts = AV_NOPTS_VALUE;
+	bool is_successed = false;
+
+	if (!demuxer.Open(input_file))
+	{
+		std::cerr << "Error: analyzer cannot open '" << input_file << "'" << std::endl;
+		return false;
+	}
+	video_index = demuxer.video_index();
+	stream = demuxer.GetAVFormatContext()->streams[video_index];
+	if (!decoder.Create(stream->codecpar->codec_id, false) ||
+		!demuxer.CopyPara(video_index, decoder.GetContext()))
+	{
+		std::cerr << "Error: analyzer setup decoder failed!" << std::endl;
+		goto cleanup;
+	}
+	// ӶֻҪ»棺·˲
+	decoder.GetContext()->skip_loop_filter = AVDISCARD_ALL;
+	if (!decoder.Open())
+	{
+		std::cerr << "Error: analyzer open decoder failed!" << std::endl;
+		goto cleanup;
+	}
+	source_width_ = decoder.GetContext()->width;
+	source_height_ = decoder.GetContext()->height;
+
+	// ʱδ֪ʱֻͷһ
+	if (stream->start_time != AV_NOPTS_VALUE) start_ts = stream->start_time;
+	duration = stream->duration;
+	if (duration <= 0 && demuxer.GetAVFormatContext()->duration > 0)
+	{
+		duration = av_rescale_q(demuxer.GetAVFormatContext()->duration, AV_TIME_BASE_Q, stream->time_base);
+	}
+	if (duration > 0) samples = samples_;
+
+	pkt = av_packet_alloc();
+	frame = av_frame_alloc();
+	for (int s = 0; s < samples; s++)
+	{
+		if (duration > 0)
+		{
+			// ȡе㣬λ֮ǰĹؼ֡
+			int64_t ts = start_ts + duration * (2 * s + 1) / (2 * samples);
+			if (!demuxer.Seek(video_index, ts)) break;
+			decoder.Flush();
+		}
+
+		int got = 0;
+		bool first = true;
+		while (got < burst_frames_)
+		{
+			av_packet_unref(pkt);
+			if (!demuxer.Read(pkt)) break;
+			if (pkt->stream_index != video_index) continue;
+			if (first)
+			{
+				// ƬԴؼ֡ϡʱڲܶλͬһؼ֡ظ
+				int64_t key_ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+				first = false;
+				if (key_ts == last_key_ts) break;
+				last_key_ts = key_ts;
+				result_.samples++;
+			}
+			if (decoder.SendPacket(pkt) == XDecoder::SendResult::Failed) break;
+			while (got < burst_frames_)
+			{
+				av_frame_unref(frame);
+				if (decoder.ReceiveFrame(frame) != XDecoder::ReceiveResult::Success) break;
+				Measure(frame, got > 0);
+				got++;
+				result_.frames++;
+			}
+		}
+	}
+
+	if (result_.frames > 0)
+	{
+		result_.spatial = spatial_sum_ / result_.frames;
+		result_.temporal = temporal_count_ > 0 ? temporal_sum_ / temporal_count_ : 0;
+		is_successed = true;
+	}
+	else
+	{
+		std::cerr << "Error: analyzer decoded no frames from '" << input_file << "'" << std::endl;
+	}
+
+cleanup:
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	decoder.Close();
+	demuxer.Close();
+	result_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	return is_successed;
+}
+
+void XComplexityAnalyzer::Measure(const AVFrame* frame, bool has_prev)
+{
+	// ƬԴߴʽ仯ʱؽģֱʲԿһ֡Ƚ
+	if (!sws_ctx_ || frame->width != sws_src_width_ || frame->height != sws_src_height_ ||
+		frame->format != sws_src_format_)
+	{
+		sws_freeContext(sws_ctx_);
+		sws_src_width_ = frame->width;
+		sws_src_height_ = frame->height;
+		sws_src_format_ = (AVPixelFormat)frame->format;
+		int width = std::min(frame->width, kAnalysisWidth) & ~15;
+		int height = (int)((int64_t)frame->height * width / std::max(frame->width, 1)) & ~1;
+		if (width != width_ || height != height_) has_prev = false;
+		width_ = width;
+		height_ = height;
+		sws_ctx_ = nullptr;
+		if (width_ < 16 || height_ < 16) return;
+		sws_ctx_ = sws_getContext(frame->width, frame->height, sws_src_format_,
+			width_, height_, AV_PIX_FMT_GRAY8, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+		if (!sws_ctx_) return;
+		cur_.assign((size_t)width_ * height_, 0);
+		prev_.assign((size_t)width_ * height_, 0);
+		block_sad_.assign((size_t)(width_ / 8) * (height_ / 8), 0);
+	}
+
+	uint8_t* dst[4] = { cur_.data(), nullptr, nullptr, nullptr };
+	int dst_stride[4] = { width_, 0, 0, 0 };
+	sws_scale(sws_ctx_, frame->data, frame->linesize, 0, frame->height, dst, dst_stride);
+
+	auto sad_per_pixel = [this](const uint8_t* a, const uint8_t* b, int width, int height) {
+		int blocks = (width / 8) * (height / 8);
+		if (blocks <= 0) return 0.0;
+		XPixelOps::BlockSad8x8(a, width_, b, width_, width, height, block_sad_.data());
+		uint64_t sum = 0;
+		for (int i = 0; i < blocks; i++) sum += block_sad_[i];
+		return (double)sum / (blocks * 64.0);
+	};
+
+	// ռ䣺һСһеȽϣˮƽ/ֱݶȾֵľֵ
+	const uint8_t* cur = cur_.data();
+	spatial_sum_ += sad_per_pixel(cur, cur + 1, width_ - 8, height_) +
+		sad_per_pixel(cur, cur + width_, width_, height_ - 8);
+	// ʱ䣺ͬһһ֡Ƚ
+	if (has_prev)
+	{
+		temporal_sum_ += sad_per_pixel(cur, prev_.data(), width_, height_);
+		temporal_count_++;
+	}
+	cur_.swap(prev_);
+}
+
+int XComplexityAnalyzer::RecommendBitrate(int width, int height, double fps, AVCodecID codec_id) const
+{
+	if (width <= 0) width = source_width_;
+	if (height <= 0) height = source_height_;
+	if (width <= 0 || height <= 0 || fps <= 0) return 0;
+
+	// H.264 ÿرƽ̹ĶԼ 0.05һԼ 0.09˶Լ 0.16
+	double bpp = 0.03 + 0.003 * result_.spatial + 0.006 * result_.temporal;
+	bpp = std::max(0.03, std::min(0.25, bpp));
+
+	//  1080p Ϊ׼ 0.75 η
+	const double ref_pixels = 1920.0 * 1080.0;
+	double kbps = bpp * ref_pixels * fps * std::pow(width * (double)height / ref_pixels, 0.75) / 1000.0;
+
+	// Ч H.264 ϵ
+	switch (codec_id)
+	{
+	case AV_CODEC_ID_HEVC: kbps *= 0.65; break;
+	case AV_CODEC_ID_VP9: kbps *= 0.7; break;
+	case AV_CODEC_ID_AV1: kbps *= 0.55; break;
+	case AV_CODEC_ID_MPEG2VIDEO: kbps *= 1.8; break;
+	default: break;
+	}
+	// ȡ 50kbps 100kbps
+	int result = (int)(kbps / 50.0 + 0.5) * 50;
+	return std::max(100, result);
+}
+
+std::vector<XLadderRung> XComplexityAnalyzer::RecommendLadder(const std::vector<int>& heights, double fps, AVCodecID codec_id) const
+{
+	std::vector<XLadderRung> ladder;
+	if (source_width_ <= 0 || source_height_ <= 0) return ladder;
+	for (int height : heights)
+	{
+		XLadderRung rung;
+		rung.height = height & ~1;
+		rung.width = (int)((int64_t)source_width_ * rung.height / source_height_) & ~1;
+		rung.bitrate_kbps = RecommendBitrate(rung.width, rung.height, fps, codec_id);
+		ladder.push_back(rung);
+	}
+	return ladder;
+}
@@ -0,0 +1,80 @@
+// xcomplexity_analyzer.h
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+extern "C" {
+#include <libavcodec/codec_id.h>
+#include <libavutil/pixfmt.h>
+}
+
+struct AVFrame;
+struct SwsContext;
+
+// ݸӶȣȣ 640 ķֱʼ㣬ƬԴֱʻ޹أ
+struct XComplexity
+{
+	int samples{ 0 };		// Ĳ
+	int frames{ 0 };		// ֡
+	double spatial{ 0 };	// ռ临Ӷȣˮƽ + ֱƽݶȣÿأ
+	double temporal{ 0 };	// ʱ临Ӷȣ֡ƽԲÿأ
+	double seconds{ 0 };	// ʱ
+};
+
+// ʽеһ
+struct XLadderRung
+{
+	int width{ 0 };
+	int height{ 0 };
+	int bitrate_kbps{ 0 };
+};
+
+/**
+ * @brief ݸӶԤʽǰƬԴӶƼ
+ *
+ * ʱھȡɲ㣬ÿ㶨λؼֻ֡֡·˲
+ * СΪҶͼ SAD ں˼ռ/ʱ临Ӷȡ֡ƬԴʱ޹أ
+ * ͨԶСһ롣ƽ̹Ƽʵͣȸ˶Ƽʸߡ
+ */
+class XComplexityAnalyzer
+{
+public:
+	~XComplexityAnalyzer();
+
+	// ÿ֡ Analyze() ǰã
+	void SetSampling(int samples, int burst_frames);
+
+	bool Analyze(const std::string& input_file);
+	const XComplexity& result() const { return result_; }
+
+	// ƼʣkbpsӶȹÿرʣ 1080p Ϊ׼ţ
+	int RecommendBitrate(int width, int height, double fps, AVCodecID codec_id) const;
+	// ʽݣheights ÿ߶һȰƬԴ߱
+	std::vector<XLadderRung> RecommendLadder(const std::vector<int>& heights, double fps, AVCodecID codec_id) const;
+
+private:
+	// ΪֱʵĻҶͼۼƸӶȣhas_prev Ϊ true ʱһ֡Ƚ
+	void Measure(const AVFrame* frame, bool has_prev);
+
+private:
+	int samples_{ 12 };
+	int burst_frames_{ 3 };
+	XComplexity result_;
+	int source_width_{ 0 };
+	int source_height_{ 0 };
+
+	// ֱʵĻҶͼǰ֡һ֡
+	SwsContext* sws_ctx_{ nullptr };
+	int sws_src_width_{ 0 };
+	int sws_src_height_{ 0 };
+	AVPixelFormat sws_src_format_{ AV_PIX_FMT_NONE };
+	int width_{ 0 };
+	int height_{ 0 };
+	std::vector<uint8_t> cur_;
+	std::vector<uint8_t> prev_;
+	std::vector<uint32_t> block_sad_;
+	double spatial_sum_{ 0 };
+	double temporal_sum_{ 0 };
+	int temporal_count_{ 0 };
+};
@@ -0,0 +1,353 @@
+// xconcat_source.cpp
+#include "xconcat_source.h"
+#include <iostream>
+#include <chrono>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+
+#pragma comment(lib, "avformat.lib")
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+
+// ÿ໺Ľ֡Ƶϼƣ
+static const size_t kQueueFrames = 16;
+
+// ֻͷеʱϢ
+static double ProbeDuration(const std::string& file)
+{
+	AVFormatContext* fmt_ctx = nullptr;
+	if (avformat_open_input(&fmt_ctx, file.c_str(), nullptr, nullptr) < 0) return 0;
+	double duration = fmt_ctx->duration > 0 ? fmt_ctx->duration / (double)AV_TIME_BASE : 0;
+	avformat_close_input(&fmt_ctx);
+	return duration;
+}
+
+// ĸ߳кԿɰȫȡ
+static AVCodecContext* CopyParams(AVCodecContext* dec_ctx)
+{
+	AVCodecParameters* par = avcodec_parameters_alloc();
+	AVCodecContext* copy = avcodec_alloc_context3(nullptr);
+	if (!par || !copy ||
+		avcodec_parameters_from_context(par, dec_ctx) < 0 ||
+		avcodec_parameters_to_context(copy, par) < 0)
+	{
+		avcodec_free_context(&copy);
+	}
+	else
+	{
+		copy->sample_aspect_ratio = dec_ctx->sample_aspect_ratio;
+	}
+	avcodec_parameters_free(&par);
+	return copy;
+}
+
+XConcatSource::~XConcatSource()
+{
+	Close();
+}
+
+bool XConcatSource::Open(const std::vector<std::string>& files, XMemoryCounter* memory)
+{
+	Close();
+	if (files.empty()) return false;
+	memory_ = memory;
+	duration_seconds_ = 0;
+	for (const std::string& file : files)
+	{
+		inputs_.emplace_back(new Input());
+		inputs_.back()->file = file;
+	}
+
+	// һڵ߳д򿪣
+	Input* first = inputs_[0].get();
+	if (!OpenInput(first)) return false;
+	video_params_ = CopyParams(first->video_decoder.GetContext());
+	if (first->has_audio) audio_params_ = CopyParams(first->audio_decoder.GetContext());
+	if (!video_params_) return false;
+
+	first->duration_seconds = first->demuxer.GetAVFormatContext()->duration > 0
+		? first->demuxer.GetAVFormatContext()->duration / (double)AV_TIME_BASE : 0;
+	for (size_t i = 1; i < inputs_.size(); i++)
+	{
+		inputs_[i]->duration_seconds = ProbeDuration(inputs_[i]->file);
+	}
+	for (auto& input : inputs_) duration_seconds_ += input->duration_seconds;
+	return true;
+}
+
+bool XConcatSource::OpenInput(Input* input)
+{
+	if (!input->demuxer.Open(input->file))
+	{
+		std::cerr << "Error: Cannot open concat input '" << input->file << "'" << std::endl;
+		return false;
+	}
+	AVFormatContext* fmt_ctx = input->demuxer.GetAVFormatContext();
+	input->start_us = fmt_ctx->start_time != AV_NOPTS_VALUE ? fmt_ctx->start_time : 0;
+
+	int video_index = input->demuxer.video_index();
+	if (!input->video_decoder.Create(fmt_ctx->streams[video_index]->codecpar->codec_id, false) ||
+		!input->demuxer.CopyPara(video_index, input->video_decoder.GetContext()) ||
+		!input->video_decoder.Open())
+	{
+		std::cerr << "Error: open video decoder for '" << input->file << "' failed!" << std::endl;
+		return false;
+	}
+	input->video_decoder.memory().SetParent(memory_);
+
+	// ûƵƵ޷룩ƴӴ
+	int audio_index = input->demuxer.audio_index();
+	input->has_audio = audio_index >= 0 &&
+		input->audio_decoder.Create(fmt_ctx->streams[audio_index]->codecpar->codec_id, false) &&
+		input->demuxer.CopyPara(audio_index, input->audio_decoder.GetContext()) &&
+		input->audio_decoder.Open();
+	if (input->has_audio) input->audio_decoder.memory().SetParent(memory_);
+	return true;
+}
+
+bool XConcatSource::Start(AVRational video_time_base, AVRational audio_time_base)
+{
+	if (inputs_.empty()) return false;
+	video_time_base_ = video_time_base;
+	audio_time_base_ = audio_time_base;
+	current_ = 0;
+	offset_us_ = 0;
+	input_end_us_ = 0;
+	wait_seconds_ = 0;
+	// ǰһͬʱ
+	StartInput(0);
+	StartInput(1);
+	return true;
+}
+
+void XConcatSource::StartInput(int index)
+{
+	if (index < 0 || index >= (int)inputs_.size()) return;
+	Input* input = inputs_[index].get();
+	if (input->thread.joinable()) return;
+	input->thread = std::thread(&XConcatSource::DecodeLoop, this, input);
+}
+
+void XConcatSource::CloseInput(int index)
+{
+	Input* input = inputs_[index].get();
+	{
+		std::lock_guard<std::mutex> lock(input->mtx);
+		input->stopping = true;
+	}
+	input->cv.notify_all();
+	if (input->thread.joinable()) input->thread.join();
+
+	for (Item& item : input->queue)
+	{
+		if (memory_) memory_->Sub(XCodec::FrameBytes(item.frame));
+		av_frame_free(&item.frame);
+	}
+	input->queue.clear();
+	input->video_decoder.Close();
+	input->audio_decoder.Close();
+	input->demuxer.Close();
+}
+
+void XConcatSource::Close()
+{
+	for (int i = 0; i < (int)inputs_.size(); i++) CloseInput(i);
+	inputs_.clear();
+	avcodec_free_context(&video_params_);
+	avcodec_free_context(&audio_params_);
+	current_ = 0;
+}
+
+const std::string& XConcatSource::current_file() const
+{
+	static const std::string empty;
+	return current_ < (int)inputs_.size() ? inputs_[current_]->file : empty;
+}
+
+const std::string& XConcatSource::longest_file() const
+{
+	static const std::string empty;
+	if (inputs_.empty()) return empty;
+	const Input* longest = inputs_[0].get();
+	for (auto& input : inputs_)
+	{
+		if (input->duration_seconds > longest->duration_seconds) longest = input.get();
+	}
+	return longest->file;
+}
+
+int64_t XConcatSource::offset(AVRational time_base) const
+{
+	return av_rescale_q(offset_us_, AV_TIME_BASE_Q, time_base);
+}
+
+void XConcatSource::DecodeLoop(Input* input)
+{
+	// һ Open() д򿪣ڱ߳д򿪣ǰһıص
+	bool ok = input->demuxer.GetAVFormatContext() || OpenInput(input);
+	AVPacket* pkt = av_packet_alloc();
+	AVFrame* frame = av_frame_alloc();
+	int video_index = input->demuxer.video_index();
+	int audio_index = input->has_audio ? input->demuxer.audio_index() : -1;
+
+	while (ok)
+	{
+		av_packet_unref(pkt);
+		if (!input->demuxer.Read(pkt)) break;
+
+		XDecoder* decoder = nullptr;
+		bool audio = false;
+		if (pkt->stream_index == video_index)
+		{
+			decoder = &input->video_decoder;
+		}
+		else if (pkt->stream_index == audio_index)
+		{
+			decoder = &input->audio_decoder;
+			audio = true;
+		}
+		if (!decoder) continue;
+
+		auto send_ret = decoder->SendPacket(pkt);
+		if (send_ret == XDecoder::SendResult::Failed)
+		{
+			ok = false;
+			break;
+		}
+		if (send_ret == XDecoder::SendResult::Ended) break;
+		ok = DrainDecoder(input, decoder, audio, frame);
+	}
+
+	// ȡл֡
+	if (ok && input->video_decoder.SendPacket(nullptr) != XDecoder::SendResult::Failed)
+	{
+		ok = DrainDecoder(input, &input->video_decoder, false, frame);
+	}
+	if (ok && input->has_audio && input->audio_decoder.SendPacket(nullptr) != XDecoder::SendResult::Failed)
+	{
+		ok = DrainDecoder(input, &input->audio_decoder, true, frame);
+	}
+
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	{
+		std::lock_guard<std::mutex> lock(input->mtx);
+		input->done = true;
+		input->failed = !ok && !input->stopping;
+	}
+	input->cv.notify_all();
+}
+
+bool XConcatSource::DrainDecoder(Input* input, XDecoder* decoder, bool audio, AVFrame* frame)
+{
+	while (true)
+	{
+		av_frame_unref(frame);
+		auto recv_ret = decoder->ReceiveFrame(frame);
+		if (recv_ret == XDecoder::ReceiveResult::Failed) return false;
+		if (recv_ret != XDecoder::ReceiveResult::Success) return true;
+		if (!Enqueue(input, frame, audio)) return false;
+	}
+}
+
+bool XConcatSource::Enqueue(Input* input, AVFrame* frame, bool audio)
+{
+	AVStream* stream = input->demuxer.GetAVFormatContext()->streams[
+		audio ? input->demuxer.audio_index() : input->demuxer.video_index()];
+	AVRational time_base = audio ? audio_time_base_ : video_time_base_;
+
+	// ʱ㣬תΪʱƫȡʱϣ
+	int64_t& next_pts = input->next_pts[audio ? 1 : 0];
+	int64_t pts = frame->best_effort_timestamp;
+	if (pts != AV_NOPTS_VALUE)
+	{
+		pts = av_rescale_q(pts, stream->time_base, time_base) - av_rescale_q(input->start_us, AV_TIME_BASE_Q, time_base);
+	}
+	else
+	{
+		pts = next_pts;
+	}
+	int64_t duration = 0;
+	if (audio && frame->sample_rate > 0)
+	{
+		duration = av_rescale_q(frame->nb_samples, AVRational{ 1, frame->sample_rate }, time_base);
+	}
+	else if (!audio)
+	{
+		duration = av_rescale_q(frame->duration, stream->time_base, time_base);
+	}
+	if (duration <= 0) duration = audio ? 0 : 1;
+	frame->pts = pts;
+	frame->duration = duration;
+	next_pts = pts + duration;
+
+	AVFrame* item = av_frame_alloc();
+	if (!item) return false;
+	av_frame_move_ref(item, frame);
+	int64_t bytes = XCodec::FrameBytes(item);
+
+	std::unique_lock<std::mutex> lock(input->mtx);
+	input->cv.wait(lock, [&] { return input->queue.size() < kQueueFrames || input->stopping; });
+	if (input->stopping)
+	{
+		av_frame_free(&item);
+		return false;
+	}
+	input->queue.push_back(Item{ item, audio });
+	if (memory_) memory_->Add(bytes);
+	lock.unlock();
+	input->cv.notify_all();
+	return true;
+}
+
+XConcatSource::ReadResult XConcatSource::Read(AVFrame* frame)
+{
+	if (current_ >= (int)inputs_.size()) return ReadResult::Ended;
+
+	Input* input = inputs_[current_].get();
+	std::unique_lock<std::mutex> lock(input->mtx);
+	if (input->queue.empty() && !input->done)
+	{
+		auto wait_start = std::chrono::steady_clock::now();
+		input->cv.wait(lock, [&] { return !input->queue.empty() || input->done; });
+		wait_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+	}
+
+	if (!input->queue.empty())
+	{
+		Item item = input->queue.front();
+		input->queue.pop_front();
+		lock.unlock();
+		input->cv.notify_all();
+
+		if (memory_) memory_->Sub(XCodec::FrameBytes(item.frame));
+		av_frame_move_ref(frame, item.frame);
+		av_frame_free(&item.frame);
+
+		AVRational time_base = item.audio ? audio_time_base_ : video_time_base_;
+		int64_t end_us = av_rescale_q(frame->pts + frame->duration, time_base, AV_TIME_BASE_Q);
+		if (end_us > input_end_us_) input_end_us_ = end_us;
+		frame->pts += offset(time_base);
+		return item.audio ? ReadResult::Audio : ReadResult::Video;
+	}
+
+	bool failed = input->failed;
+	lock.unlock();
+	if (failed)
+	{
+		std::cerr << "Error: decode concat input '" << input->file << "' failed!" << std::endl;
+		return ReadResult::Failed;
+	}
+
+	// ǰһڱĽʱ֮󣬲ʼԤȡһ
+	CloseInput(current_);
+	offset_us_ += input_end_us_;
+	input_end_us_ = 0;
+	current_++;
+	StartInput(current_ + 1);
+	return current_ < (int)inputs_.size() ? ReadResult::InputEnd : ReadResult::Ended;
+}
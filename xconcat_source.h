@@ -0,0 +1,117 @@
+// xconcat_source.h
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "xdemuxer.h"
+#include "xdecoder.h"
+#include "xmemory_budget.h"
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+struct AVFrame;
+struct AVCodecContext;
+
+/**
+ * @brief ƴԴ˳ļƬͷ桢ƬʱĽ֡
+ *
+ * ÿԼĽװͽ̣߳֡нС
+ * ǰͬʱһһ߳д򿪲Ԥ뵽У
+ * лʱ֡벻ȴļͽ𲽡
+ * ʱÿΪ 0֮ǰʱʱ䣩ں档
+ */
+class XConcatSource
+{
+public:
+	enum class ReadResult {
+		Video,		// ȡһƵ֡
+		Audio,		// ȡһƵ֡
+		InputEnd,	// һ֡ȫȡ֮һ֡
+		Ended,		// ȫѽ
+		Failed
+	};
+
+public:
+	~XConcatSource();
+
+	// 򿪵һ루ȡʱڴ memory
+	bool Open(const std::vector<std::string>& files, XMemoryCounter* memory);
+	// ʼ룬֡ pts תΪ video_time_base / audio_time_baseʱ
+	bool Start(AVRational video_time_base, AVRational audio_time_base);
+	void Close();
+
+	// ȡһ֡frame->ptsframe->duration Ϊ Start() ָʱΪʱȴ
+	ReadResult Read(AVFrame* frame);
+
+	// һĽ߳޹صĸûƵʱ audio_params() Ϊ nullptr
+	const AVCodecContext* video_params() const { return video_params_; }
+	const AVCodecContext* audio_params() const { return audio_params_; }
+
+	int input_count() const { return (int)inputs_.size(); }
+	// ǰ㣨time_base ʱInputEnd ֮Ϊһ
+	int current_input() const { return current_; }
+	const std::string& current_file() const;
+	int64_t offset(AVRational time_base) const;
+	// м¼ʱ֮ͣδ֪İ 0
+	double duration_seconds() const { return duration_seconds_; }
+	// ʱ루ͨΪƬ
+	const std::string& longest_file() const;
+	// Read() Ϊյȴۼʱ
+	double wait_seconds() const { return wait_seconds_; }
+
+private:
+	struct Item {
+		AVFrame* frame{ nullptr };
+		bool audio{ false };
+	};
+
+	struct Input {
+		std::string file;
+		double duration_seconds{ 0 };
+		XDemuxer demuxer;
+		XDecoder video_decoder;
+		XDecoder audio_decoder;
+		bool has_audio{ false };
+		int64_t start_us{ 0 };			// 㣨AV_TIME_BASE
+		int64_t next_pts[2]{ 0, 0 };	// ûʱʱһ֡㣨ƵƵ
+
+		std::thread thread;
+		std::mutex mtx;
+		std::condition_variable cv;
+		std::deque<Item> queue;
+		bool done{ false };
+		bool failed{ false };
+		bool stopping{ false };
+	};
+
+	bool OpenInput(Input* input);
+	void StartInput(int index);
+	void CloseInput(int index);
+	void DecodeLoop(Input* input);
+	// ȡе֡Уʱȴ false ʾֹͣ
+	bool DrainDecoder(Input* input, XDecoder* decoder, bool audio, AVFrame* frame);
+	bool Enqueue(Input* input, AVFrame* frame, bool audio);
+
+private:
+	std::vector<std::unique_ptr<Input>> inputs_;
+	XMemoryCounter* memory_{ nullptr };
+	AVCodecContext* video_params_{ nullptr };
+	AVCodecContext* audio_params_{ nullptr };
+	double duration_seconds_{ 0 };
+
+	AVRational video_time_base_{ 1, 25 };
+	AVRational audio_time_base_{ 1, 48000 };
+
+	// ȡˣת̣߳״̬
+	int current_{ 0 };
+	int64_t offset_us_{ 0 };		// ǰ
+	int64_t input_end_us_{ 0 };		// ǰȡ֡ʱ䣨㣩
+	double wait_seconds_{ 0 };
+};
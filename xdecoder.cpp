@@ -1,6 +1,7 @@
 //xdecoder.cpp
 #include "xdecoder.h"
 #include <iostream>
+#include "xlog.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -10,12 +11,14 @@ extern "C" {
 #pragma comment(lib, "avutil.lib")
 
 XCodec::SendResult XDecoder::SendPacket(AVPacket* packet) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<XCountedMutex> lock(mtx_);
     if (!context_) return SendResult::Failed;
 
     int ret = avcodec_send_packet(context_, packet);
     if (ret == 0) 
     {
+        // ÿնӦһ֡ڻ֡
+        if (packet) OnInput(0);
         return SendResult::Success;
     }
 
@@ -31,21 +34,20 @@ XCodec::SendResult XDecoder::SendPacket(AVPacket* packet) {
     
     if(ret < 0)
     {
-        char errbuf[256];
-        av_strerror(ret, errbuf, sizeof(errbuf));
-        std::cerr << "avcodec_send_packet failed: " << errbuf << std::endl;
+        XLog::Instance().WriteAvError(XLogLevel::Error, "XDecoder::SendPacket", "avcodec_send_packet failed", ret);
         return SendResult::Failed;
     }
     return SendResult::Failed;  // unreachable
 }
 
 XCodec::ReceiveResult XDecoder::ReceiveFrame(AVFrame* frame) {
-    std::lock_guard<std::mutex> lock(mtx_);
+    std::lock_guard<XCountedMutex> lock(mtx_);
     if (!context_ || !frame) return ReceiveResult::Failed;
 
     int ret = avcodec_receive_frame(context_, frame);
     if (ret == 0) 
     {
+        OnOutput(FrameBytes(frame));
         return ReceiveResult::Success;
     }
 
@@ -56,15 +58,23 @@ XCodec::ReceiveResult XDecoder::ReceiveFrame(AVFrame* frame) {
 
     if (ret == AVERROR_EOF) 
     {
+        pending_units_ = 0;
+        memory_.Set(0);
         return ReceiveResult::Ended;
     }
 
     if(ret < 0)
     {
-        char errbuf[1024];
-        av_strerror(ret, errbuf, sizeof(errbuf));
-        std::cerr << "avcodec_receive_frame failed: " << errbuf << std::endl;
+        XLog::Instance().WriteAvError(XLogLevel::Error, "XDecoder::ReceiveFrame", "avcodec_receive_frame failed", ret);
         return ReceiveResult::Failed;
     }
     return ReceiveResult::Failed;   // unreachable
+}
+
+void XDecoder::Flush() {
+    std::lock_guard<XCountedMutex> lock(mtx_);
+    if (!context_) return;
+    avcodec_flush_buffers(context_);
+    pending_units_ = 0;
+    memory_.Set(0);
 }
\ No newline at end of file
@@ -9,4 +9,6 @@ class XDecoder : public XCodec {
 public:
     SendResult SendPacket(AVPacket* packet);
     ReceiveResult ReceiveFrame(AVFrame* frame);
+    // սڲ沢˳״̬֮ɴµĹؼ֡½
+    void Flush();
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "xdemuxer.h"
+#include "xlog.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -46,7 +47,7 @@ bool XDemuxer::Open(std::string file)
 bool XDemuxer::CopyPara(int stream_index, AVCodecContext* dec_ctx)
 {
 	// Ʋ
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (avcodec_parameters_to_context(dec_ctx, fmt_ctx_->streams[stream_index]->codecpar) < 0) {
 		std::cerr << "Error: Failed to copy decoder parameters" << std::endl;
 		return false;
@@ -56,11 +57,26 @@ bool XDemuxer::CopyPara(int stream_index, AVCodecContext* dec_ctx)
 
 bool XDemuxer::Read(AVPacket* pkt)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!fmt_ctx_) return false;
-	if (av_read_frame(fmt_ctx_, pkt) < 0)
+	int ret = av_read_frame(fmt_ctx_, pkt);
+	if (ret < 0)
 	{
-		std::cerr << "Error: Failed to read frame!" << std::endl;
+		// ļβ
+		XLog::Instance().WriteAvError(ret == AVERROR_EOF ? XLogLevel::Debug : XLogLevel::Error,
+			"XDemuxer::Read", "av_read_frame failed", ret);
+		return false;
+	}
+	return true;
+}
+
+bool XDemuxer::Seek(int stream_index, int64_t timestamp)
+{
+	std::lock_guard<XCountedMutex> lock(mtx_);
+	if (!fmt_ctx_) return false;
+	if (av_seek_frame(fmt_ctx_, stream_index, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+	{
+		std::cerr << "Error: Failed to seek to " << timestamp << "!" << std::endl;
 		return false;
 	}
 	return true;
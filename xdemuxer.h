@@ -14,6 +14,8 @@ public:
     //  -> 
     bool CopyPara(int stream_index, AVCodecContext* dec_ctx);
     bool Read(AVPacket* pkt);
+    // λ timestampstream_index ʱ֮ǰĹؼ֡
+    bool Seek(int stream_index, int64_t timestamp);
     bool Close();
 };
 
@@ -3,10 +3,12 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include "xlog.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>    // Ĺ
 #include <libavutil/avutil.h>      // ߺ
+#include <libavutil/opt.h>
 }
 
 #pragma comment(lib, "avcodec.lib")
@@ -15,7 +17,7 @@ extern "C" {
 
 XEncoder::SendResult XEncoder::SendFrame(AVFrame* frame)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!context_) return SendResult::Failed;
 
 	//  frame == nullptr
@@ -24,6 +26,14 @@ XEncoder::SendResult XEncoder::SendFrame(AVFrame* frame)
 	{
 		//ɹͨ֡  
 		//ɹύ flush frame == nullptr
+		// ֡ȡӦİ֮ǰڱУlookaheadB ֡ţ
+		if (frame) OnInput(FrameBytes(frame));
+		if (frame && packet_info_enabled_ && frame->pts != AV_NOPTS_VALUE)
+		{
+			// ֡ʱӦļ¼ȡ޺
+			if (send_times_.size() >= 1024) send_times_.erase(send_times_.begin());
+			send_times_[frame->pts] = std::chrono::steady_clock::now();
+		}
 		return SendResult::Success;
 	}
 	if (ret == AVERROR(EAGAIN))
@@ -40,10 +50,7 @@ XEncoder::SendResult XEncoder::SendFrame(AVFrame* frame)
 	if (ret < 0) 
 	{
 		//֡ʧܣ޷䷢֡
-		char buff[1024]{ 0 };
-
-		av_strerror(ret, buff, sizeof(buff));
-		std::cerr << buff << std::endl;
+		XLog::Instance().WriteAvError(XLogLevel::Error, "XEncoder::SendFrame", "avcodec_send_frame failed", ret);
 		return SendResult::Failed;
 	}
 	return SendResult::Failed;	// unreachable
@@ -51,13 +58,15 @@ XEncoder::SendResult XEncoder::SendFrame(AVFrame* frame)
 
 XEncoder::ReceiveResult XEncoder::ReceivePacket(AVPacket* packet)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!context_) return ReceiveResult::Failed;
 	int ret = avcodec_receive_packet(context_, packet);
 
 	if (ret == 0) 
 	{
 		//ɹȡݰ
+		OnOutput(0);
+		if (packet_info_enabled_) FillPacketInfo(packet);
 		return ReceiveResult::Success;
 	}
 	if (ret == AVERROR(EAGAIN))
@@ -71,17 +80,114 @@ XEncoder::ReceiveResult XEncoder::ReceivePacket(AVPacket* packet)
 	{
 		//ѱȫˢ£Ҳиݰ
 		//ֹͣݣ
+		pending_units_ = 0;
+		memory_.Set(0);
 		return ReceiveResult::Ended;
 	}
 	if (ret < 0)
 	{
 		//ݰʧܣ޷䷢֡
-		char buff[1024]{ 0 };
-
-		av_strerror(ret, buff, sizeof(buff));
-		std::cerr << buff << std::endl;
+		XLog::Instance().WriteAvError(XLogLevel::Error, "XEncoder::ReceivePacket", "avcodec_receive_packet failed", ret);
 		return ReceiveResult::Failed;
 	}
 
 	return ReceiveResult::Failed;	// unreachable
 }
+
+void XEncoder::EnablePacketInfo(bool enable)
+{
+	std::lock_guard<XCountedMutex> lock(mtx_);
+	packet_info_enabled_ = enable;
+	send_times_.clear();
+}
+
+void XEncoder::FillPacketInfo(const AVPacket* packet)
+{
+	packet_info_ = XPacketInfo();
+	packet_info_.pts = packet->pts;
+	packet_info_.dts = packet->dts;
+	packet_info_.size = packet->size;
+	packet_info_.key = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+	// QUALITY_STATSǰ 4 ֽΪ qualityQP * FF_QP2LAMBDAСˣ 5 ֽΪ֡
+	size_t sd_size = 0;
+	const uint8_t* sd = av_packet_get_side_data(packet, AV_PKT_DATA_QUALITY_STATS, &sd_size);
+	if (sd && sd_size >= 5)
+	{
+		uint32_t quality = sd[0] | (sd[1] << 8) | (sd[2] << 16) | ((uint32_t)sd[3] << 24);
+		packet_info_.qp = (double)quality / FF_QP2LAMBDA;
+		packet_info_.pict_type = av_get_picture_type_char((AVPictureType)sd[4]);
+	}
+	else if (packet_info_.key)
+	{
+		packet_info_.pict_type = 'I';
+	}
+
+	auto it = send_times_.find(packet->pts);
+	if (it != send_times_.end())
+	{
+		packet_info_.latency_ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - it->second).count();
+		send_times_.erase(it);
+	}
+}
+
+bool XEncoder::SetParallelTiles(int tiles)
+{
+	AVCodecContext* ctx = GetContext();
+	if (!ctx || !ctx->codec || tiles <= 1) return false;
+	std::string name = ctx->codec->name;
+
+	// tile  2 ȡڸߣ
+	int log2 = 0;
+	while ((2 << log2) <= tiles) log2++;
+	int log2_cols = (log2 + 1) / 2;
+	int log2_rows = log2 / 2;
+	char params[128];
+
+	if (name == "libaom-av1" || name == "libvpx-vp9")
+	{
+		// ѡֵΪ log2row-mt ÿ tile ڵҲ
+		if (!SetOpt("tile-columns", log2_cols)) return false;
+		SetOpt("tile-rows", log2_rows);
+		SetOpt("row-mt", 1);
+		return true;
+	}
+	if (name == "libsvtav1")
+	{
+		snprintf(params, sizeof(params), "tile-columns=%d:tile-rows=%d", log2_cols, log2_rows);
+		return AppendOpt("svtav1-params", params);
+	}
+	if (name == "libx264")
+	{
+		// ̣߳һ֡ĸб루̣֡߳ӳҲͣ
+		snprintf(params, sizeof(params), "sliced-threads=1:slices=%d", tiles);
+		return AppendOpt("x264-params", params);
+	}
+	if (name == "libx265")
+	{
+		snprintf(params, sizeof(params), "slices=%d", tiles);
+		return AppendOpt("x265-params", params);
+	}
+	if (ctx->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)
+	{
+		std::lock_guard<XCountedMutex> lock(mtx_);
+		context_->slices = tiles;
+		context_->thread_type = FF_THREAD_SLICE;
+		return true;
+	}
+	return false;
+}
+
+bool XEncoder::AppendOpt(const std::string& key, const std::string& params)
+{
+	uint8_t* current = nullptr;
+	{
+		std::lock_guard<XCountedMutex> lock(mtx_);
+		if (!context_ || av_opt_get(context_->priv_data, key.c_str(), 0, &current) < 0) return false;
+	}
+	std::string value = params;
+	if (current && current[0]) value = std::string((const char*)current) + ":" + params;
+	av_free(current);
+	return SetOpt(key, value);
+}
@@ -2,6 +2,8 @@
 #pragma once
 #include "xcodec.h"
 #include <vector>
+#include <map>
+#include <chrono>
 #include <functional>
 
 extern "C" {
@@ -12,6 +14,18 @@ struct AVFrame;
 struct AVPacket;
 struct AVCodecParameters;
 
+// ֡ϢEnablePacketInfo(true)  ReceivePacket() д
+struct XPacketInfo
+{
+    int64_t pts{ 0 };           // ʱ
+    int64_t dts{ 0 };
+    int size{ 0 };              // ֽ
+    char pict_type{ '?' };      // I/P/BδṩʱΪ '?'
+    bool key{ false };
+    double qp{ -1 };            // δṩ QUALITY_STATS ݣʱΪ -1
+    double latency_ms{ -1 };    // SendFrame() ȡðʱ䣬δ֪ʱΪ -1
+};
+
 class XEncoder :
     public XCodec
 {
@@ -19,5 +33,23 @@ public:
     //  
     SendResult SendFrame(AVFrame* frame);
     ReceiveResult ReceivePacket(AVPacket* packet);
+
+    // ֡Ϣ SendFrame()  pts ¼ʱ䣬ReceivePacket() ɹʱд last_packet_info()
+    void EnablePacketInfo(bool enable);
+    const XPacketInfo& last_packet_info() const { return packet_info_; }
+
+    // ڷֿ鲢У Open() ǰãAV1/VP9  tile /УH.264/H.265 
+    // ̵֧߳ı slices֧ʱ falseò
+    bool SetParallelTiles(int tiles);
+
+private:
+    void FillPacketInfo(const AVPacket* packet);
+    //  x264-params  "k=v:k=v" ʽ˽ѡ׷Ӳõģٶȵλ
+    bool AppendOpt(const std::string& key, const std::string& params);
+
+private:
+    bool packet_info_enabled_{ false };
+    std::map<int64_t, std::chrono::steady_clock::time_point> send_times_;   // pts -> ʱ
+    XPacketInfo packet_info_;
 };
 
@@ -2,13 +2,24 @@
 #include "xfile_transcoder.h"
 #include "xencoder.h"
 #include "xdecoder.h"
+#include "xlog.h"
+#include "xcomplexity_analyzer.h"
+#include "xconcat_source.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libavformat/avio.h>        // I/Oر־
 #include <libavutil/error.h>
 }
@@ -17,6 +28,7 @@ extern "C" {
 #pragma comment(lib, "avcodec.lib")
 #pragma comment(lib, "avutil.lib")
 #pragma comment(lib, "swscale.lib")
+#pragma comment(lib, "swresample.lib")
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -36,71 +48,258 @@ bool XFileTranscoder::Transcode(
 	int fps
 )
 {
-	// Ƶװ
-	demuxer_ = new XDemuxer();
-	// Ƶװ
-	muxer_ = new XMuxer();
+	return Transcode(std::vector<std::string>{ input_file }, output_file,
+		output_width, output_height, output_codec_id, bitrate_kbps, fps);
+}
 
-	// 򿪽װ
-	if (!demuxer_->Open(input_file))
+bool XFileTranscoder::Transcode(
+	const std::vector<std::string>& input_files,
+	const std::string& output_file,
+	int output_width, int output_height,
+	AVCodecID output_codec_id,
+	int bitrate_kbps,
+	int fps
+)
+{
+	if (input_files.empty())
 	{
-		std::cerr << "Error: Cannot open demuxer in '" << input_file << "'" << std::endl;
+		std::cerr << "Error: no input file!" << std::endl;
 		return false;
 	}
+	const std::string& input_file = input_files[0];
+	bool concat = input_files.size() > 1;
+
+	auto start_time = std::chrono::steady_clock::now();
+	cancel_requested_.store(false, std::memory_order_relaxed);
+	// FFmpeg ڲ־첽־̱߳
+	XLog::RouteFFmpegLog();
+	stats_ = XTranscodeStats();
+	output_width_ = output_width;
+	output_height_ = output_height;
+	output_codec_id_ = output_codec_id;
+	bitrate_kbps_ = bitrate_kbps;
+	fps_ = fps;
+	// ٶȿڴƵǰʼλ
+	speed_controller_.Start(realtime_speed_ * fps);
+
+	// 棺ֱʹϴε
+	std::string cache_key;
+	bool use_cache = cache_ && !concat && segment_mode_ != XMuxer::SegmentMode::HLS;
+	if (use_cache)
+	{
+		cache_key = cache_->MakeKey(input_file, OutputParams(output_file));
+		if (cache_->Fetch(cache_key, output_file))
+		{
+			std::cout << "Cache hit: '" << input_file << "' -> '" << output_file << "'" << std::endl;
+			stats_.cache_hit = true;
+			return true;
+		}
+	}
 
-	// ƵƵϢ
-	av_dump_format(demuxer_->GetAVFormatContext(), demuxer_->video_index(), nullptr, 0);
-
-	// Ƶ
-	video_decoder_ = SetupDecoder(demuxer_->video_index());
-	if (!video_decoder_)
+	// ڴѳԤʱ
+	XMemoryBudget& budget = XMemoryBudget::Instance();
+	if (budget.Exceeded())
 	{
-		std::cerr << "Error: setup viedo decoder failed!" << std::endl;
+		std::cerr << "Error: memory budget exceeded (" << budget.counter().current() << " / "
+			<< budget.limit() << " bytes), job refused!" << std::endl;
 		return false;
 	}
+	// NUMA ãڴ̺߳ͷ֮֡ǰ󶨡˺ʧܷض뾭 Cleanup()
+	// ͷѴĶ󲢽󶨡黹ڵ
+	ReleaseNumaNode();
+	if (numa_enabled_ && XNuma::Instance().node_count() > 1)
+	{
+		int node = numa_node_;
+		if (node < 0)
+		{
+			node = XNuma::Instance().AcquireNode();
+			numa_acquired_node_ = node;
+		}
+		if (numa_binding_.Bind(node))
+		{
+			stats_.numa_node = node;
+		}
+		else
+		{
+			std::cerr << "Warning: bind to NUMA node " << node << " failed!" << std::endl;
+		}
+	}
 
-	// ƵƵ
-	audio_decoder_ = SetupDecoder(demuxer_->audio_index());
-	if (!audio_decoder_)
+	job_memory_.SetParent(&budget.counter());
+	for (XMemoryCounter* counter : { &decode_memory_, &encode_memory_, &mux_memory_ })
 	{
-		std::cerr << "Warning: setup audio decoder failed!" << std::endl;
-		//return false;
+		counter->SetParent(&job_memory_);
+		counter->ResetPeak();
+	}
+	job_memory_.ResetPeak();
+
+	// Ƶװ
+	muxer_ = new XMuxer();
+	muxer_->memory().SetParent(&mux_memory_);
+	muxer_->SetSegmentMode(segment_mode_, segment_seconds_);
+
+	if (concat)
+	{
+		// ƴӣһڴ˴򿪣ڽ߳δ
+		concat_ = new XConcatSource();
+		if (!concat_->Open(input_files, &decode_memory_))
+		{
+			std::cerr << "Error: open concat inputs failed!" << std::endl;
+			Cleanup();
+			return false;
+		}
+	}
+	else
+	{
+		// Ƶװ
+		demuxer_ = new XDemuxer();
+
+		// 򿪽װ
+		if (!demuxer_->Open(input_file))
+		{
+			std::cerr << "Error: Cannot open demuxer in '" << input_file << "'" << std::endl;
+			Cleanup();
+			return false;
+		}
+
+		// ƵƵϢ
+		av_dump_format(demuxer_->GetAVFormatContext(), demuxer_->video_index(), nullptr, 0);
+
+		// Ƶ
+		video_decoder_ = SetupDecoder(demuxer_->video_index());
+		if (!video_decoder_)
+		{
+			std::cerr << "Error: setup viedo decoder failed!" << std::endl;
+			Cleanup();
+			return false;
+		}
+
+		// ƵƵ
+		audio_decoder_ = SetupDecoder(demuxer_->audio_index());
+		if (!audio_decoder_)
+		{
+			std::cerr << "Warning: setup audio decoder failed!" << std::endl;
+			//return false;
+		}
+	}
+
+	// ݸӶԤƬԴƼʣʧʱôʣƴʱ
+	if (auto_bitrate_ && !ApplyAutoBitrate(concat ? concat_->longest_file() : input_file))
+	{
+		std::cerr << "Warning: complexity analysis failed, using " << bitrate_kbps_ << " kbps" << std::endl;
 	}
 
 	// Ƶ
 	video_encoder_ = SetupVideoEncoder(
-		demuxer_->video_index(),
 		output_width, output_height,
 		output_codec_id,
-		bitrate_kbps,
+		bitrate_kbps_,
 		fps
 	);
 	if (!video_encoder_)
 	{
 		std::cerr << "Error: setup video encoder failed!" << std::endl;
+		Cleanup();
 		return false;
 	}
 
 	// Ƶ
-	audio_encoder_ = SetupAudioEncoder(demuxer_->audio_index());
+	audio_encoder_ = SetupAudioEncoder();
 	if (!audio_encoder_)
 	{
 		std::cerr << "Warning: setup audio encoder failed!" << std::endl;
 		//return false;
 	}
 
+	// ϵϴжϵķֶμ
+	if (!PrepareResume(input_file, output_file))
+	{
+		std::cerr << "Error: resume from checkpoint failed!" << std::endl;
+		Cleanup();
+		return false;
+	}
+
+	// 뷶Χ֮ǰĹؼ֡ʼȡ
+	range_video_done_ = false;
+	range_audio_done_ = false;
+	if (concat && (range_start_ != AV_NOPTS_VALUE || range_end_ != AV_NOPTS_VALUE))
+	{
+		std::cerr << "Warning: input range is not supported for concatenated inputs, ignored!" << std::endl;
+	}
+	if (!concat && range_start_ != AV_NOPTS_VALUE &&
+		!demuxer_->Seek(demuxer_->video_index(), range_start_))
+	{
+		std::cerr << "Error: seek to input range failed!" << std::endl;
+		Cleanup();
+		return false;
+	}
+
+	// ȵʱҲڿ moov С
+	SetupProgress();
+	if (fast_start_) muxer_->SetFastStart(true, progress_.duration_seconds);
+
+	// ǻĿӲӣɾдĻݣ񱻾ܾǰʧʱԭ
+	if (use_cache) std::remove(output_file.c_str());
+
 	// 򿪷װ
 	if (!muxer_->Open(output_file,
 		video_encoder_ ? video_encoder_->GetContext() : nullptr,
 		audio_encoder_ ? audio_encoder_->GetContext() : nullptr))
 	{
 		std::cerr << "Error: muxer open failed!" << std::endl;
+		Cleanup();
 		return false;
 	}
 
 	if (!muxer_->WriteHeader())
 	{
 		std::cerr << "Error: Write header failed" << std::endl;
+		Cleanup();
+		return false;
+	}
+
+	// ֡ͳ·ļ
+	if (frame_stats_enabled_ &&
+		!frame_stats_.Open(output_file + ".frames.csv", video_encoder_->GetContext()->time_base))
+	{
+		std::cerr << "Warning: frame stats disabled for this job" << std::endl;
+	}
+
+	// ԭʼ֡·ڴڵһ֡ʱ֡ߴ紴
+	if (!frame_tap_name_.empty() &&
+		!frame_tap_.Open(frame_tap_name_, frame_tap_slots_, video_encoder_->GetContext()->time_base))
+	{
+		std::cerr << "Warning: frame tap disabled for this job" << std::endl;
+	}
+
+	// ׷٣ļͷ¼ͱطŰ䴴ͱ
+	if (!packet_trace_path_.empty())
+	{
+		if (concat_)
+		{
+			std::cerr << "Warning: packet trace is not supported with multiple inputs, ignored" << std::endl;
+		}
+		else if (!packet_trace_.Open(packet_trace_path_, demuxer_->GetAVFormatContext(),
+			demuxer_->video_index(), demuxer_->audio_index(), video_encoder_->GetContext(),
+			audio_encoder_ ? audio_encoder_->GetContext() : nullptr, packet_trace_data_))
+		{
+			std::cerr << "Warning: packet trace disabled for this job" << std::endl;
+		}
+	}
+
+	// ĽѴ򿪵Ƶ
+	if (quality_enabled_ &&
+		!quality_meter_.Open(video_encoder_->GetContext(), fps * quality_interval_seconds_, quality_window_frames_))
+	{
+		std::cerr << "Warning: quality meter disabled for this job" << std::endl;
+	}
+
+	// ƴӣʱȷʼ뵱ǰ벢Ԥȡһ
+	if (concat_ && !concat_->Start(video_encoder_->GetContext()->time_base,
+		audio_encoder_ ? audio_encoder_->GetContext()->time_base : AVRational{ 1, 48000 }))
+	{
+		std::cerr << "Error: start concat decoding failed!" << std::endl;
+		Cleanup();
 		return false;
 	}
 
@@ -108,196 +307,175 @@ bool XFileTranscoder::Transcode(
 	AVFrame* frame = av_frame_alloc();
 	// ʼ֡ʹãҲ䣬 nullptr 飩
 	scaled_video_frame_ = av_frame_alloc();
-
-	XDecoder* decoder = nullptr;
-	XEncoder* encoder = nullptr;
-	AVStream* out_stream = nullptr;
-	AVStream* in_stream = nullptr;
-	int stream_index = 0;
+	last_video_frame_ = av_frame_alloc();
+	frame_diff_.Reset();
+	BuildStreamPipelines();
 
 	video_frame_counter_ = 0;
 	audio_frame_counter_ = 0;
+	// ָʱöϵеê㣬ֶα߽жǰһ
+	keyframe_anchored_ = resuming_;
+	keyframe_anchor_pts_ = resuming_ ? checkpoint_.first_pts : 0;
+	next_keyframe_pts_ = resuming_ ? checkpoint_.resume_pts : 0;
 	bool is_successed = true;
 	// ѭ
 	while (true)
 	{
 		av_packet_unref(pkt);
-		if (!demuxer_->Read(pkt))
+		// Խ뷶Χյֹͣȡ
+		if (range_video_done_ && (range_audio_done_ || !audio_encoder_))
 		{
 			break;
 		}
-
-		if (pkt->stream_index == demuxer_->video_index())
-		{
-			decoder = video_decoder_;
-			encoder = video_encoder_;
-		}
-		else if (pkt->stream_index == demuxer_->audio_index())
-		{
-			decoder = audio_decoder_;
-			encoder = audio_encoder_;
-		}
-
-		stream_index = pkt->stream_index;
-		in_stream = demuxer_->GetAVFormatContext()->streams[stream_index];
-		out_stream = muxer_->GetAVFormatContext()->streams[stream_index];
-
-		auto send_ret = decoder->SendPacket(pkt);
-		if (send_ret == XDecoder::SendResult::Failed)
+		if (IsCancelled())
 		{
 			is_successed = false;
 			goto cleanup;
 		}
-		if (send_ret == XDecoder::SendResult::Ended)
+		// ڴԤ㣺ͣȡͷţֻбռʱȴ
+		if (budget.Exceeded())
 		{
-			break;
+			stats_.throttled_seconds += budget.WaitForRoom(job_memory_.current(), 1000, &cancel_requested_) / 1000.0;
 		}
+		UpdateMemoryStats();
 
-		while (true)
+		// ƴӣȡ߳ѽ֡ʱѽתΪʱ
+		if (concat_)
 		{
 			av_frame_unref(frame);
-			auto recv_ret = decoder->ReceiveFrame(frame);
-			if (recv_ret == XDecoder::ReceiveResult::Failed)
+			auto read_ret = concat_->Read(frame);
+			if (read_ret == XConcatSource::ReadResult::Failed)
 			{
 				is_successed = false;
 				goto cleanup;
 			}
-			if (recv_ret == XDecoder::ReceiveResult::NeedFeed ||
-				recv_ret == XDecoder::ReceiveResult::Ended)
+			if (read_ret == XConcatSource::ReadResult::Ended)
 			{
 				break;
 			}
-
-			// ؼ1ʱתʱ  ʱ
-			int64_t pts = frame->best_effort_timestamp; // FFmpeg Ƽʱ
-			if (pts != AV_NOPTS_VALUE) {
-				frame->pts = av_rescale_q(pts,
-					in_stream->time_base,
-					encoder->GetContext()->time_base);
-			}
-			else {
-				// ûԭʼʱʹ֡
-				if (stream_index == demuxer_->video_index())
-				{
-					frame->pts = video_frame_counter_++;
-				}
-				else if (stream_index == demuxer_->audio_index())
-				{
-					frame->pts = audio_frame_counter_++;
-				}
-			}
-			// Ҫģpict_typeñԶ
-			frame->pict_type = AV_PICTURE_TYPE_NONE;
-
-			// ֡Ŵ
-			AVFrame* frame_to_encode = frame;
-			if (stream_index == demuxer_->video_index() && sws_video_ctx_)
+			if (read_ret == XConcatSource::ReadResult::InputEnd)
 			{
-				int dst_width = video_encoder_->GetContext()->width;
-				int dst_height = video_encoder_->GetContext()->height;
-				AVPixelFormat dst_pix_fmt = video_encoder_->GetContext()->pix_fmt;
-
-				if (scaled_video_frame_->width != dst_width ||
-					scaled_video_frame_->height != dst_height ||
-					scaled_video_frame_->format != dst_pix_fmt)
+				// Ƶһ㣬ͬ
+				if (audio_encoder_ &&
+					!audio_resampler_.PadTo(concat_->offset(audio_encoder_->GetContext()->time_base)))
 				{
-					// ͷžɻ
-					av_frame_unref(scaled_video_frame_);
-
-					// ²
-					scaled_video_frame_->width = dst_width;
-					scaled_video_frame_->height = dst_height;
-					scaled_video_frame_->format = dst_pix_fmt;
-
-					if (av_frame_get_buffer(scaled_video_frame_, 0) < 0)
-					{
-						std::cerr << "Error: av_frame_get_buffer for scaled frame failed!" << std::endl;
-						is_successed = false;
-						goto cleanup;
-					}
-				}
-
-				// ִ
-				int ret = sws_scale(sws_video_ctx_,
-					frame->data, frame->linesize, 0, frame->height,
-					scaled_video_frame_->data, scaled_video_frame_->linesize);
-				if (ret < 0) {
-					std::cerr << "Error: sws_scale failed!" << std::endl;
 					is_successed = false;
 					goto cleanup;
 				}
-
-				scaled_video_frame_->pts = frame->pts;
-				scaled_video_frame_->pkt_dts = frame->pkt_dts;
-				scaled_video_frame_->best_effort_timestamp = frame->best_effort_timestamp;
-				scaled_video_frame_->key_frame = frame->key_frame;
-				scaled_video_frame_->pict_type = AV_PICTURE_TYPE_NONE;
-
-				frame_to_encode = scaled_video_frame_;
+				char buff[512] = { 0 };
+				snprintf(buff, sizeof(buff), "concat input %d/%d '%s' at %.3fs",
+					concat_->current_input() + 1, concat_->input_count(), concat_->current_file().c_str(),
+					concat_->offset(AVRational{ 1, 1000 }) / 1000.0);
+				stats_.AddEvent(buff);
+				continue;
 			}
 
-			auto send_ret = encoder->SendFrame(frame_to_encode);
-			if (send_ret == XEncoder::SendResult::Failed)
+			frame->pict_type = AV_PICTURE_TYPE_NONE;
+			bool ok = (read_ret == XConcatSource::ReadResult::Audio) ? EncodeAudioFrame(frame) : EncodeVideoFrame(frame);
+			if (!ok)
 			{
 				is_successed = false;
 				goto cleanup;
 			}
-			if (send_ret == XEncoder::SendResult::Ended)
-			{
-				break;
-			}
-
-			while (true)
-			{
-				av_packet_unref(pkt);
-				auto recv_ret = encoder->ReceivePacket(pkt);
-				if (recv_ret == XEncoder::ReceiveResult::Failed)
-				{
-					is_successed = false;
-					goto cleanup;
-				}
-				if (recv_ret == XEncoder::ReceiveResult::Ended ||
-					recv_ret == XEncoder::ReceiveResult::NeedFeed)
-				{
-					break;
-				}
-
-				// ؼ2תʱ
-				if (!out_stream) break;
+			continue;
+		}
 
-				pkt->pts = av_rescale_q(pkt->pts,
-					encoder->GetContext()->time_base,
-					out_stream->time_base);
-				pkt->dts = av_rescale_q(pkt->dts,
-					encoder->GetContext()->time_base,
-					out_stream->time_base);
+		// ׷ٵĽ׶μʱδ׷ʱΪ 0ʱӣ
+		int64_t trace_read_start = packet_trace_.Now();
+		if (!demuxer_->Read(pkt))
+		{
+			break;
+		}
+		int64_t trace_read_end = packet_trace_.Now();
 
-				pkt->stream_index = stream_index;
-				if (!muxer_->Write(pkt))
-				{
-					is_successed = false;
-					goto cleanup;
-				}
-			}
+		// Խװʱֻ;
+		if (pkt->stream_index < 0 || pkt->stream_index >= (int)stream_slots_.size()) continue;
+		StreamSlot& slot = stream_slots_[pkt->stream_index];
+		auto decode_ret = (this->*slot.handler)(slot, pkt);
+		if (decode_ret == DecodeResult::Failed)
+		{
+			is_successed = false;
+			goto cleanup;
+		}
+		if (decode_ret == DecodeResult::Ended)
+		{
+			break;
+		}
+		if (packet_trace_.is_open())
+		{
+			packet_trace_.Write(pkt, trace_read_start, trace_read_end, packet_trace_.Now(), slot.encode_us, slot.frames);
 		}
 	}
 
-	// ˢ½
-	FlushDecoder();
-	FlushEncoder();
+	// ˢ½ȡˢ£ֱ
+	if (IsCancelled() || !FlushDecoder() || IsCancelled() || !FlushEncoder() || IsCancelled())
+	{
+		is_successed = false;
+		goto cleanup;
+	}
 
 	if (!muxer_->WriteTrailer())
 	{
 		is_successed = false;
 		goto cleanup;
 	}
+	if (muxer_->fast_start_reserved() > 0)
+	{
+		char buff[256] = { 0 };
+		snprintf(buff, sizeof(buff), "fast start: %lld bytes reserved for moov, %s",
+			(long long)muxer_->fast_start_reserved(),
+			muxer_->fast_start_shifted() ? "estimate too small, data shifted" : "written in place");
+		stats_.AddEvent(buff);
+	}
+
+	// ϵ㲻Ҫ
+	if (!checkpoint_path_.empty())
+	{
+		XCheckpoint::Remove(checkpoint_path_);
+	}
+	ReportProgress(nullptr, true);
 
 cleanup:
 	av_packet_free(&pkt);
 	av_frame_free(&frame);
 
-	// Դ
+	stats_.elapsed_seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start_time).count();
+
+	if (concat_)
+	{
+		char buff[256] = { 0 };
+		snprintf(buff, sizeof(buff), "concat: %d inputs, encoder waited %.3fs for decoding",
+			concat_->input_count(), concat_->wait_seconds());
+		stats_.AddEvent(buff);
+	}
+
+	// Դڴ˵ȴ̴߳ύĴڣ
 	Cleanup();
+	if (quality_enabled_) stats_.quality = quality_meter_.stats();
+	if (!frame_tap_name_.empty())
+	{
+		char buff[256] = { 0 };
+		snprintf(buff, sizeof(buff), "frame tap '%s': %lld frames published, %lld skipped",
+			frame_tap_name_.c_str(), (long long)frame_tap_.published(), (long long)frame_tap_.skipped());
+		stats_.AddEvent(buff);
+	}
+	if (packet_trace_.records() > 0)
+	{
+		char buff[512] = { 0 };
+		snprintf(buff, sizeof(buff), "packet trace '%s': %lld packets%s",
+			packet_trace_path_.c_str(), (long long)packet_trace_.records(), packet_trace_data_ ? " with data" : "");
+		stats_.AddEvent(buff);
+	}
+	UpdateMemoryStats();
+	XLog::Instance().Flush();
+	stats_.Print(std::cout);
+
+	// ļرպٴ뻺
+	if (is_successed && !cache_key.empty())
+	{
+		cache_->Store(cache_key, output_file);
+	}
 	return is_successed;
 
 }
@@ -327,30 +505,70 @@ XDecoder* XFileTranscoder::SetupDecoder(int stream_index)
 		std::cerr << "Error: Failed to open decoder!" << std::endl;
 		return nullptr;
 	}
+	decoder->memory().SetParent(&decode_memory_);
 
 	return decoder;
 }
 
-// Ƶֲ䣬ֱʹ˽еĲҲеĲ
-// ҪģӲһӿںƵ
-XEncoder* XFileTranscoder::SetupAudioEncoder(int stream_index)
+// Ƶδʱͬʽȡֵֵ֧
+// ͬĲ audio_resampler_ ת
+XEncoder* XFileTranscoder::SetupAudioEncoder()
 {
-	if (stream_index < 0) return nullptr;
+	const AVCodecContext* dec_ctx = AudioInputContext();
+	if (!dec_ctx) return nullptr;
 	XEncoder* encoder = new XEncoder();
 	// 
-	AVCodecID codec_id = audio_decoder_->GetContext()->codec_id;
+	AVCodecID codec_id = (audio_codec_id_ != AV_CODEC_ID_NONE) ? audio_codec_id_ : dec_ctx->codec_id;
 	if (!encoder->Create(codec_id))
 	{
 		std::cerr << "Error: encoder create failed!" << std::endl;
 		delete encoder;
 		return nullptr;
 	}
+	AVCodecContext* enc_ctx = encoder->GetContext();
+	const AVCodec* codec = enc_ctx->codec;
+
+	// ʽýʽ֧ʱȡѡʽ
+	enc_ctx->sample_fmt = dec_ctx->sample_fmt;
+	if (codec->sample_fmts)
+	{
+		enc_ctx->sample_fmt = codec->sample_fmts[0];
+		for (const AVSampleFormat* fmt = codec->sample_fmts; *fmt != AV_SAMPLE_FMT_NONE; fmt++)
+		{
+			if (*fmt == dec_ctx->sample_fmt) enc_ctx->sample_fmt = *fmt;
+		}
+	}
+
+	// ʣ޶бʱȡӽ
+	int sample_rate = audio_sample_rate_ > 0 ? audio_sample_rate_ : dec_ctx->sample_rate;
+	if (codec->supported_samplerates)
+	{
+		int best = codec->supported_samplerates[0];
+		for (const int* rate = codec->supported_samplerates; *rate; rate++)
+		{
+			if (abs(*rate - sample_rate) < abs(best - sample_rate)) best = *rate;
+		}
+		sample_rate = best;
+	}
+	enc_ctx->sample_rate = sample_rate;
+	encoder->SetTimeBase(1, sample_rate);
+
+	// ָʱʹøĬϲ֣ 2 -> stereo5.1 »죩
+	if (audio_channels_ > 0 && audio_channels_ != dec_ctx->ch_layout.nb_channels)
+	{
+		av_channel_layout_default(&enc_ctx->ch_layout, audio_channels_);
+	}
+	else
+	{
+		av_channel_layout_copy(&enc_ctx->ch_layout, &dec_ctx->ch_layout);
+	}
 
-	// Ƶֲ䣬ֱʹ˽еĲ
-	encoder->GetContext()->sample_fmt = audio_decoder_->GetContext()->sample_fmt;
-	encoder->GetContext()->sample_rate = audio_decoder_->GetContext()->sample_rate;
-	encoder->GetContext()->ch_layout = audio_decoder_->GetContext()->ch_layout;
-	encoder->GetContext()->bit_rate = audio_decoder_->GetContext()->bit_rate;
+	enc_ctx->bit_rate = audio_bitrate_kbps_ > 0 ? (int64_t)audio_bitrate_kbps_ * 1000 : dec_ctx->bit_rate;
+	// Ƭļͷд moovҪṩȫͷextradata
+	if (segment_mode_ != XMuxer::SegmentMode::None)
+	{
+		enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	}
 
 	if (!encoder->Open())
 	{
@@ -359,31 +577,46 @@ XEncoder* XFileTranscoder::SetupAudioEncoder(int stream_index)
 		return nullptr;
 	}
 
+	encoder->memory().SetParent(&encode_memory_);
+
+	// 򿪺 frame_size ȷ
+	if (!audio_resampler_.Open(dec_ctx, enc_ctx))
+	{
+		std::cerr << "Error: audio resampler open failed!" << std::endl;
+		encoder->Close();
+		delete encoder;
+		return nullptr;
+	}
+
 	return encoder;
 }
 
 XEncoder* XFileTranscoder::SetupVideoEncoder(
-	int stream_index,
 	int width, int height,
 	AVCodecID codec_id,
 	int bitrate_kbps,
 	int fps
 )
 {
-	if (!video_decoder_)
+	const AVCodecContext* dec_ctx = VideoInputContext();
+	if (!dec_ctx)
 	{
 		std::cerr << "Error: video decoder is not initialized!" << std::endl;
 		return nullptr;
 	}
 
-	// Ĭʹԭʼߴ磬˿߾ʹֵ
-	int src_width = video_decoder_->GetContext()->width;
-	int src_height = video_decoder_->GetContext()->height;
-	AVPixelFormat pix_fmt = video_decoder_->GetContext()->pix_fmt;
+	// Ĭʹԭʼߴ磨ü󣩣˿߾ʹֵ
+	int src_width = dec_ctx->width - crop_left_ - crop_right_;
+	int src_height = dec_ctx->height - crop_top_ - crop_bottom_;
+	AVPixelFormat pix_fmt = dec_ctx->pix_fmt;
+	if (src_width <= 0 || src_height <= 0)
+	{
+		std::cerr << "Error: crop exceeds the video size!" << std::endl;
+		return nullptr;
+	}
 	if (width <= 0) width = src_width;
 	if (height <= 0) height = src_height;
 
-
 	XEncoder* encoder = new XEncoder();
 	// 
 	if (!encoder->Create(codec_id))
@@ -393,9 +626,72 @@ XEncoder* XFileTranscoder::SetupVideoEncoder(
 		return nullptr;
 	}
 
-	encoder->SetVideoParam(width, height, pix_fmt);
+	// ظʽЭָ̣ʽȣӱֵ֧ĸʽѡʧСģýʽ
+	AVPixelFormat dst_pix_fmt = NegotiatePixelFormat(encoder->GetContext()->codec, pix_fmt);
+	if (dst_pix_fmt == AV_PIX_FMT_NONE)
+	{
+		delete encoder;
+		return nullptr;
+	}
+	if (dst_pix_fmt != pix_fmt)
+	{
+		std::cout << "Pixel format: " << av_get_pix_fmt_name(pix_fmt) << " -> "
+			<< av_get_pix_fmt_name(dst_pix_fmt) << std::endl;
+	}
+
+	// ߴ = ߴ + 
+	int enc_width = width + pad_left_ + pad_right_;
+	int enc_height = height + pad_top_ + pad_bottom_;
+	// ˾ߴȡ˾ͼؿʱе˾ͼл֡
+	if (!video_filters_.empty())
+	{
+		if (!filter_graph_.is_open() && !SetupFilterGraph(src_width, src_height, pix_fmt, dst_pix_fmt, fps))
+		{
+			std::cerr << "Error: setup video filters failed!" << std::endl;
+			delete encoder;
+			return nullptr;
+		}
+		enc_width = filter_graph_.width();
+		enc_height = filter_graph_.height();
+	}
+	encoder->SetVideoParam(enc_width, enc_height, dst_pix_fmt);
 	encoder->SetTimeBase(1, fps);
 	encoder->SetFrameRate(fps, 1);
+	if (bitrate_kbps > 0) encoder->SetBitRate((int64_t)bitrate_kbps * 1000);
+	encoder->EnablePacketInfo(frame_stats_enabled_);
+
+	// ֶGOP ֶʱһ£ֶ ForceSegmentKeyFrame() ǿƹؼ֡
+	// ٶȿƣ̶ǿƹؼ֡Ϊͻ GOP ߽
+	keyframe_interval_ = 0;
+	if (segment_mode_ != XMuxer::SegmentMode::None)
+	{
+		keyframe_interval_ = (int64_t)fps * segment_seconds_;
+	}
+	else if (speed_controller_.enabled())
+	{
+		keyframe_interval_ = (int64_t)fps * 2;
+	}
+	if (keyframe_interval_ > 0)
+	{
+		encoder->SetGopSize((int)keyframe_interval_);
+		// x264/x265ǿƵ I ֡Ϊ IDRGOP ֮ûвοԣ
+		encoder->SetOpt("forced-idr", 1);
+		encoder->GetContext()->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+	}
+	if (segment_mode_ != XMuxer::SegmentMode::None)
+	{
+		encoder->GetContext()->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	}
+	if (speed_controller_.enabled())
+	{
+		speed_controller_.Apply(encoder);
+	}
+	// ֿ鲢Уٶȵλ֮ã׷ӵλ˽в
+	if (tiles_ > 1 && tile_encoding_ && !encoder->SetParallelTiles(tiles_))
+	{
+		std::cout << "Tiles: " << encoder->GetContext()->codec->name
+			<< " has no tile/slice parallelism, encoding untiled" << std::endl;
+	}
 
 	if (!encoder->Open())
 	{
@@ -403,165 +699,754 @@ XEncoder* XFileTranscoder::SetupVideoEncoder(
 		delete encoder;
 		return nullptr;
 	}
+	encoder->memory().SetParent(&encode_memory_);
 
-	// 
-	if (sws_video_ctx_)
+	// ģʹ˾ʱš䡢ʽת˾ͼ
+	if (filter_graph_.is_open())
 	{
 		sws_freeContext(sws_video_ctx_);
 		sws_video_ctx_ = nullptr;
+		tiled_scaler_.Close();
 	}
-
-	// ԭߺĿ߲
-	if (width != src_width || height != src_height)
+	else if (!SetupScaler(src_width, src_height, pix_fmt, width, height, dst_pix_fmt))
 	{
-		sws_video_ctx_ = sws_getContext(
-			src_width, src_height, pix_fmt,
-			width, height, pix_fmt,
-			SWS_BICUBIC,
-			nullptr, nullptr, nullptr);
-		if (!sws_video_ctx_)
-		{
-			std::cerr << "Error: Failed to create scaling context!" << std::endl;
-			delete encoder;
-			return nullptr;
-		}
+		delete encoder;
+		return nullptr;
 	}
 
 	return encoder;
 }
 
-bool XFileTranscoder::FlushDecoder()
+bool XFileTranscoder::SetupScaler(int src_width, int src_height, AVPixelFormat src_pix_fmt,
+	int dst_width, int dst_height, AVPixelFormat dst_pix_fmt)
 {
-	XDecoder* decoder = nullptr;
-	XEncoder* encoder = nullptr;
-	AVPacket* pkt = av_packet_alloc();
-	AVFrame* frame = av_frame_alloc();
-	bool is_successed = true;
+	scaler_src_width_ = src_width;
+	scaler_src_height_ = src_height;
+	scaler_src_pix_fmt_ = src_pix_fmt;
 
-	int nb_streams = demuxer_->GetAVFormatContext()->nb_streams;
-	for (int i = 0; i < nb_streams; i++)
+	// ߴظʽͬʱʽתһɣʱд֡Ļ
+	bool has_pad = pad_left_ || pad_top_ || pad_right_ || pad_bottom_;
+	if (src_width == dst_width && src_height == dst_height && src_pix_fmt == dst_pix_fmt && !has_pad)
 	{
-		if (i == demuxer_->video_index())
-		{
-			decoder = video_decoder_;
-			encoder = video_encoder_;
-		}
-		else if (i == demuxer_->audio_index())
+		sws_freeContext(sws_video_ctx_);
+		sws_video_ctx_ = nullptr;
+		tiled_scaler_.Close();
+		return true;
+	}
+
+	// ֿ飺һḷ́߳ٱ̵߳
+	if (tiles_ > 1)
+	{
+		if (tiled_scaler_.Open(src_width, src_height, src_pix_fmt,
+			dst_width, dst_height, dst_pix_fmt, SWS_BICUBIC, tiles_))
 		{
-			decoder = audio_decoder_;
-			encoder = audio_encoder_;
+			sws_freeContext(sws_video_ctx_);
+			sws_video_ctx_ = nullptr;
+			return true;
 		}
+		std::cerr << "Warning: tiled scaling unavailable for " << src_width << "x" << src_height
+			<< " -> " << dst_width << "x" << dst_height << ", using a single scaler" << std::endl;
+	}
 
-		AVStream* in_stream = demuxer_->GetAVFormatContext()->streams[i];
-		AVStream* out_stream = muxer_->GetAVFormatContext()->streams[i];
+	// еͬʱ
+	tiled_scaler_.Close();
+	sws_video_ctx_ = sws_getCachedContext(sws_video_ctx_,
+		src_width, src_height, src_pix_fmt,
+		dst_width, dst_height, dst_pix_fmt,
+		SWS_BICUBIC,
+		nullptr, nullptr, nullptr);
+	if (!sws_video_ctx_)
+	{
+		std::cerr << "Error: Failed to create scaling context!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+const AVCodecContext* XFileTranscoder::VideoInputContext()
+{
+	if (concat_) return concat_->video_params();
+	return video_decoder_ ? video_decoder_->GetContext() : nullptr;
+}
+
+const AVCodecContext* XFileTranscoder::AudioInputContext()
+{
+	if (concat_) return concat_->audio_params();
+	return audio_decoder_ ? audio_decoder_->GetContext() : nullptr;
+}
 
-		auto send_ret = decoder->SendPacket(nullptr);
-		if (send_ret == XDecoder::SendResult::Failed)
+AVPixelFormat XFileTranscoder::NegotiatePixelFormat(const AVCodec* codec, AVPixelFormat src_pix_fmt)
+{
+	const AVPixelFormat* supported = codec ? codec->pix_fmts : nullptr;
+	if (output_pix_fmt_ != AV_PIX_FMT_NONE)
+	{
+		bool found = !supported;
+		for (const AVPixelFormat* fmt = supported; fmt && *fmt != AV_PIX_FMT_NONE; fmt++)
 		{
-			is_successed = false;
-			goto cleanup;
+			if (*fmt == output_pix_fmt_) found = true;
 		}
-		if (send_ret == XDecoder::SendResult::Ended)
+		if (!found)
 		{
-			break;
+			std::cerr << "Error: encoder does not support pixel format "
+				<< av_get_pix_fmt_name(output_pix_fmt_) << "!" << std::endl;
+			return AV_PIX_FMT_NONE;
 		}
+		return output_pix_fmt_;
+	}
+	// δֵ֧ĸʽ rawvideoʱýʽ
+	if (!supported) return src_pix_fmt;
 
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(src_pix_fmt);
+	int has_alpha = (desc && (desc->flags & AV_PIX_FMT_FLAG_ALPHA)) ? 1 : 0;
+	AVPixelFormat best = avcodec_find_best_pix_fmt_of_list(supported, src_pix_fmt, has_alpha, nullptr);
+	if (best == AV_PIX_FMT_NONE)
+	{
+		std::cerr << "Error: no pixel format usable by encoder for "
+			<< av_get_pix_fmt_name(src_pix_fmt) << "!" << std::endl;
+	}
+	return best;
+}
+
+bool XFileTranscoder::CropVideoFrame(AVFrame* frame)
+{
+	if (!crop_left_ && !crop_top_ && !crop_right_ && !crop_bottom_) return true;
+
+	// ֻƶָ롢޸Ŀߣأַ֤üλ׼ȷ
+	frame->crop_left = crop_left_;
+	frame->crop_top = crop_top_;
+	frame->crop_right = crop_right_;
+	frame->crop_bottom = crop_bottom_;
+	if (av_frame_apply_cropping(frame, AV_FRAME_CROP_UNALIGNED) < 0)
+	{
+		std::cerr << "Error: crop " << frame->width << "x" << frame->height << " frame failed!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool XFileTranscoder::EncodeVideoFrame(AVFrame* frame)
+{
+	if (!video_encoder_) return true;
+	if (frame && !CropVideoFrame(frame)) return false;
+	if (frame && frame_tap_point_ == TapPoint::Decoded) frame_tap_.Publish(frame);
+	if (!filter_graph_.is_open())
+	{
+		return frame ? SendVideoFrame(frame) : true;
+	}
+
+	// ߴʽ仯ƴӵһ룩ȡ˾ͼлٰ֡²ؽ
+	if (frame && !filter_graph_.MatchesInput(frame))
+	{
+		if (!filter_graph_.Push(nullptr) || !SendFilteredFrames()) return false;
+		filter_graph_.Close();
+		if (!SetupFilterGraph(frame->width, frame->height, (AVPixelFormat)frame->format,
+			video_encoder_->GetContext()->pix_fmt, fps_))
+		{
+			std::cerr << "Error: rebuild video filters failed!" << std::endl;
+			return false;
+		}
+	}
+
+	// ֡ƽ˾ͼأһ֡ȡ֡֡
+	if (!filter_graph_.Push(frame)) return false;
+	return SendFilteredFrames();
+}
+
+bool XFileTranscoder::SendFilteredFrames()
+{
+	if (!filtered_frame_) filtered_frame_ = av_frame_alloc();
+	AVRational enc_time_base = video_encoder_->GetContext()->time_base;
+	while (true)
+	{
+		av_frame_unref(filtered_frame_);
+		auto recv_ret = filter_graph_.Pull(filtered_frame_);
+		if (recv_ret == XFilterGraph::ReceiveResult::Failed) return false;
+		if (recv_ret != XFilterGraph::ReceiveResult::Success) break;
+
+		// ˾ʱȥΪ 1/2 ʱ-> ʱ
+		if (filtered_frame_->pts != AV_NOPTS_VALUE)
+		{
+			filtered_frame_->pts = av_rescale_q(filtered_frame_->pts, filter_graph_.time_base(), enc_time_base);
+		}
+		filtered_frame_->pict_type = AV_PICTURE_TYPE_NONE;
+		if (!SendVideoFrame(filtered_frame_)) return false;
+	}
+	return true;
+}
+
+bool XFileTranscoder::SendVideoFrame(AVFrame* frame)
+{
+	// ֶα߽⣺ǿƹؼ֤֡ÿֶԹؼ֡ʼ
+	ForceSegmentKeyFrame(frame);
+	if (!AdjustEncoderSpeed(frame)) return false;
+
+	// ظ֡⡢
+	AVFrame* frame_to_encode = frame;
+	if (!PrepareVideoFrame(frame, frame_to_encode)) return false;
+	if (!frame_to_encode) return true;	// ظ֡Ѷ
+	if (frame_tap_point_ == TapPoint::Encoder) frame_tap_.Publish(frame_to_encode);
+	// ڱãΪ I ֡
+	quality_meter_.OnSourceFrame(frame_to_encode);
+
+	auto send_ret = video_encoder_->SendFrame(frame_to_encode);
+	if (send_ret == XEncoder::SendResult::Failed) return false;
+	if (send_ret == XEncoder::SendResult::Ended) return true;
+	stats_.video_frames++;
+	speed_controller_.OnFrame();
+	ReportProgress(frame_to_encode);
+	return ReceivePackets(video_encoder_, muxer_->video_index());
+}
+
+bool XFileTranscoder::SetupFilterGraph(int src_width, int src_height, AVPixelFormat src_pix_fmt,
+	AVPixelFormat dst_pix_fmt, int fps)
+{
+	// û˾֮š䡢ʽת˾ͼɣپ sws_scale
+	std::string desc = video_filters_;
+	char buff[256];
+	int scale_width = output_width_ > 0 ? output_width_ : -2;
+	int scale_height = output_height_ > 0 ? output_height_ : -2;
+	// Ѵʱؽߴ仯Ļߴһ
+	if (video_encoder_)
+	{
+		scale_width = video_encoder_->GetContext()->width - pad_left_ - pad_right_;
+		scale_height = video_encoder_->GetContext()->height - pad_top_ - pad_bottom_;
+	}
+	if (scale_width > 0 || scale_height > 0)
+	{
+		snprintf(buff, sizeof(buff), ",scale=%d:%d:flags=bicubic", scale_width, scale_height);
+		desc += buff;
+	}
+	if (pad_left_ || pad_top_ || pad_right_ || pad_bottom_)
+	{
+		snprintf(buff, sizeof(buff), ",pad=iw+%d:ih+%d:%d:%d:black",
+			pad_left_ + pad_right_, pad_top_ + pad_bottom_, pad_left_, pad_top_);
+		desc += buff;
+	}
+	desc += ",format=";
+	desc += av_get_pix_fmt_name(dst_pix_fmt);
+
+	// ֡ pts תΪʱ 1/fps
+	if (!filter_graph_.Init(desc, src_width, src_height, src_pix_fmt, AVRational{ 1, fps },
+		VideoInputContext()->sample_aspect_ratio, filter_threads_))
+	{
+		return false;
+	}
+	std::cout << "Video filters: " << desc << " -> " << filter_graph_.width() << "x"
+		<< filter_graph_.height() << std::endl;
+	return true;
+}
+
+bool XFileTranscoder::PrepareVideoFrame(AVFrame* frame, AVFrame*& frame_to_encode)
+{
+	frame_to_encode = frame;
+
+	// ظ֡⣺ֶα߽/Ĺؼ֡룬
+	if (duplicate_mode_ != DuplicateMode::Off &&
+		frame->pict_type != AV_PICTURE_TYPE_I &&
+		frame_diff_.IsDuplicate(frame))
+	{
+		stats_.duplicate_frames++;
+		if (duplicate_mode_ == DuplicateMode::Drop)
+		{
+			// ͱΪ֡ʣʱԭֵ
+			frame_to_encode = nullptr;
+			return true;
+		}
+
+		// Repeatطһ֡ţĻ棬ֻʱ
+		AVFrame* last = (sws_video_ctx_ || tiled_scaler_.is_open()) ? scaled_video_frame_ : last_video_frame_;
+		if (last->data[0])
+		{
+			last->pts = frame->pts;
+			last->pict_type = AV_PICTURE_TYPE_NONE;
+			frame_to_encode = last;
+			return true;
+		}
+	}
+
+	// ߴʽ仯ƴӵһ롢ƬԴ;ıֱʣʱ֡ʵʲ
+	// ΪĻߴظʽ˾ͼһ£
+	if (!filter_graph_.is_open() &&
+		(frame->width != scaler_src_width_ || frame->height != scaler_src_height_ ||
+		frame->format != scaler_src_pix_fmt_))
+	{
+		AVCodecContext* enc_ctx = video_encoder_->GetContext();
+		if (!SetupScaler(frame->width, frame->height, (AVPixelFormat)frame->format,
+			enc_ctx->width - pad_left_ - pad_right_, enc_ctx->height - pad_top_ - pad_bottom_, enc_ctx->pix_fmt))
+		{
+			return false;
+		}
+	}
+
+	if (!sws_video_ctx_ && !tiled_scaler_.is_open())
+	{
+		if (duplicate_mode_ == DuplicateMode::Repeat)
+		{
+			// ط
+			av_frame_unref(last_video_frame_);
+			if (av_frame_ref(last_video_frame_, frame) < 0) return false;
+		}
+		return true;
+	}
+
+	// ֡Ŵ֡䣩
+	int dst_width = video_encoder_->GetContext()->width;
+	int dst_height = video_encoder_->GetContext()->height;
+	AVPixelFormat dst_pix_fmt = video_encoder_->GetContext()->pix_fmt;
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(dst_pix_fmt);
+
+	if (scaled_video_frame_->width != dst_width ||
+		scaled_video_frame_->height != dst_height ||
+		scaled_video_frame_->format != dst_pix_fmt)
+	{
+		// ͷžɻ
+		av_frame_unref(scaled_video_frame_);
+
+		// ²
+		scaled_video_frame_->width = dst_width;
+		scaled_video_frame_->height = dst_height;
+		scaled_video_frame_->format = dst_pix_fmt;
+
+		if (av_frame_get_buffer(scaled_video_frame_, 0) < 0)
+		{
+			std::cerr << "Error: av_frame_get_buffer for scaled frame failed!" << std::endl;
+			return false;
+		}
+		// ֻͿһΣ֮ÿֻ֡д
+		// av_frame_make_writable() ʱḴ֡߿
+		if (pad_left_ || pad_top_ || pad_right_ || pad_bottom_)
+		{
+			ptrdiff_t linesize[4] = { 0 };
+			for (int i = 0; i < 4; i++) linesize[i] = scaled_video_frame_->linesize[i];
+			av_image_fill_black(scaled_video_frame_->data, linesize, dst_pix_fmt,
+				frame->color_range, dst_width, dst_height);
+		}
+	}
+	// Գһ֡ãдǰȷд
+	if (av_frame_make_writable(scaled_video_frame_) < 0)
+	{
+		std::cerr << "Error: av_frame_make_writable for scaled frame failed!" << std::endl;
+		return false;
+	}
+
+	// ֡еʼַɫƽ水ƫƣ
+	uint8_t* dst_data[4] = { nullptr };
+	int pixsteps[4] = { 0 };
+	av_image_fill_max_pixsteps(pixsteps, nullptr, desc);
+	for (int i = 0; i < 4 && scaled_video_frame_->data[i]; i++)
+	{
+		int shift_w = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+		int shift_h = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+		dst_data[i] = scaled_video_frame_->data[i]
+			+ (int64_t)(pad_top_ >> shift_h) * scaled_video_frame_->linesize[i]
+			+ (pad_left_ >> shift_w) * pixsteps[i];
+	}
+
+	// ִţֿʱдڹ߳вУʱ֡ɣ
+	if (tiled_scaler_.is_open())
+	{
+		if (!tiled_scaler_.Scale(frame, scaled_video_frame_, dst_data)) return false;
+	}
+	else
+	{
+		int ret = sws_scale(sws_video_ctx_,
+			frame->data, frame->linesize, 0, frame->height,
+			dst_data, scaled_video_frame_->linesize);
+		if (ret < 0) {
+			std::cerr << "Error: sws_scale failed!" << std::endl;
+			return false;
+		}
+	}
+
+	scaled_video_frame_->pts = frame->pts;
+	scaled_video_frame_->pkt_dts = frame->pkt_dts;
+	scaled_video_frame_->best_effort_timestamp = frame->best_effort_timestamp;
+	scaled_video_frame_->key_frame = frame->key_frame;
+	scaled_video_frame_->pict_type = frame->pict_type;
+
+	frame_to_encode = scaled_video_frame_;
+	return true;
+}
+
+void XFileTranscoder::SetDuplicateFrameMode(DuplicateMode mode, double threshold)
+{
+	duplicate_mode_ = mode;
+	duplicate_threshold_ = threshold;
+	frame_diff_.SetThreshold(threshold);
+}
+
+void XFileTranscoder::SetAutoBitrate(bool enable, int min_kbps, int max_kbps)
+{
+	auto_bitrate_ = enable;
+	auto_bitrate_min_kbps_ = min_kbps > 0 ? min_kbps : 0;
+	auto_bitrate_max_kbps_ = max_kbps > 0 ? max_kbps : 0;
+}
+
+bool XFileTranscoder::ApplyAutoBitrate(const std::string& input_file)
+{
+	XComplexityAnalyzer analyzer;
+	if (!analyzer.Analyze(input_file)) return false;
+
+	// ߴδָʱΪüƬԴߴ
+	int width = output_width_ > 0 ? output_width_ : VideoInputContext()->width - crop_left_ - crop_right_;
+	int height = output_height_ > 0 ? output_height_ : VideoInputContext()->height - crop_top_ - crop_bottom_;
+	int kbps = analyzer.RecommendBitrate(width, height, fps_, output_codec_id_);
+	if (kbps <= 0) return false;
+	if (auto_bitrate_min_kbps_ > 0) kbps = std::max(kbps, auto_bitrate_min_kbps_);
+	if (auto_bitrate_max_kbps_ > 0) kbps = std::min(kbps, auto_bitrate_max_kbps_);
+
+	const XComplexity& c = analyzer.result();
+	char buff[256];
+	snprintf(buff, sizeof(buff), "auto bitrate: spatial %.2f, temporal %.2f (%d samples, %d frames, %.2fs) -> %d kbps",
+		c.spatial, c.temporal, c.samples, c.frames, c.seconds, kbps);
+	stats_.AddEvent(buff);
+	bitrate_kbps_ = kbps;
+	return true;
+}
+
+void XFileTranscoder::SetFrameTap(const std::string& name, TapPoint point, int slots)
+{
+	frame_tap_name_ = name;
+	frame_tap_point_ = point;
+	frame_tap_slots_ = slots;
+}
+
+void XFileTranscoder::SetTiles(int tiles, bool encode)
+{
+	tiles_ = tiles > 1 ? tiles : 0;
+	tile_encoding_ = encode;
+}
+
+void XFileTranscoder::SetPacketTrace(const std::string& path, bool with_data)
+{
+	packet_trace_path_ = path;
+	packet_trace_data_ = with_data;
+}
+
+void XFileTranscoder::SetQualityMeter(bool enable, int interval_seconds, int window_frames)
+{
+	quality_enabled_ = enable;
+	quality_interval_seconds_ = interval_seconds > 0 ? interval_seconds : 10;
+	quality_window_frames_ = window_frames > 0 ? window_frames : 1;
+}
+
+void XFileTranscoder::SetVideoFilters(const std::string& filters, int threads)
+{
+	video_filters_ = filters;
+	filter_threads_ = threads;
+}
+
+void XFileTranscoder::SetCrop(int left, int top, int right, int bottom)
+{
+	crop_left_ = left > 0 ? left & ~1 : 0;
+	crop_top_ = top > 0 ? top & ~1 : 0;
+	crop_right_ = right > 0 ? right & ~1 : 0;
+	crop_bottom_ = bottom > 0 ? bottom & ~1 : 0;
+}
+
+void XFileTranscoder::SetPad(int left, int top, int right, int bottom)
+{
+	pad_left_ = left > 0 ? left & ~1 : 0;
+	pad_top_ = top > 0 ? top & ~1 : 0;
+	pad_right_ = right > 0 ? right & ~1 : 0;
+	pad_bottom_ = bottom > 0 ? bottom & ~1 : 0;
+}
+
+void XFileTranscoder::SetInputRange(int64_t start_ts, int64_t end_ts)
+{
+	range_start_ = start_ts;
+	range_end_ = end_ts;
+}
+
+bool XFileTranscoder::IsInInputRange(int stream_index, AVFrame* frame)
+{
+	if (range_start_ == AV_NOPTS_VALUE && range_end_ == AV_NOPTS_VALUE) return true;
+	int64_t ts = frame->best_effort_timestamp;
+	if (ts == AV_NOPTS_VALUE) return true;
+
+	AVFormatContext* fmt_ctx = demuxer_->GetAVFormatContext();
+	AVRational time_base = fmt_ctx->streams[stream_index]->time_base;
+	AVRational range_time_base = fmt_ctx->streams[demuxer_->video_index()]->time_base;
+
+	if (range_start_ != AV_NOPTS_VALUE &&
+		av_compare_ts(ts, time_base, range_start_, range_time_base) < 0)
+	{
+		return false;
+	}
+	if (range_end_ != AV_NOPTS_VALUE &&
+		av_compare_ts(ts, time_base, range_end_, range_time_base) >= 0)
+	{
+		// ʾ˳Խյ֡ҲڷΧ
+		if (stream_index == demuxer_->video_index()) range_video_done_ = true;
+		else if (stream_index == demuxer_->audio_index()) range_audio_done_ = true;
+		return false;
+	}
+	return true;
+}
+
+std::string XFileTranscoder::OutputParams(const std::string& output_file) const
+{
+	// װʽͬһͲ .mp4  .mkv ǲͬļװƶϣƶϲʱȡСдչ
+	std::string format;
+	const AVOutputFormat* oformat = av_guess_format(nullptr, output_file.c_str(), nullptr);
+	if (oformat)
+	{
+		format = oformat->name;
+	}
+	else
+	{
+		size_t dot = output_file.find_last_of("./\\");
+		if (dot != std::string::npos && output_file[dot] == '.') format = output_file.substr(dot + 1);
+		std::transform(format.begin(), format.end(), format.begin(), [](unsigned char c) { return (char)tolower(c); });
+	}
+
+	// ˾ûṩȲޣö壨ضϺͬṲûͶϵ㣩
+	std::ostringstream params;
+	params << "format=" << format << "|" << output_width_ << "x" << output_height_
+		<< "|crop=" << crop_left_ << ":" << crop_top_ << ":" << crop_right_ << ":" << crop_bottom_
+		<< "|pad=" << pad_left_ << ":" << pad_top_ << ":" << pad_right_ << ":" << pad_bottom_
+		<< "|pix_fmt=" << (int)output_pix_fmt_ << "|vf=" << video_filters_
+		<< "|qm=" << (quality_enabled_ ? quality_interval_seconds_ : 0) << ":" << (quality_enabled_ ? quality_window_frames_ : 0)
+		<< "|auto=" << (int)auto_bitrate_ << ":" << auto_bitrate_min_kbps_ << ":" << auto_bitrate_max_kbps_
+		<< "|codec=" << (int)output_codec_id_ << "|" << bitrate_kbps_ << "kbps|" << fps_ << "fps"
+		<< "|audio=" << (int)audio_codec_id_ << ":" << audio_sample_rate_ << ":" << audio_channels_ << ":" << audio_bitrate_kbps_
+		<< "|segment=" << (int)segment_mode_ << ":" << segment_seconds_
+		<< "|dup=" << (int)duplicate_mode_ << ":" << duplicate_threshold_
+		<< "|speed=" << realtime_speed_
+		<< "|tiles=" << tiles_ << ":" << (int)tile_encoding_
+		<< "|faststart=" << (int)fast_start_
+		<< "|range=" << range_start_ << ":" << range_end_;
+	return params.str();
+}
+
+bool XFileTranscoder::PrepareResume(const std::string& input_file, const std::string& output_file)
+{
+	resuming_ = false;
+	checkpoint_path_.clear();
+	if (!checkpoint_enabled_) return true;
+	if (concat_)
+	{
+		std::cerr << "Warning: checkpoint is not supported for concatenated inputs, disabled!" << std::endl;
+		return true;
+	}
+	if (segment_mode_ != XMuxer::SegmentMode::HLS)
+	{
+		std::cerr << "Warning: checkpoint requires HLS segment output, disabled!" << std::endl;
+		return true;
+	}
+
+	checkpoint_path_ = output_file + ".ckpt";
+	checkpoint_ = XCheckpoint();
+	checkpoint_.params = input_file + "|" + OutputParams(output_file);
+	checkpoint_.keyframe_interval = keyframe_interval_;
+
+	XCheckpoint saved;
+	if (!saved.Load(checkpoint_path_)) return true;	// ûжϵ㣬ͷʼ
+	if (saved.params != checkpoint_.params || saved.keyframe_interval != keyframe_interval_)
+	{
+		std::cerr << "Warning: checkpoint parameters mismatch, start over!" << std::endl;
+		return true;
+	}
+
+	// ϵڷֶύװ֮ǰ棬ܱȲбǰһֶΣԲбΪ׼
+	bool ended = false;
+	int listed = XCheckpoint::CountPlaylistSegments(output_file, &ended);
+	int segment = saved.segment < listed ? saved.segment : listed;
+	if (ended || segment <= 0) return true;
+
+	saved.segment = segment;
+	saved.resume_pts = saved.SegmentStartPts(segment);
+	AVStream* in_stream = demuxer_->GetAVFormatContext()->streams[demuxer_->video_index()];
+	saved.input_ts = av_rescale_q(saved.resume_pts,
+		video_encoder_->GetContext()->time_base,
+		in_stream->time_base);
+	if (!demuxer_->Seek(demuxer_->video_index(), saved.input_ts)) return false;
+
+	checkpoint_ = saved;
+	resuming_ = true;
+	// вб׷ӣ·ֶŽзֶ
+	muxer_->SetFormatOpt("hls_flags", "independent_segments+append_list");
+	std::cout << "Resume from segment " << segment << " (pts " << saved.resume_pts << ")" << std::endl;
+	return true;
+}
+
+bool XFileTranscoder::IsAfterResumePoint(int stream_index, AVFrame* frame)
+{
+	if (frame->pts == AV_NOPTS_VALUE) return true;
+	AVRational video_time_base = video_encoder_->GetContext()->time_base;
+	if (stream_index == demuxer_->video_index())
+	{
+		return frame->pts >= checkpoint_.resume_pts;
+	}
+	if (stream_index == demuxer_->audio_index() && audio_encoder_)
+	{
+		return av_compare_ts(frame->pts, audio_encoder_->GetContext()->time_base,
+			checkpoint_.resume_pts, video_time_base) >= 0;
+	}
+	return true;
+}
+
+void XFileTranscoder::UpdateCheckpoint(AVPacket* pkt)
+{
+	if (checkpoint_path_.empty() || keyframe_interval_ <= 0) return;
+	if (!(pkt->flags & AV_PKT_FLAG_KEY) || pkt->pts == AV_NOPTS_VALUE) return;
+
+	// ؼ֡ڵķֶţǿƹؼ֡ͬһê㣩лĹؼ֡ڷֶ㣬Ų
+	if (!keyframe_anchored_ || pkt->pts < keyframe_anchor_pts_) return;
+	int segment = (int)((pkt->pts - keyframe_anchor_pts_) / keyframe_interval_);
+	if (segment <= checkpoint_.segment) return;
+
+	// ùؼ֡ʼ segment ֶΣ֮ǰķֶȫύװ
+	AVStream* in_stream = demuxer_->GetAVFormatContext()->streams[demuxer_->video_index()];
+	checkpoint_.first_pts = keyframe_anchor_pts_;
+	checkpoint_.segment = segment;
+	checkpoint_.resume_pts = checkpoint_.SegmentStartPts(segment);
+	checkpoint_.input_ts = av_rescale_q(checkpoint_.resume_pts,
+		video_encoder_->GetContext()->time_base,
+		in_stream->time_base);
+	checkpoint_.Save(checkpoint_path_);
+}
+
+void XFileTranscoder::SetSegmentOutput(XMuxer::SegmentMode mode, int segment_seconds)
+{
+	segment_mode_ = mode;
+	segment_seconds_ = segment_seconds > 0 ? segment_seconds : 4;
+}
+
+void XFileTranscoder::ForceSegmentKeyFrame(AVFrame* frame)
+{
+	if (keyframe_interval_ <= 0 || frame->pts == AV_NOPTS_VALUE) return;
+
+	// һ֡pts ܲǼҲΪֶ 0 㣬ؼ֡λڵһ֡ + k * 
+	// HLS װһ pts ۼƷֶʱз֣ߵзֵһ£ÿֶβ hls_time
+	if (!keyframe_anchored_)
+	{
+		keyframe_anchored_ = true;
+		keyframe_anchor_pts_ = frame->pts;
+		next_keyframe_pts_ = frame->pts;
+	}
+	if (frame->pts < next_keyframe_pts_) return;
+
+	frame->pict_type = AV_PICTURE_TYPE_I;
+	int64_t k = (frame->pts - keyframe_anchor_pts_) / keyframe_interval_ + 1;
+	next_keyframe_pts_ = keyframe_anchor_pts_ + k * keyframe_interval_;
+}
+
+void XFileTranscoder::BuildStreamPipelines()
+{
+	stream_slots_.clear();
+	if (!demuxer_) return;
+	if (!decoded_frame_) decoded_frame_ = av_frame_alloc();
+
+	// ûжӦĻ죬ƵʧܣֱӶûжӦ
+	// ƣԭ StreamKind ˵
+	AVFormatContext* fmt_ctx = demuxer_->GetAVFormatContext();
+	stream_slots_.resize(fmt_ctx->nb_streams);
+	for (int i = 0; i < (int)fmt_ctx->nb_streams; i++)
+	{
+		StreamSlot& slot = stream_slots_[i];
+		slot.index = i;
+		slot.time_base = fmt_ctx->streams[i]->time_base;
+		slot.handler = &XFileTranscoder::DecodeStream<StreamKind::Discard>;
+		if (i == demuxer_->video_index() && video_decoder_ && video_encoder_)
+		{
+			slot.decoder = video_decoder_;
+			slot.handler = &XFileTranscoder::DecodeStream<StreamKind::Video>;
+		}
+		else if (i == demuxer_->audio_index() && audio_decoder_ && audio_encoder_)
+		{
+			slot.decoder = audio_decoder_;
+			slot.handler = &XFileTranscoder::DecodeStream<StreamKind::Audio>;
+		}
+		else
+		{
+			const char* type = av_get_media_type_string(fmt_ctx->streams[i]->codecpar->codec_type);
+			char buff[128] = { 0 };
+			snprintf(buff, sizeof(buff), "input stream #%d (%s, %s) discarded", i, type ? type : "unknown",
+				avcodec_get_name(fmt_ctx->streams[i]->codecpar->codec_id));
+			stats_.AddEvent(buff);
+		}
+	}
+}
+
+template <XFileTranscoder::StreamKind kind>
+XFileTranscoder::DecodeResult XFileTranscoder::DecodeStream(StreamSlot& slot, AVPacket* pkt)
+{
+	slot.encode_us = 0;
+	slot.frames = 0;
+	if constexpr (kind == StreamKind::Discard)
+	{
+		return DecodeResult::Success;
+	}
+	else
+	{
+		auto send_ret = slot.decoder->SendPacket(pkt);
+		if (send_ret == XDecoder::SendResult::Failed) return DecodeResult::Failed;
+		if (send_ret == XDecoder::SendResult::Ended) return DecodeResult::Ended;
+
+		AVFrame* frame = decoded_frame_;
 		while (true)
 		{
 			av_frame_unref(frame);
-			auto recv_ret = decoder->ReceiveFrame(frame);
-			if (recv_ret == XDecoder::ReceiveResult::Failed)
-			{
-				is_successed = false;
-				goto cleanup;
-			}
+			auto recv_ret = slot.decoder->ReceiveFrame(frame);
+			if (recv_ret == XDecoder::ReceiveResult::Failed) return DecodeResult::Failed;
 			if (recv_ret == XDecoder::ReceiveResult::NeedFeed ||
 				recv_ret == XDecoder::ReceiveResult::Ended)
 			{
 				break;
 			}
+			// ֮ȡһܽ֡
+			if (IsCancelled()) return DecodeResult::Failed;
 
-
-
-			//ʱ  -> 
-			auto pts = frame->best_effort_timestamp;
+			// ؼ1ʱתʱ  ʱ
+			// ؿƵ֡ȡǰ
+			XEncoder* encoder = (kind == StreamKind::Video) ? video_encoder_ : audio_encoder_;
+			int64_t pts = frame->best_effort_timestamp; // FFmpeg Ƽʱ
 			if (pts != AV_NOPTS_VALUE)
 			{
-				frame->pts = av_rescale_q(pts,
-					in_stream->time_base,
-					encoder->GetContext()->time_base);
-			}
-			else {
-				if (i == demuxer_->video_index())
-				{
-					frame->pts = video_frame_counter_++;
-				}
-				else if (i == demuxer_->audio_index())
-				{
-					frame->pts = audio_frame_counter_++;
-				}
-			}
-
-			auto send_ret = encoder->SendFrame(frame);
-			if (send_ret == XEncoder::SendResult::Failed)
-			{
-				is_successed = false;
-				goto cleanup;
+				frame->pts = av_rescale_q(pts, slot.time_base, encoder->GetContext()->time_base);
 			}
-			if (send_ret == XEncoder::SendResult::Ended)
+			else
 			{
-				break;
+				// ûԭʼʱʹ֡
+				frame->pts = (kind == StreamKind::Video) ? video_frame_counter_++ : audio_frame_counter_++;
 			}
+			// ϵ֮ǰĹؼ֡ʼ룬֮ǰ֡
+			if (resuming_ && !IsAfterResumePoint(slot.index, frame)) continue;
+			if (!IsInInputRange(slot.index, frame)) continue;
 
-			while (true)
-			{
-				av_packet_unref(pkt);
-				auto recv_ret = encoder->ReceivePacket(pkt);
-				if (recv_ret == XEncoder::ReceiveResult::Failed)
-				{
-					is_successed = false;
-					goto cleanup;
-				}
-				if (recv_ret == XEncoder::ReceiveResult::NeedFeed ||
-					recv_ret == XEncoder::ReceiveResult::Ended)
-				{
-					break;
-				}
+			// Ҫģpict_typeñԶ
+			frame->pict_type = AV_PICTURE_TYPE_NONE;
 
-				pkt->pts = av_rescale_q(pkt->pts,
-					encoder->GetContext()->time_base,
-					out_stream->time_base);
-				pkt->dts = av_rescale_q(pkt->dts,
-					encoder->GetContext()->time_base,
-					out_stream->time_base);
-
-				//յpktУpkt->stream_indexΪ0
-				//дǰӦΪӦȻдƵ³
-				pkt->stream_index = i;
-				if (!muxer_->Write(pkt))
-				{
-					is_successed = false;
-					goto cleanup;
-				}
-			}
+			// Ƶ֡ FIFO ֡룻Ƶ֡ü˾ظ֡⡢ź
+			int64_t encode_start = packet_trace_.Now();
+			bool encoded = false;
+			if constexpr (kind == StreamKind::Audio) encoded = EncodeAudioFrame(frame);
+			else encoded = EncodeVideoFrame(frame);
+			slot.encode_us += packet_trace_.Now() - encode_start;
+			slot.frames++;
+			if (!encoded) return DecodeResult::Failed;
 		}
+		return DecodeResult::Success;
 	}
-cleanup:
-	av_frame_free(&frame);
-	av_packet_free(&pkt);
+}
 
-	return is_successed;
+bool XFileTranscoder::FlushDecoder()
+{
+	// ѭͬһ nullptr ſոƴʱûбɽ߳ſգ
+	for (StreamSlot& slot : stream_slots_)
+	{
+		if ((this->*slot.handler)(slot, nullptr) == DecodeResult::Failed) return false;
+	}
+	return true;
 }
 
 bool XFileTranscoder::FlushEncoder()
 {
-	XEncoder* encoder = nullptr;
-	bool is_successed = true;
-	AVPacket* pkt = av_packet_alloc();
-
 	int nb_streams = muxer_->GetAVFormatContext()->nb_streams;
 	for (int i = 0; i < nb_streams; i++)
 	{
+		XEncoder* encoder = nullptr;
 		if (i == muxer_->video_index())
 		{
 			encoder = video_encoder_;
@@ -572,62 +1457,266 @@ bool XFileTranscoder::FlushEncoder()
 		}
 
 		if (!encoder) continue;
-		AVStream* out_stream = muxer_->GetAVFormatContext()->streams[i];
+		// Ƶȱ FIFO ʣĲƵȡ˾ͼл֡
+		if (encoder == audio_encoder_ && !EncodeAudioFrame(nullptr)) return false;
+		if (encoder == video_encoder_ && !EncodeVideoFrame(nullptr)) return false;
+		if (!DrainEncoder(encoder, i)) return false;
+	}
+	return true;
+}
 
-		auto send_ret = encoder->SendFrame(nullptr);
-		if (send_ret == XEncoder::SendResult::Failed)
+bool XFileTranscoder::DrainEncoder(XEncoder* encoder, int stream_index)
+{
+	auto send_ret = encoder->SendFrame(nullptr);
+	if (send_ret == XEncoder::SendResult::Failed) return false;
+	if (send_ret == XEncoder::SendResult::Ended) return true;
+	return ReceivePackets(encoder, stream_index);
+}
+
+bool XFileTranscoder::ReceivePackets(XEncoder* encoder, int stream_index)
+{
+	bool is_successed = true;
+	AVPacket* pkt = av_packet_alloc();
+	AVStream* out_stream = muxer_->GetAVFormatContext()->streams[stream_index];
+
+	while (true)
+	{
+		av_packet_unref(pkt);
+		auto recv_ret = encoder->ReceivePacket(pkt);
+		if (recv_ret == XEncoder::ReceiveResult::Failed)
 		{
 			is_successed = false;
-			goto cleanup;
+			break;
 		}
-		if (send_ret == XEncoder::SendResult::Ended)
+		if (recv_ret == XEncoder::ReceiveResult::Ended ||
+			recv_ret == XEncoder::ReceiveResult::NeedFeed)
 		{
 			break;
 		}
 
-		while (true)
+		if (encoder == video_encoder_)
 		{
-			av_packet_unref(pkt);
-			auto recv_ret = encoder->ReceivePacket(pkt);
-			if (recv_ret == XEncoder::ReceiveResult::Failed)
-			{
-				is_successed = false;
-				goto cleanup;
-			}
-			if (recv_ret == XEncoder::ReceiveResult::Ended)
-			{
-				break;
-			}
-			if (recv_ret == XEncoder::ReceiveResult::NeedFeed)
-			{
-				/*encoder->SendFrame(nullptr);
-				continue;*/
-				break;
-			}
-
-			pkt->pts = av_rescale_q(pkt->pts,
-				encoder->GetContext()->time_base,
-				out_stream->time_base);
-			pkt->dts = av_rescale_q(pkt->dts,
-				encoder->GetContext()->time_base,
-				out_stream->time_base);
-
-			//յpktУpkt->stream_indexΪ0
-			//дǰӦΪӦȻдƵ³
-			pkt->stream_index = i;
-			if (!muxer_->Write(pkt))
-			{
-				is_successed = false;
-				goto cleanup;
-			}
+			UpdateCheckpoint(pkt);
+			quality_meter_.OnPacket(pkt);
+			if (frame_stats_.is_open()) frame_stats_.Write(encoder->last_packet_info());
 		}
 
+		pkt->pts = av_rescale_q(pkt->pts,
+			encoder->GetContext()->time_base,
+			out_stream->time_base);
+		pkt->dts = av_rescale_q(pkt->dts,
+			encoder->GetContext()->time_base,
+			out_stream->time_base);
+
+		//յpktУpkt->stream_indexΪ0
+		//дǰӦΪӦȻдƵ³
+		pkt->stream_index = stream_index;
+		if (!muxer_->Write(pkt))
+		{
+			is_successed = false;
+			break;
+		}
 	}
 
-cleanup:
 	av_packet_free(&pkt);
+	return is_successed;
+}
+
+bool XFileTranscoder::EncodeAudioFrame(AVFrame* frame)
+{
+	if (!audio_encoder_) return true;
+	if (!audio_resampler_.Push(frame)) return false;
+	if (!audio_frame_) audio_frame_ = av_frame_alloc();
+
+	// ı֡룬ʱͬĶ֡
+	bool flush = (frame == nullptr);
+	while (audio_resampler_.Pop(audio_frame_, flush))
+	{
+		auto send_ret = audio_encoder_->SendFrame(audio_frame_);
+		if (send_ret == XEncoder::SendResult::Failed) return false;
+		if (send_ret == XEncoder::SendResult::Ended) break;
+		stats_.audio_frames++;
+		if (!ReceivePackets(audio_encoder_, muxer_->audio_index())) return false;
+	}
+	return true;
+}
+
+void XFileTranscoder::SetAudioOutput(AVCodecID codec_id, int sample_rate, int channels, int bitrate_kbps)
+{
+	audio_codec_id_ = codec_id;
+	audio_sample_rate_ = sample_rate > 0 ? sample_rate : 0;
+	audio_channels_ = channels > 0 ? channels : 0;
+	audio_bitrate_kbps_ = bitrate_kbps > 0 ? bitrate_kbps : 0;
+}
 
-	return is_successed;;
+void XFileTranscoder::SetRealtimeTarget(double speed)
+{
+	realtime_speed_ = speed > 0 ? speed : 0;
+}
+
+bool XFileTranscoder::AdjustEncoderSpeed(AVFrame* frame)
+{
+	if (frame->pict_type != AV_PICTURE_TYPE_I) return true;
+	if (!speed_controller_.Evaluate()) return true;
+
+	char buff[256];
+	snprintf(buff, sizeof(buff), "t=%.1fs encode %.1f fps, target %.1f fps -> %s",
+		frame->pts * av_q2d(video_encoder_->GetContext()->time_base),
+		speed_controller_.window_fps(), speed_controller_.target_fps(),
+		speed_controller_.Describe().c_str());
+	stats_.AddEvent(buff);
+
+	return ReopenVideoEncoder();
+}
+
+bool XFileTranscoder::ReopenVideoEncoder()
+{
+	// ſվɱlookahead е֡ȫд± IDR ʼڴ˴޷ν
+	if (!DrainEncoder(video_encoder_, muxer_->video_index())) return false;
+	video_encoder_->Close();
+	delete video_encoder_;
+	// SetupVideoEncoder() е˾ͼõȻ video_encoder_ͷŵָ
+	video_encoder_ = nullptr;
+
+	while (true)
+	{
+		video_encoder_ = SetupVideoEncoder(
+			output_width_, output_height_,
+			output_codec_id_,
+			bitrate_kbps_,
+			fps_
+		);
+		if (!video_encoder_)
+		{
+			std::cerr << "Error: reopen video encoder failed!" << std::endl;
+			return false;
+		}
+
+		// ļͷֶȫͷĽ׸ SPS/PPS
+		// ±Ĳͬʱصǰĵλֹͣ
+		const AVCodecParameters* par = muxer_->GetAVFormatContext()->streams[muxer_->video_index()]->codecpar;
+		const AVCodecContext* enc_ctx = video_encoder_->GetContext();
+		if (par->extradata_size == enc_ctx->extradata_size &&
+			(par->extradata_size == 0 || memcmp(par->extradata, enc_ctx->extradata, par->extradata_size) == 0))
+		{
+			return true;
+		}
+		if (speed_controller_.pinned())
+		{
+			std::cerr << "Error: video encoder parameter sets changed after reopen!" << std::endl;
+			return false;
+		}
+		video_encoder_->Close();
+		delete video_encoder_;
+		video_encoder_ = nullptr;
+		speed_controller_.Pin();
+		stats_.AddEvent("speed level would change the parameter sets, back to " + speed_controller_.Describe());
+	}
+}
+
+void XFileTranscoder::SetNumaPlacement(bool enable, int node)
+{
+	numa_enabled_ = enable;
+	numa_node_ = node;
+}
+
+void XFileTranscoder::SetProgressCallback(ProgressCallback callback, int interval_ms)
+{
+	progress_callback_ = callback;
+	progress_interval_ms_ = interval_ms > 0 ? interval_ms : 0;
+}
+
+bool XFileTranscoder::IsCancelled()
+{
+	if (!cancel_requested_.load(std::memory_order_relaxed)) return false;
+	if (!stats_.cancelled)
+	{
+		stats_.cancelled = true;
+		stats_.AddEvent("cancelled after " + std::to_string(stats_.video_frames) + " video frames");
+	}
+	return true;
+}
+
+void XFileTranscoder::SetupProgress()
+{
+	progress_ = XTranscodeProgress();
+	progress_start_ = std::chrono::steady_clock::now();
+	progress_last_ = progress_start_;
+	progress_last_frames_ = 0;
+	first_media_seconds_ = -1;
+
+	// ƴӣʱ 0 ʼʱΪʱ֮
+	if (concat_)
+	{
+		input_start_seconds_ = 0;
+		progress_.duration_seconds = concat_->duration_seconds();
+		return;
+	}
+
+	AVFormatContext* fmt_ctx = demuxer_->GetAVFormatContext();
+	AVRational video_time_base = fmt_ctx->streams[demuxer_->video_index()]->time_base;
+	double file_start = (fmt_ctx->start_time != AV_NOPTS_VALUE) ? fmt_ctx->start_time / (double)AV_TIME_BASE : 0;
+	double file_end = (fmt_ctx->duration > 0) ? file_start + fmt_ctx->duration / (double)AV_TIME_BASE : 0;
+
+	input_start_seconds_ = (range_start_ != AV_NOPTS_VALUE) ? range_start_ * av_q2d(video_time_base) : file_start;
+	double end = (range_end_ != AV_NOPTS_VALUE) ? range_end_ * av_q2d(video_time_base) : file_end;
+	progress_.duration_seconds = (end > input_start_seconds_) ? end - input_start_seconds_ : 0;
+}
+
+void XFileTranscoder::ReportProgress(const AVFrame* frame, bool force)
+{
+	if (!progress_callback_) return;
+	auto now = std::chrono::steady_clock::now();
+	if (!force && now - progress_last_ < std::chrono::milliseconds(progress_interval_ms_)) return;
+
+	if (frame && frame->pts != AV_NOPTS_VALUE)
+	{
+		// ʱʱһ£ֻʱ㣩
+		double media = frame->pts * av_q2d(video_encoder_->GetContext()->time_base) - input_start_seconds_;
+		progress_.media_seconds = media > 0 ? media : 0;
+		if (first_media_seconds_ < 0) first_media_seconds_ = progress_.media_seconds;
+	}
+	else if (force && !frame)
+	{
+		// 
+		progress_.media_seconds = progress_.duration_seconds;
+	}
+
+	double interval = std::chrono::duration<double>(now - progress_last_).count();
+	progress_.video_frames = stats_.video_frames;
+	progress_.elapsed_seconds = std::chrono::duration<double>(now - progress_start_).count();
+	if (interval > 0) progress_.fps = (stats_.video_frames - progress_last_frames_) / interval;
+	double processed = progress_.media_seconds - (first_media_seconds_ > 0 ? first_media_seconds_ : 0);
+	progress_.speed = progress_.elapsed_seconds > 0 ? processed / progress_.elapsed_seconds : 0;
+	if (progress_.duration_seconds > 0)
+	{
+		double percent = progress_.media_seconds * 100 / progress_.duration_seconds;
+		progress_.percent = percent < 100 ? percent : 100;
+		double remaining = progress_.duration_seconds - progress_.media_seconds;
+		progress_.eta_seconds = (progress_.speed > 0) ? (remaining > 0 ? remaining : 0) / progress_.speed : -1;
+	}
+
+	progress_last_ = now;
+	progress_last_frames_ = stats_.video_frames;
+	progress_callback_(progress_);
+}
+
+void XFileTranscoder::ReleaseNumaNode()
+{
+	numa_binding_.Unbind();
+	if (numa_acquired_node_ >= 0)
+	{
+		XNuma::Instance().ReleaseNode(numa_acquired_node_);
+		numa_acquired_node_ = -1;
+	}
+}
+
+void XFileTranscoder::UpdateMemoryStats()
+{
+	stats_.decode_memory = { decode_memory_.current(), decode_memory_.peak() };
+	stats_.encode_memory = { encode_memory_.current(), encode_memory_.peak() };
+	stats_.mux_memory = { mux_memory_.current(), mux_memory_.peak() };
+	stats_.job_memory = { job_memory_.current(), job_memory_.peak() };
 }
 
 void XFileTranscoder::Cleanup()
@@ -654,6 +1743,20 @@ void XFileTranscoder::Cleanup()
 		audio_decoder_ = nullptr;
 	}
 
+	stream_slots_.clear();
+	av_frame_free(&decoded_frame_);
+	av_frame_free(&scaled_video_frame_);
+	av_frame_free(&last_video_frame_);
+	av_frame_free(&filtered_frame_);
+	filter_graph_.Close();
+	quality_meter_.Close();
+	frame_stats_.Close();
+	frame_tap_.Close();
+	packet_trace_.Close();
+	tiled_scaler_.Close();
+	av_frame_free(&audio_frame_);
+	audio_resampler_.Close();
+
 	// رղװװ
 	if (muxer_)
 	{
@@ -665,4 +1768,14 @@ void XFileTranscoder::Cleanup()
 		demuxer_->Close();
 		demuxer_ = nullptr;
 	}
+	// ƴԴֹ̣ͣ߳رո
+	if (concat_)
+	{
+		concat_->Close();
+		delete concat_;
+		concat_ = nullptr;
+	}
+
+	// ߳˳ָ߳׺
+	ReleaseNumaNode();
 }
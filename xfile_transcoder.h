@@ -1,20 +1,41 @@
 //xfile_transcoder.h
 #pragma once
 #include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include "xdemuxer.h"
 #include "xmuxer.h"
+#include "xstats.h"
+#include "xspeed_controller.h"
+#include "xframe_diff.h"
+#include "xcheckpoint.h"
+#include "xtranscode_cache.h"
+#include "xaudio_resampler.h"
+#include "xfilter_graph.h"
+#include "xtiled_scaler.h"
+#include "xquality_meter.h"
+#include "xframe_stats_writer.h"
+#include "xpacket_trace.h"
+#include "xframe_tap.h"
+#include "xmemory_budget.h"
+#include "xnuma.h"
 
 extern "C" {
 #include <libavcodec/codec_id.h>
+#include <libavutil/avutil.h>
 #include <libswscale/swscale.h>
 }
 
 // ǰ FFmpeg ṹ壨ͷļ
 struct AVFormatContext;
 struct AVCodecContext;
+struct AVCodec;
 
 class XEncoder;
 class XDecoder;
+class XConcatSource;
 
 /**
  * @brief ļתִ֧ʽתΪָʽ
@@ -26,6 +47,20 @@ class XDecoder;
  * @endcode
  */
 class XFileTranscoder {
+public:
+	// ظֹ֡棩ʽ
+	enum class DuplicateMode {
+		Off,	// 
+		Drop,	// ظ֡Ϊ֡
+		Repeat	// طһ֡棬ţٱ
+	};
+
+	// ԭʼ֡·ȡ֡λ
+	enum class TapPoint {
+		Decoded,	// 루ü˾ǰƬԴߴ͸ʽ
+		Encoder		// ͱ֡ߴͱظʽ
+	};
+
 public:
 	// /
 	XFileTranscoder() = default;
@@ -40,21 +75,222 @@ public:
 		int fps = 25
 	);
 
+	// ƴӣƬͷ桢Ƭ˳ϳһÿԽװ룬
+	// ǰʱһں̨߳д򿪲Ԥ룬лʱȴʱ
+	// ߴΪ 0 ʱȡһĳߴ磬ߴظʽ뾭˾ͼͳһ
+	// Ƶȡһ룬ûƵ벹뷶Χϵ治ƴ
+	bool Transcode(
+		const std::vector<std::string>& input_files,
+		const std::string& output_file,
+		int output_width, int output_height,
+		AVCodecID output_codec_id = AV_CODEC_ID_H264,
+		int bitrate_kbps = 2000,
+		int fps = 25
+	);
+
+	// ֶƬ MP4  HLS/CMAF Transcode() ǰ
+	// Ƶ GOP ֶʱ룬ÿֶǿΪؼֶ߲֡߱
+	void SetSegmentOutput(XMuxer::SegmentMode mode, int segment_seconds = 4);
+
+	//  MP4moov ļͷɱر߲ţʱ뷶ΧļͷԤ moov
+	// ڽʱдһļ㲻ʱ˻ƣ XMuxer::SetFastStart()ֶʱ
+	void SetFastStart(bool enable) { fast_start_ = enable; }
+
+	// üȥ֡ıߵأȥڱߣָֻ֡Ϳߣء
+	// üĻֱҪʱֱͱֵ 2 ȡɫȶ룩
+	void SetCrop(int left, int top, int right, int bottom);
+	// 䣺output_width x output_height ĻܼӺڱߣߴΪߴ䡣
+	// ֱд֡Ļ򣬱߿ֻڷ仺ʱһ
+	void SetPad(int left, int top, int right, int bottom);
+
+	// Ƶ˾libavfilter  "yadif,hqdn3d" ȥн룩ڽ֮䴦
+	// úš䡢ʽת˾֮˾ͼɣʹ sws_scale
+	// threads Ϊ˾ slice ߳0 ʱ CPU ַر
+	void SetVideoFilters(const std::string& filters, int threads = 0);
+
+	// ظʽAV_PIX_FMT_NONEĬϣʱӱֵ֧ĸʽѡӽ
+	//  10bit/4:2:2 ƬԴֻ֧ 8bit 4:2:0 ıλɫתͬһ sws_scale ɣ
+	// ʽͳߴ綼ʱ
+	void SetOutputPixelFormat(AVPixelFormat pix_fmt) { output_pix_fmt_ = pix_fmt; }
+
+	// ֿ鲢У8K ȳ߷ֱʣÿ֡Űдָ tiles ֻ̣߳߳Լл壬
+	// ֱд֡encode Ϊ true ʱͬʱ tile/У XEncoder::SetParallelTiles()
+	// ֵ֧ı䣩ʹ˾ʱ˾ͼɣֻԱЧ0  1 ر
+	void SetTiles(int tiles, bool encode = true);
+
+	// ظ֡⣺ڽ֮ȽϽȣthreshold Ϊ 8x8 ÿƽԲֵ
+	void SetDuplicateFrameMode(DuplicateMode mode, double threshold = 1.0);
+
+	// ϵ HLS ֶÿֶύѶϵд <ļ>.ckpt
+	// жϺͬУӲбһֶ֮
+	void SetCheckpoint(bool enable) { checkpoint_enabled_ = enable; }
+
+	// ֻתһΣ[start_ts, end_ts)ʱΪƵʱ
+	// AV_NOPTS_VALUE ʾޡstart_ts ӦΪؼ֡λãֲʽֶתʹã
+	void SetInputRange(int64_t start_ts, int64_t end_ts);
+
+	// 棨Уɶתͬݺٴύʱ
+	// ֱ/ϴεת롣HLS ļʹû
+	void SetCache(XTranscodeCache* cache) { cache_ = cache; }
+
+	// Ƶcodec_id Ϊ AV_CODEC_ID_NONEΪ 0 ʱͬ
+	//  SetAudioOutput(AV_CODEC_ID_AAC, 44100, 2, 128)  5.1/48k תΪ 44.1k AAC
+	void SetAudioOutput(AVCodecID codec_id, int sample_rate = 0, int channels = 0, int bitrate_kbps = 0);
+
+	// ʵʱĿ꣨ 1.5 ʾ 1.5 ʵʱ<= 0 ر
+	//  GOP ߽簴ʵ֡ʵڱٶȵλÿε¼ͳϢ
+	// ı SPS/PPSο֡ȹ̶ֻ˶ǰհѡ
+	void SetRealtimeTarget(double speed);
+
+	// NUMA ã롢š̰߳󶨵ͬһڵ㣬֡ڸýڵ㱾ڴ
+	// node Ϊ -1 ʱڱڰڵеԶ䣨ɢڵ㣩
+	void SetNumaPlacement(bool enable, int node = -1);
+
+	// ÿ interval_seconds ȡ window_frames ֡ǿƹؼ֡
+	// Ӧıڼ߳Ƚ PSNR/SSIM GetStats().quality
+	void SetQualityMeter(bool enable, int interval_seconds = 10, int window_frames = 4);
+
+	// ݸӶԶѡʣǰƬԴռ/ʱ临ӶȺƼʣ
+	//  Transcode()  bitrate_kbpsmin_kbps/max_kbps Ϊ 0 ʱ
+	void SetAutoBitrate(bool enable, int min_kbps = 0, int max_kbps = 0);
+
+	// ֡ͳƣÿƵĴС֡͡QPӳд <ļ>.frames.csv
+	// ɺ̨߳дļڷʳ뿨ٵ֡
+	void SetFrameStats(bool enable) { frame_stats_enabled_ = enable; }
+
+	// ԭʼ֡·֡ڴ滷Linux Ϊ /dev/shm/<name>ʽ xframe_tap.h
+	// ͬķ XFrameTapReader ֱӶȡٽƬԴslots Ϊе֡
+	// תӲȴˣ˸ʱַ֡ر
+	void SetFrameTap(const std::string& name, TapPoint point = TapPoint::Encoder, int slots = 8);
+
+	// ׷٣ÿװİʱСؼ֡Ͷ롢׶κʱд path
+	// ʽ xpacket_trace.hwith_data ͬʱ¼ݡ tools/xtrace_replay ڱػطţ
+	// ¼ʱɺϳɸػطţҪԭƬԴƴ벻ַ֧֡ر
+	void SetPacketTrace(const std::string& path, bool with_data = false);
+
+	// ڴԤΪ̼XMemoryBudget::Instance().SetLimit()ʱͣȡ룬
+	// µ Transcode() ܾ false
+
+	// Ȼصת߳еãλصټ interval_msصڲҪʱ
+	using ProgressCallback = std::function<void(const XTranscodeProgress&)>;
+	void SetProgressCallback(ProgressCallback callback, int interval_ms = 500);
+
+	// Эʽȡɴ̵߳ãת߳ڶ֮飬
+	// ٴһ֡ Cleanup() ˳Transcode()  false
+	// ֻе Transcode() Чÿ Transcode() ʼʱ
+	void Cancel() { cancel_requested_.store(true, std::memory_order_relaxed); }
+
+	// һ Transcode() ͳϢ
+	const XTranscodeStats& GetStats() const { return stats_; }
+
 private:
 	// ñϸ
 	XDecoder* SetupDecoder(int stream_index);
-	XEncoder* SetupAudioEncoder(int stream_index);
+	XEncoder* SetupAudioEncoder();
 	XEncoder* SetupVideoEncoder(
-		int stream_index,
 		int width, int height,
 		AVCodecID codec_id,
 		int bitrate_kbps,
 		int fps
 	);
 
+	// Ƶ/ƵȡģƴȡһĽ
+	const AVCodecContext* VideoInputContext();
+	const AVCodecContext* AudioInputContext();
+
+	// ˮߣÿĴʽƵת롢Ƶת룩ڽʱȷһΣ
+	// ѭ FlushDecoder()  stream_index ȡֱӵͬһȽš
+	// ֧ƣֱֻͨһ·Ƶһ·ƵҷΧüϵ moov 
+	// ·ƣƵҪԴʱλãһɶ¼ͳϢ
+	enum class StreamKind { Discard, Audio, Video };
+	enum class DecodeResult { Success, Ended, Failed };
+	struct StreamSlot;
+	using StreamHandler = DecodeResult(XFileTranscoder::*)(StreamSlot& slot, AVPacket* pkt);
+	struct StreamSlot
+	{
+		StreamHandler handler{ nullptr };
+		int index{ -1 };
+		XDecoder* decoder{ nullptr };
+		AVRational time_base{ 0, 1 };	// ʱ
+		int64_t encode_us{ 0 };			// һε֡ĺʱ֡׷ã
+		int frames{ 0 };
+	};
+	// װƴʱɽ߳̽룩
+	void BuildStreamPipelines();
+	// Ͱnullptr Ϊˢ£ȫ֡ʱ㡢ϵ/Χˡ kind 
+	template <StreamKind kind>
+	DecodeResult DecodeStream(StreamSlot& slot, AVPacket* pkt);
+
 	bool FlushDecoder();
 	bool FlushEncoder();
+	// ſյдװ
+	bool DrainEncoder(XEncoder* encoder, int stream_index);
+	// ȡеİдװʱΪʱ
+	bool ReceivePackets(XEncoder* encoder, int stream_index);
+
+	// Ƶ֡ز FIFO Ϊ֡룬nullptr ʾ FIFO ʣĲ
+	bool EncodeAudioFrame(AVFrame* frame);
 
+	// GOP ߽ٶȣҪʱſղµλ´Ƶ
+	bool AdjustEncoderSpeed(AVFrame* frame);
+	bool ReopenVideoEncoder();
+
+	// ֡Ƿ뷶ΧڣʱжϣԽΧյʱ¼ѽ
+	bool IsInInputRange(int stream_index, AVFrame* frame);
+
+	// Ӱݵȫ output_file ƶϵķװʽڻͶϵУ
+	std::string OutputParams(const std::string& output_file) const;
+
+	// ϵضϵ㲢λ룬ڱ󡢷װǰ
+	bool PrepareResume(const std::string& input_file, const std::string& output_file);
+	// ֡Ƿѵָ㣨frame->pts Ϊʱ֮ǰ֡
+	bool IsAfterResumePoint(int stream_index, AVFrame* frame);
+	// Ƶؼ֡дװ֮ǰã·ֶʱϵ㣨pkt ʱΪʱ
+	void UpdateCheckpoint(AVPacket* pkt);
+
+	// ǰô˾ͼû˾ +  +  + ʽת
+	bool SetupFilterGraph(int src_width, int src_height, AVPixelFormat src_pix_fmt,
+		AVPixelFormat dst_pix_fmt, int fps);
+
+	// Ƶ֡룺ü -> ˾ -> SendVideoFrame()nullptr ʾȡ˾ͼʣ֡
+	bool EncodeVideoFrame(AVFrame* frame);
+	// ȡ˾ͼе֡
+	bool SendFilteredFrames();
+	// ǿƹؼ֡ٶȻظ֡⡢źͱдװframe->pts Ϊʱ
+	bool SendVideoFrame(AVFrame* frame);
+	// üָ֡Ϳ
+	bool CropVideoFrame(AVFrame* frame);
+
+	// ӶԤɹʱƼ滻 bitrate_kbps_
+	bool ApplyAutoBitrate(const std::string& input_file);
+
+	// ֡ߴ硢ظʽͬʱţ򲻾
+	// ˷ֿʱ÷ֿ
+	bool SetupScaler(int src_width, int src_height, AVPixelFormat src_pix_fmt,
+		int dst_width, int dst_height, AVPixelFormat dst_pix_fmt);
+
+	// ѡظʽʧܷ AV_PIX_FMT_NONE
+	AVPixelFormat NegotiatePixelFormat(const AVCodec* codec, AVPixelFormat src_pix_fmt);
+
+	// Ƶ֡ظ֡⡢ţframe_to_encode Ϊ nullptr ʾ֡Ѷ
+	bool PrepareVideoFrame(AVFrame* frame, AVFrame*& frame_to_encode);
+
+	// ֶα߽ʱƵ֡Ϊ I ֡frame->pts Ϊʱֶα߽ӵһ֡𰴼
+	void ForceSegmentKeyFrame(AVFrame* frame);
+
+
+	// ȡֻһԭӱ״ηʱ¼ͳϢ
+	bool IsCancelled();
+	// صʱ㲢صȣframe->pts Ϊʱforce Ϊ true ʱص
+	void ReportProgress(const AVFrame* frame, bool force = false);
+	// 㱾Ҫʱ䷶Χ룩ڽȺ ETA
+	void SetupProgress();
+
+	// 黹Զ NUMA ڵ㲢ָ߳׺
+	void ReleaseNumaNode();
+
+	// ڴдͳϢ
+	void UpdateMemoryStats();
 
 	// Դ
 	void Cleanup();
@@ -73,8 +309,140 @@ private:
 	// Ƶ
 	SwsContext* sws_video_ctx_{ nullptr };
 	AVFrame* scaled_video_frame_{ nullptr };
+	// ã֡仯ʱã
+	int scaler_src_width_{ 0 };
+	int scaler_src_height_{ 0 };
+	AVPixelFormat scaler_src_pix_fmt_{ AV_PIX_FMT_NONE };
+	// ֿ鲢ţʱ sws_video_ctx_
+	int tiles_{ 0 };
+	bool tile_encoding_{ true };
+	XTiledScaler tiled_scaler_;
+
+	// ü֡ȥأ䣨֡ߵĺڱߣ
+	int crop_left_{ 0 };
+	int crop_top_{ 0 };
+	int crop_right_{ 0 };
+	int crop_bottom_{ 0 };
+	int pad_left_{ 0 };
+	int pad_top_{ 0 };
+	int pad_right_{ 0 };
+	int pad_bottom_{ 0 };
+	AVPixelFormat output_pix_fmt_{ AV_PIX_FMT_NONE };	// ָظʽ
+
+	// Ƶ˾
+	std::string video_filters_;
+	int filter_threads_{ 0 };
+	XFilterGraph filter_graph_;
+	AVFrame* filtered_frame_{ nullptr };	// ˾ͼȡ֡
+
+	// 
+	bool quality_enabled_{ false };
+	int quality_interval_seconds_{ 10 };
+	int quality_window_frames_{ 4 };
+	XQualityMeter quality_meter_;
+
+	// ݸӶԶѡ
+	bool auto_bitrate_{ false };
+	int auto_bitrate_min_kbps_{ 0 };
+	int auto_bitrate_max_kbps_{ 0 };
+
+	// ֡ͳ
+	bool frame_stats_enabled_{ false };
+	XFrameStatsWriter frame_stats_;
+
+	// ԭʼ֡·
+	std::string frame_tap_name_;
+	TapPoint frame_tap_point_{ TapPoint::Encoder };
+	int frame_tap_slots_{ 8 };
+	XFrameTap frame_tap_;
+
+	// ׷
+	std::string packet_trace_path_;
+	bool packet_trace_data_{ false };
+	XPacketTraceWriter packet_trace_;
+
+	// ظ֡
+	DuplicateMode duplicate_mode_{ DuplicateMode::Off };
+	double duplicate_threshold_{ 1.0 };
+	XFrameDiff frame_diff_;
+	AVFrame* last_video_frame_{ nullptr };	// ʱһͱ֡Repeat ã
+
+	// Ƶת
+	AVCodecID audio_codec_id_{ AV_CODEC_ID_NONE };
+	int audio_sample_rate_{ 0 };
+	int audio_channels_{ 0 };
+	int audio_bitrate_kbps_{ 0 };
+	XAudioResampler audio_resampler_;
+
+	// ƴӣʱΪ nullptr
+	XConcatSource* concat_{ nullptr };
+	AVFrame* audio_frame_{ nullptr };	// FIFO ȡı֡
+
+	// ˮ߱±Ϊţͽ֡
+	std::vector<StreamSlot> stream_slots_;
+	AVFrame* decoded_frame_{ nullptr };
 
 	//Ƶ
 	int video_frame_counter_{ 0 };
 	int audio_frame_counter_{ 0 };
+
+	// ֶ
+	XMuxer::SegmentMode segment_mode_{ XMuxer::SegmentMode::None };
+	int segment_seconds_{ 4 };
+	int64_t keyframe_interval_{ 0 };	// ǿƹؼ֡ʱ0 ʾǿ
+	int64_t next_keyframe_pts_{ 0 };
+	int64_t keyframe_anchor_pts_{ 0 };	// ǿƹؼ֡ê㣨һ֡ ptsؼ֡λê + k * 
+	bool keyframe_anchored_{ false };
+	//  MP4
+	bool fast_start_{ false };
+
+	// 뷶ΧƵʱ
+	int64_t range_start_{ AV_NOPTS_VALUE };
+	int64_t range_end_{ AV_NOPTS_VALUE };
+	bool range_video_done_{ false };
+	bool range_audio_done_{ false };
+
+	// ϵ
+	bool checkpoint_enabled_{ false };
+	std::string checkpoint_path_;		// Ϊձʾβ¼ϵ
+	XCheckpoint checkpoint_;
+	bool resuming_{ false };
+
+	// Ƶؿʱʹã
+	int output_width_{ 0 };
+	int output_height_{ 0 };
+	AVCodecID output_codec_id_{ AV_CODEC_ID_H264 };
+	int bitrate_kbps_{ 2000 };
+	int fps_{ 25 };
+
+	// ٶȿ
+	double realtime_speed_{ 0 };
+	XSpeedController speed_controller_;
+
+	XTranscodeCache* cache_{ nullptr };
+
+	// NUMA 
+	bool numa_enabled_{ false };
+	int numa_node_{ -1 };
+	int numa_acquired_node_{ -1 };	// AcquireNode() Ľڵ㣬ʱ黹
+	XNumaBinding numa_binding_;
+
+	// ȡ
+	ProgressCallback progress_callback_;
+	int progress_interval_ms_{ 500 };
+	std::atomic<bool> cancel_requested_{ false };
+	XTranscodeProgress progress_;
+	std::chrono::steady_clock::time_point progress_start_;
+	std::chrono::steady_clock::time_point progress_last_;
+	int64_t progress_last_frames_{ 0 };
+	double input_start_seconds_{ 0 };	// ʱϵĴ
+	double first_media_seconds_{ -1 };	// һ֡ýʱ䣨ϵΧתʱΪ 0
+
+	// ڴ׶ ->  -> Ԥ
+	XMemoryCounter decode_memory_;
+	XMemoryCounter encode_memory_;
+	XMemoryCounter mux_memory_;
+	XMemoryCounter job_memory_;
+
+	XTranscodeStats stats_;
 };
\ No newline at end of file
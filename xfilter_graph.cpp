@@ -0,0 +1,147 @@
+// xfilter_graph.cpp
+#include "xfilter_graph.h"
+#include "xlog.h"
+#include <iostream>
+#include <thread>
+
+extern "C" {
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersrc.h>
+#include <libavfilter/buffersink.h>
+#include <libavutil/frame.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+#pragma comment(lib, "avfilter.lib")
+#pragma comment(lib, "avutil.lib")
+
+XFilterGraph::~XFilterGraph()
+{
+	Close();
+}
+
+bool XFilterGraph::Init(const std::string& desc, int width, int height, AVPixelFormat pix_fmt,
+	AVRational time_base, AVRational sample_aspect_ratio, int threads)
+{
+	Close();
+	char errbuf[256] = { 0 };
+	AVFilterInOut* inputs = nullptr;
+	AVFilterInOut* outputs = nullptr;
+	bool is_successed = false;
+	int ret = 0;
+
+	graph_ = avfilter_graph_alloc();
+	if (!graph_)
+	{
+		std::cerr << "Error: avfilter_graph_alloc failed!" << std::endl;
+		return false;
+	}
+	// slice ̣߳ÿ֡з̴ָ߳֡ӳ
+	if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+	graph_->nb_threads = threads;
+	graph_->thread_type = AVFILTER_THREAD_SLICE;
+
+	if (sample_aspect_ratio.num <= 0 || sample_aspect_ratio.den <= 0) sample_aspect_ratio = { 1, 1 };
+	char args[256] = { 0 };
+	snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+		width, height, (int)pix_fmt, time_base.num, time_base.den,
+		sample_aspect_ratio.num, sample_aspect_ratio.den);
+
+	ret = avfilter_graph_create_filter(&src_ctx_, avfilter_get_by_name("buffer"), "in", args, nullptr, graph_);
+	if (ret < 0)
+	{
+		av_strerror(ret, errbuf, sizeof(errbuf));
+		std::cerr << "Error: create buffer filter failed: " << errbuf << std::endl;
+		goto cleanup;
+	}
+	ret = avfilter_graph_create_filter(&sink_ctx_, avfilter_get_by_name("buffersink"), "out", nullptr, nullptr, graph_);
+	if (ret < 0)
+	{
+		av_strerror(ret, errbuf, sizeof(errbuf));
+		std::cerr << "Error: create buffersink filter failed: " << errbuf << std::endl;
+		goto cleanup;
+	}
+
+	// еδ/ֱ buffer  buffersink
+	outputs = avfilter_inout_alloc();
+	inputs = avfilter_inout_alloc();
+	if (!outputs || !inputs) goto cleanup;
+	outputs->name = av_strdup("in");
+	outputs->filter_ctx = src_ctx_;
+	outputs->pad_idx = 0;
+	outputs->next = nullptr;
+	inputs->name = av_strdup("out");
+	inputs->filter_ctx = sink_ctx_;
+	inputs->pad_idx = 0;
+	inputs->next = nullptr;
+
+	ret = avfilter_graph_parse_ptr(graph_, desc.c_str(), &inputs, &outputs, nullptr);
+	if (ret < 0)
+	{
+		av_strerror(ret, errbuf, sizeof(errbuf));
+		std::cerr << "Error: parse filter graph '" << desc << "' failed: " << errbuf << std::endl;
+		goto cleanup;
+	}
+	ret = avfilter_graph_config(graph_, nullptr);
+	if (ret < 0)
+	{
+		av_strerror(ret, errbuf, sizeof(errbuf));
+		std::cerr << "Error: config filter graph '" << desc << "' failed: " << errbuf << std::endl;
+		goto cleanup;
+	}
+
+	in_width_ = width;
+	in_height_ = height;
+	in_format_ = pix_fmt;
+	width_ = av_buffersink_get_w(sink_ctx_);
+	height_ = av_buffersink_get_h(sink_ctx_);
+	format_ = (AVPixelFormat)av_buffersink_get_format(sink_ctx_);
+	time_base_ = av_buffersink_get_time_base(sink_ctx_);
+	is_successed = true;
+
+cleanup:
+	avfilter_inout_free(&inputs);
+	avfilter_inout_free(&outputs);
+	if (!is_successed) Close();
+	return is_successed;
+}
+
+void XFilterGraph::Close()
+{
+	// ˾˾ͼͷ
+	avfilter_graph_free(&graph_);
+	src_ctx_ = nullptr;
+	sink_ctx_ = nullptr;
+}
+
+bool XFilterGraph::MatchesInput(const AVFrame* frame) const
+{
+	return frame->width == in_width_ && frame->height == in_height_ && frame->format == in_format_;
+}
+
+bool XFilterGraph::Push(AVFrame* frame)
+{
+	if (!src_ctx_) return false;
+	//  KEEP_REFֱ֡ƽҲ
+	int ret = av_buffersrc_add_frame_flags(src_ctx_, frame, 0);
+	if (ret < 0)
+	{
+		XLog::Instance().WriteAvError(XLogLevel::Error, "XFilterGraph::Push", "av_buffersrc_add_frame_flags failed", ret);
+		return false;
+	}
+	return true;
+}
+
+XFilterGraph::ReceiveResult XFilterGraph::Pull(AVFrame* frame)
+{
+	if (!sink_ctx_ || !frame) return ReceiveResult::Failed;
+
+	int ret = av_buffersink_get_frame(sink_ctx_, frame);
+	if (ret == 0) return ReceiveResult::Success;
+	if (ret == AVERROR(EAGAIN)) return ReceiveResult::NeedFeed;
+	if (ret == AVERROR_EOF) return ReceiveResult::Ended;
+
+	XLog::Instance().WriteAvError(XLogLevel::Error, "XFilterGraph::Pull", "av_buffersink_get_frame failed", ret);
+	return ReceiveResult::Failed;
+}
@@ -0,0 +1,67 @@
+// xfilter_graph.h
+#pragma once
+#include <string>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+#include <libavutil/rational.h>
+}
+
+struct AVFrame;
+struct AVFilterGraph;
+struct AVFilterContext;
+
+/**
+ * @brief Ƶ˾ͼbuffer -> ˾ "yadif,hqdn3d"-> buffersink
+ *
+ * ֡ƽ˾ͼֱ֡ȡ˾Ļȡء
+ * ˾ڲ slice ̴߳yadifhqdn3doverlay ֧ slice ̵߳˾
+ * һ֡ܶӦ֡֡ yadif=send_field ÿ֡ѭ Pull() ֱ NeedFeed
+ */
+class XFilterGraph
+{
+public:
+	enum class ReceiveResult {
+		Success,	// ȡһ֡
+		NeedFeed,	// Ҫ֡
+		Ended,		// ѽȫȡ
+		Failed
+	};
+
+public:
+	~XFilterGraph();
+
+	// ֡˾ͼtime_base Ϊ֡ pts ʱthreads Ϊ 0 ʱ CPU 
+	bool Init(const std::string& desc, int width, int height, AVPixelFormat pix_fmt,
+		AVRational time_base, AVRational sample_aspect_ratio, int threads = 0);
+	void Close();
+
+	// һ֡֡ƽ˾ͼغ frame Ϊգnullptr ʾ
+	bool Push(AVFrame* frame);
+	// ȡһ֡pts Ϊ time_base()
+	ReceiveResult Pull(AVFrame* frame);
+
+	bool is_open() const { return graph_ != nullptr; }
+	// Init() ɹЧ
+	int width() const { return width_; }
+	int height() const { return height_; }
+	AVPixelFormat format() const { return format_; }
+	AVRational time_base() const { return time_base_; }
+	// ֡ߴ硢ظʽ봴ʱͬͬʱؽ˾ͼ
+	bool MatchesInput(const AVFrame* frame) const;
+
+private:
+	AVFilterGraph* graph_{ nullptr };
+	AVFilterContext* src_ctx_{ nullptr };
+	AVFilterContext* sink_ctx_{ nullptr };
+
+	// 
+	int in_width_{ 0 };
+	int in_height_{ 0 };
+	AVPixelFormat in_format_{ AV_PIX_FMT_NONE };
+
+	int width_{ 0 };
+	int height_{ 0 };
+	AVPixelFormat format_{ AV_PIX_FMT_NONE };
+	AVRational time_base_{ 1, 1 };
+};
@@ -0,0 +1,72 @@
+// xframe_diff.cpp
+#include "xframe_diff.h"
+#include "xpixel_ops.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+void XFrameDiff::Reset()
+{
+	has_reference_ = false;
+	thumb_width_ = 0;
+	thumb_height_ = 0;
+}
+
+bool XFrameDiff::MakeThumbnail(const AVFrame* frame)
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+	if (!desc || (desc->flags & AV_PIX_FMT_FLAG_RGB) || desc->comp[0].depth != 8) return false;
+	if (frame->width < 64 || frame->height < 64) return false;
+
+	int half_width = frame->width / 2;
+	int half_height = frame->height / 2;
+	int width = half_width / 2;
+	int height = half_height / 2;
+	if (width != thumb_width_ || height != thumb_height_)
+	{
+		// ߴ仯ɲο֡
+		thumb_width_ = width;
+		thumb_height_ = height;
+		has_reference_ = false;
+		half_.resize((size_t)half_width * half_height);
+		current_.resize((size_t)width * height);
+		reference_.resize((size_t)width * height);
+		block_sad_.resize((size_t)(width / 8) * (height / 8));
+	}
+
+	// 4x4  2x2
+	XPixelOps::Downsample2x(frame->data[0], frame->linesize[0],
+		frame->width, frame->height, half_.data(), half_width);
+	XPixelOps::Downsample2x(half_.data(), half_width,
+		half_width, half_height, current_.data(), width);
+	return true;
+}
+
+bool XFrameDiff::IsDuplicate(const AVFrame* frame)
+{
+	if (!frame || !frame->data[0]) return false;
+	if (!MakeThumbnail(frame)) return false;
+
+	if (!has_reference_)
+	{
+		reference_.swap(current_);
+		has_reference_ = true;
+		return false;
+	}
+
+	XPixelOps::BlockSad8x8(current_.data(), thumb_width_,
+		reference_.data(), thumb_width_,
+		thumb_width_, thumb_height_, block_sad_.data());
+
+	uint32_t max_sad = 0;
+	for (uint32_t sad : block_sad_)
+	{
+		if (sad > max_sad) max_sad = sad;
+	}
+	if (max_sad <= threshold_ * 64) return true;
+
+	reference_.swap(current_);
+	return false;
+}
@@ -0,0 +1,37 @@
+// xframe_diff.h
+#pragma once
+#include <vector>
+#include <cstdint>
+
+struct AVFrame;
+
+/**
+ * @brief ظ֡⣺Ƚϵǰ֡ο֡һͱ֡Ľ
+ *
+ * ƽ 4x4 ٰ 8x8  SADӦԭͼ 32x32 򣩡
+ * пƽԲֵʱΪظֲ֡仯ƶᱻƽ
+ * ֻ֧ 8 λ YUV ʽʽʼշ false
+ */
+class XFrameDiff
+{
+public:
+	// thresholdÿƽԲ
+	void SetThreshold(double threshold) { threshold_ = threshold; }
+	void Reset();
+
+	// ж frame Ƿο֡ظظʱ frame ΪµĲο֡
+	bool IsDuplicate(const AVFrame* frame);
+
+private:
+	bool MakeThumbnail(const AVFrame* frame);
+
+private:
+	double threshold_{ 1.0 };
+	int thumb_width_{ 0 };
+	int thumb_height_{ 0 };
+	bool has_reference_{ false };
+	std::vector<uint8_t> reference_;	// ο֡ͼ
+	std::vector<uint8_t> current_;		// ǰ֡ͼ
+	std::vector<uint8_t> half_;			// 2x м
+	std::vector<uint32_t> block_sad_;
+};
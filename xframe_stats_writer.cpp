@@ -0,0 +1,103 @@
+// xframe_stats_writer.cpp
+#include "xframe_stats_writer.h"
+#include <iostream>
+#include <chrono>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4996)
+#endif
+
+// ﵽʱд̣߳򰴼д
+static const size_t kBatchRecords = 256;
+static const int kFlushIntervalMs = 500;
+
+XFrameStatsWriter::~XFrameStatsWriter()
+{
+	Close();
+}
+
+bool XFrameStatsWriter::Open(const std::string& path, AVRational time_base)
+{
+	Close();
+	file_ = fopen(path.c_str(), "w");
+	if (!file_)
+	{
+		std::cerr << "Error: cannot open frame stats file '" << path << "'" << std::endl;
+		return false;
+	}
+	setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+	fputs("index,pts,dts,time,size,type,key,qp,latency_ms\n", file_);
+
+	time_base_ = time_base;
+	index_ = 0;
+	stopping_ = false;
+	pending_.reserve(kBatchRecords * 2);
+	writer_ = std::thread(&XFrameStatsWriter::WriterLoop, this);
+	return true;
+}
+
+void XFrameStatsWriter::Close()
+{
+	if (writer_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			stopping_ = true;
+		}
+		cv_.notify_one();
+		writer_.join();
+	}
+	if (file_)
+	{
+		fclose(file_);
+		file_ = nullptr;
+	}
+	pending_.clear();
+}
+
+void XFrameStatsWriter::Write(const XPacketInfo& info)
+{
+	if (!file_) return;
+	bool notify = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		pending_.push_back(info);
+		notify = pending_.size() >= kBatchRecords;
+	}
+	if (notify) cv_.notify_one();
+}
+
+void XFrameStatsWriter::WriterLoop()
+{
+	std::vector<XPacketInfo> batch;
+	batch.reserve(kBatchRecords * 2);
+	char line[256];
+	double tb = (double)time_base_.num / time_base_.den;
+	while (true)
+	{
+		bool stop = false;
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+				[this]() { return stopping_ || pending_.size() >= kBatchRecords; });
+			batch.swap(pending_);
+			stop = stopping_;
+		}
+
+		for (const XPacketInfo& info : batch)
+		{
+			int n = snprintf(line, sizeof(line), "%lld,%lld,%lld,%.6f,%d,%c,%d,",
+				(long long)index_++, (long long)info.pts, (long long)info.dts,
+				info.pts * tb, info.size, info.pict_type, info.key ? 1 : 0);
+			if (info.qp >= 0) n += snprintf(line + n, sizeof(line) - n, "%.2f", info.qp);
+			line[n++] = ',';
+			if (info.latency_ms >= 0) n += snprintf(line + n, sizeof(line) - n, "%.3f", info.latency_ms);
+			line[n++] = '\n';
+			fwrite(line, 1, n, file_);
+		}
+		batch.clear();
+		fflush(file_);
+		if (stop) break;
+	}
+}
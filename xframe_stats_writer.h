@@ -0,0 +1,47 @@
+// xframe_stats_writer.h
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "xencoder.h"
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+/**
+ * @brief ֡ͳ CSV ·ļС֡͡ؼ֡QPӳ٣
+ *
+ * תֻ߳Ѽ¼׷ӵڴ滺壬ɺ̨߳ʽдļתѭ I/O
+ * Уindex,pts,dts,time,size,type,key,qp,latency_mstime Ϊ룬qp/latency_ms δ֪ʱΪգ
+ */
+class XFrameStatsWriter
+{
+public:
+	~XFrameStatsWriter();
+
+	// time_base Ϊ¼ pts/dts ʱʱ
+	bool Open(const std::string& path, AVRational time_base);
+	// дʣļ¼رļ
+	void Close();
+	bool is_open() const { return file_ != nullptr; }
+
+	void Write(const XPacketInfo& info);
+
+private:
+	void WriterLoop();
+
+private:
+	FILE* file_{ nullptr };
+	AVRational time_base_{ 1, 1 };
+	int64_t index_{ 0 };
+
+	std::thread writer_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::vector<XPacketInfo> pending_;
+	bool stopping_{ false };
+};
@@ -0,0 +1,321 @@
+// xframe_tap.cpp
+#include "xframe_tap.h"
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+// ƽж루˿ֱ SIMD 
+static const int kLineAlign = 64;
+
+static size_t Align64(size_t size)
+{
+	return (size + 63) & ~(size_t)63;
+}
+
+// create Ϊ trueд򿪣ֻڴ沢ӳ䣬size Ϊ 0 ʱӳ
+static uint8_t* MapShared(const std::string& name, size_t& size, bool create, void*& handle)
+{
+	handle = nullptr;
+#ifdef _WIN32
+	std::string path = "Local\\" + name;
+	HANDLE mapping = create
+		? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			(DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), path.c_str())
+		: OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+	if (!mapping) return nullptr;
+	void* base = MapViewOfFile(mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+	if (!base)
+	{
+		CloseHandle(mapping);
+		return nullptr;
+	}
+	if (size == 0)
+	{
+		MEMORY_BASIC_INFORMATION info{};
+		VirtualQuery(base, &info, sizeof(info));
+		size = info.RegionSize;
+	}
+	handle = mapping;
+	return (uint8_t*)base;
+#else
+	std::string path = "/" + name;
+	int fd = -1;
+	if (create)
+	{
+		// ϴ쳣˳ͬ󣨶ӳŵľɶӰ죩
+		shm_unlink(path.c_str());
+		fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (fd >= 0 && ftruncate(fd, (off_t)size) != 0)
+		{
+			close(fd);
+			shm_unlink(path.c_str());
+			return nullptr;
+		}
+	}
+	else
+	{
+		fd = shm_open(path.c_str(), O_RDONLY, 0);
+		struct stat st;
+		if (fd >= 0 && fstat(fd, &st) == 0) size = (size_t)st.st_size;
+	}
+	if (fd < 0) return nullptr;
+	void* base = size > 0 ? mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		if (create) shm_unlink(path.c_str());
+		return nullptr;
+	}
+	return (uint8_t*)base;
+#endif
+}
+
+static void UnmapShared(uint8_t* base, size_t size, void* handle)
+{
+	if (!base) return;
+#ifdef _WIN32
+	UnmapViewOfFile(base);
+	if (handle) CloseHandle((HANDLE)handle);
+#else
+	munmap(base, size);
+	(void)handle;
+#endif
+}
+
+XFrameTap::~XFrameTap()
+{
+	Close();
+}
+
+bool XFrameTap::Open(const std::string& name, int slot_count, AVRational time_base)
+{
+	Close();
+	if (name.empty() || name.find('/') != std::string::npos || name.find('\\') != std::string::npos)
+	{
+		std::cerr << "Error: invalid frame tap name '" << name << "'" << std::endl;
+		return false;
+	}
+	name_ = name;
+	slot_count_ = slot_count < 2 ? 2 : slot_count;
+	time_base_ = time_base;
+	failed_ = false;
+	published_ = 0;
+	skipped_ = 0;
+	return true;
+}
+
+void XFrameTap::Close()
+{
+	if (base_)
+	{
+		auto* header = (XFrameTapHeader*)base_;
+		header->closed.store(1, std::memory_order_release);
+		UnmapShared(base_, size_, handle_);
+#ifndef _WIN32
+		shm_unlink(("/" + name_).c_str());
+#endif
+		base_ = nullptr;
+		size_ = 0;
+		handle_ = nullptr;
+	}
+	name_.clear();
+}
+
+bool XFrameTap::Create(const AVFrame* frame)
+{
+	int data_size = av_image_get_buffer_size((AVPixelFormat)frame->format, frame->width, frame->height, kLineAlign);
+	if (data_size <= 0)
+	{
+		failed_ = true;
+		return false;
+	}
+	uint64_t slot_size = Align64(sizeof(XFrameTapSlot) + (size_t)data_size);
+	size_ = sizeof(XFrameTapHeader) + slot_size * slot_count_;
+	base_ = MapShared(name_, size_, true, handle_);
+	if (!base_)
+	{
+		std::cerr << "Error: cannot create shared memory for frame tap '" << name_ << "'" << std::endl;
+		size_ = 0;
+		failed_ = true;
+		return false;
+	}
+
+	// ½Ĺڴ㣬 seq Ϊ 0֡
+	auto* header = new (base_) XFrameTapHeader;
+	header->version = kFrameTapVersion;
+	header->slot_count = (uint32_t)slot_count_;
+	header->slot_header_size = (uint32_t)sizeof(XFrameTapSlot);
+	header->slot_size = slot_size;
+	header->time_base_num = time_base_.num;
+	header->time_base_den = time_base_.den;
+	header->write_seq.store(0, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < slot_count_; i++)
+	{
+		auto* slot = new (base_ + sizeof(XFrameTapHeader) + slot_size * i) XFrameTapSlot;
+		slot->seq.store(0, std::memory_order_relaxed);
+	}
+	header->magic.store(kFrameTapMagic, std::memory_order_release);
+	return true;
+}
+
+bool XFrameTap::Publish(const AVFrame* frame)
+{
+	if (!is_open() || failed_ || !frame || !frame->data[0]) return false;
+	if (!base_ && !Create(frame)) return false;
+
+	auto* header = (XFrameTapHeader*)base_;
+	AVPixelFormat pix_fmt = (AVPixelFormat)frame->format;
+	int data_size = av_image_get_buffer_size(pix_fmt, frame->width, frame->height, kLineAlign);
+	if (data_size <= 0 || sizeof(XFrameTapSlot) + (size_t)data_size > header->slot_size)
+	{
+		skipped_++;
+		return false;
+	}
+
+	uint64_t index = (uint64_t)published_;
+	auto* slot = (XFrameTapSlot*)(base_ + sizeof(XFrameTapHeader) + header->slot_size * (index % slot_count_));
+	uint8_t* pixels = (uint8_t*)slot + sizeof(XFrameTapSlot);
+
+	// seqlockʾд˿ǰһʱ
+	slot->seq.store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint8_t* dst_data[4] = {};
+	int dst_linesize[4] = {};
+	av_image_fill_arrays(dst_data, dst_linesize, pixels, pix_fmt, frame->width, frame->height, kLineAlign);
+	av_image_copy(dst_data, dst_linesize, (const uint8_t**)frame->data, frame->linesize,
+		pix_fmt, frame->width, frame->height);
+
+	slot->pts = frame->pts;
+	slot->width = frame->width;
+	slot->height = frame->height;
+	slot->format = frame->format;
+	for (int i = 0; i < 4; i++)
+	{
+		slot->linesize[i] = dst_linesize[i];
+		slot->offset[i] = dst_data[i] ? (uint32_t)(dst_data[i] - pixels) : 0;
+	}
+	slot->data_size = (uint32_t)data_size;
+
+	slot->seq.store(index * 2 + 2, std::memory_order_release);
+	header->write_seq.store(index + 1, std::memory_order_release);
+	published_++;
+	return true;
+}
+
+XFrameTapReader::~XFrameTapReader()
+{
+	Close();
+}
+
+bool XFrameTapReader::Open(const std::string& name)
+{
+	Close();
+	size_t size = 0;
+	base_ = MapShared(name, size, false, handle_);
+	if (!base_) return false;
+	size_ = size;
+
+	auto* header = (XFrameTapHeader*)base_;
+	if (size_ < sizeof(XFrameTapHeader) ||
+		header->magic.load(std::memory_order_acquire) != kFrameTapMagic ||
+		header->version != kFrameTapVersion ||
+		header->slot_header_size != sizeof(XFrameTapSlot) ||
+		size_ < sizeof(XFrameTapHeader) + header->slot_size * header->slot_count)
+	{
+		Close();
+		return false;
+	}
+
+	// µһ֡ʼ
+	uint64_t written = header->write_seq.load(std::memory_order_acquire);
+	next_ = written > 0 ? written - 1 : 0;
+	skipped_ = 0;
+	return true;
+}
+
+void XFrameTapReader::Close()
+{
+	UnmapShared(base_, size_, handle_);
+	base_ = nullptr;
+	size_ = 0;
+	handle_ = nullptr;
+}
+
+XFrameTapSlot* XFrameTapReader::SlotAt(uint64_t index) const
+{
+	auto* header = (const XFrameTapHeader*)base_;
+	return (XFrameTapSlot*)(base_ + sizeof(XFrameTapHeader) + header->slot_size * (index % header->slot_count));
+}
+
+XFrameTapReader::ReadResult XFrameTapReader::Next(Frame& frame)
+{
+	if (!base_) return ReadResult::Closed;
+	auto* header = (const XFrameTapHeader*)base_;
+	while (true)
+	{
+		// ȶǣд˽ write_seq ٱ仯
+		bool closed = header->closed.load(std::memory_order_acquire) != 0;
+		uint64_t written = header->write_seq.load(std::memory_order_acquire);
+		if (next_ >= written) return closed ? ReadResult::Closed : ReadResult::NoFrame;
+
+		// 󳬹ȣм֡ѱǣ֡
+		if (written - next_ >= header->slot_count)
+		{
+			skipped_ += written - 1 - next_;
+			next_ = written - 1;
+		}
+
+		uint64_t index = next_++;
+		XFrameTapSlot* slot = SlotAt(index);
+		uint64_t expected = index * 2 + 2;
+		if (slot->seq.load(std::memory_order_acquire) != expected)
+		{
+			skipped_++;
+			continue;
+		}
+
+		const uint8_t* pixels = (const uint8_t*)slot + sizeof(XFrameTapSlot);
+		frame.index = index;
+		frame.pts = slot->pts;
+		frame.time_base = { header->time_base_num, header->time_base_den };
+		frame.width = slot->width;
+		frame.height = slot->height;
+		frame.format = (AVPixelFormat)slot->format;
+		for (int i = 0; i < 4; i++)
+		{
+			frame.linesize[i] = slot->linesize[i];
+			frame.data[i] = slot->linesize[i] ? pixels + slot->offset[i] : nullptr;
+		}
+		bool in_slot = sizeof(XFrameTapSlot) + (uint64_t)slot->data_size <= header->slot_size;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (!in_slot || slot->seq.load(std::memory_order_relaxed) != expected)
+		{
+			skipped_++;
+			continue;
+		}
+		return ReadResult::Frame;
+	}
+}
+
+bool XFrameTapReader::Valid(const Frame& frame) const
+{
+	if (!base_) return false;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return SlotAt(frame.index)->seq.load(std::memory_order_relaxed) == frame.index * 2 + 2;
+}
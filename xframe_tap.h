@@ -0,0 +1,156 @@
+// xframe_tap.h
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+#include <libavutil/rational.h>
+}
+
+struct AVFrame;
+
+/**
+ * ڴ֡Ĳ֣д XFrameTap  XFrameTapReader ãԵĶ˰˽
+ *
+ *   [XFrameTapHeader][ 0][ 1]...[ slot_count-1]
+ *   ÿۣ[XFrameTapSlot][]۴СΪ header.slot_size 64 ֽڶ
+ *
+ *  n ֡ 0 ʼд n % slot_count۰ seqlock £
+ * дǰ seq = 2n+1ʾдд seq = 2n+2Ȼ header.write_seq = n+1
+ * ˶ǰһ seqζ 2n+2 ʱĵ n ֡֡ѱǡ
+ * д˴Ӳȴˣ󳬹ʱֱ֡
+ */
+static const uint32_t kFrameTapMagic = 0x50415458;	// "XTAP"
+static const uint32_t kFrameTapVersion = 1;
+
+struct alignas(64) XFrameTapHeader
+{
+	std::atomic<uint32_t> magic;	// д˳ʼɺд
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t slot_header_size;	// sizeof(XFrameTapSlot)ڲڵƫ
+	uint64_t slot_size;
+	int32_t time_base_num;		// ֡ pts ʱ
+	int32_t time_base_den;
+	std::atomic<uint64_t> write_seq;	// ѷ֡
+	std::atomic<uint32_t> closed;		// д˽Ϊ 1
+};
+
+struct alignas(64) XFrameTapSlot
+{
+	std::atomic<uint64_t> seq;
+	int64_t pts;
+	int32_t width;
+	int32_t height;
+	int32_t format;				// AVPixelFormat
+	int32_t linesize[4];
+	uint32_t offset[4];			// ƽƫ
+	uint32_t data_size;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "frame tap needs lock-free 64-bit atomics");
+
+/**
+ * @brief ԭʼ֡·֡ڴ滷Linux Ϊ /dev/shm/<name>
+ * ͬķֱӳȡԼƬԴ
+ *
+ * ÿֻ֡ת߳иһΣ֡ -> ڴ棩ȴˡ
+ * ڴڵһ֡ʱ֡ĳߴ͸ʽ֮֡
+ */
+class XFrameTap
+{
+public:
+	~XFrameTap();
+
+	// name Ϊڴ·slot_count Ϊе֡time_base Ϊ֡ pts ʱ
+	bool Open(const std::string& name, int slot_count, AVRational time_base);
+	// ǽɾڴӳĶԿɶʣ֡
+	void Close();
+	bool is_open() const { return !name_.empty(); }
+
+	bool Publish(const AVFrame* frame);
+
+	int64_t published() const { return published_; }
+	int64_t skipped() const { return skipped_; }
+
+private:
+	bool Create(const AVFrame* frame);
+
+private:
+	std::string name_;
+	int slot_count_{ 8 };
+	AVRational time_base_{ 1, 1 };
+
+	uint8_t* base_{ nullptr };
+	size_t size_{ 0 };
+	void* handle_{ nullptr };	// Windows ļӳ
+	bool failed_{ false };		// ʧܺٳ
+
+	int64_t published_{ 0 };
+	int64_t skipped_{ 0 };
+};
+
+/**
+ * @brief ֡ˣNext() صƽֱָָڴ棬
+ *
+ * ʹʾ
+ * @code
+ * XFrameTapReader reader;
+ * while (!reader.Open("xtap_job1")) sleep(...);
+ * XFrameTapReader::Frame f;
+ * while (true) {
+ *     auto ret = reader.Next(f);
+ *     if (ret == XFrameTapReader::ReadResult::Closed) break;
+ *     if (ret == XFrameTapReader::ReadResult::NoFrame) { sleep(...); continue; }
+ *     Analyze(f.data[0], f.linesize[0], f.width, f.height);
+ *     if (!reader.Valid(f)) { ... }	// ڼ䱻д˸ǣ
+ * }
+ * @endcode
+ */
+class XFrameTapReader
+{
+public:
+	enum class ReadResult {
+		Frame,		// ȡһ֡
+		NoFrame,	// ֡
+		Closed		// дѽûʣ֡
+	};
+
+	struct Frame {
+		uint64_t index{ 0 };	// ֡
+		int64_t pts{ 0 };
+		AVRational time_base{ 1, 1 };
+		int width{ 0 };
+		int height{ 0 };
+		AVPixelFormat format{ AV_PIX_FMT_NONE };
+		const uint8_t* data[4]{};
+		int linesize[4]{};
+	};
+
+public:
+	~XFrameTapReader();
+
+	// дδδʼʱ falseԺ
+	bool Open(const std::string& name);
+	void Close();
+
+	// ȡһ֡󳬹ʱ֡
+	ReadResult Next(Frame& frame);
+	// ֡ǷδǣֱӶڴʱȷ
+	bool Valid(const Frame& frame) const;
+
+	// 򱻸Ƕ֡
+	uint64_t skipped() const { return skipped_; }
+
+private:
+	XFrameTapSlot* SlotAt(uint64_t index) const;
+
+private:
+	uint8_t* base_{ nullptr };
+	size_t size_{ 0 };
+	void* handle_{ nullptr };
+	uint64_t next_{ 0 };
+	uint64_t skipped_{ 0 };
+};
@@ -0,0 +1,26 @@
+// xlock_stats.cpp
+#include "xlock_stats.h"
+#include <chrono>
+
+XLockStats& XLockStats::Codec()
+{
+	static XLockStats stats;
+	return stats;
+}
+
+XLockStats& XLockStats::Format()
+{
+	static XLockStats stats;
+	return stats;
+}
+
+void XCountedMutex::lock()
+{
+	if (mtx_.try_lock()) return;
+
+	auto start = std::chrono::steady_clock::now();
+	mtx_.lock();
+	auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	stats_.contended.fetch_add(1, std::memory_order_relaxed);
+	stats_.wait_ns.fetch_add(wait.count(), std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+// xlock_stats.h
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief ͳƣۼƾʱѱ̳߳У͵ȴʱ
+ *
+ * ת񲢷ʱжչƿǷ XCodec/XAvFormat Ļϣ tools/xscaling_bench
+ */
+struct XLockStats
+{
+	std::atomic<int64_t> contended{ 0 };
+	std::atomic<int64_t> wait_ns{ 0 };
+
+	void Reset()
+	{
+		contended = 0;
+		wait_ns = 0;
+	}
+
+	// XCodec XAvFormatװװ mtx_ʵ
+	static XLockStats& Codec();
+	static XLockStats& Format();
+};
+
+/**
+ * @brief Ļ std::lock_guard / std::unique_lock
+ *
+ * ʱֻһ try_lockдΪõ㣩
+ */
+class XCountedMutex
+{
+public:
+	explicit XCountedMutex(XLockStats& stats) : stats_(stats) {}
+	XCountedMutex(const XCountedMutex&) = delete;
+	XCountedMutex& operator=(const XCountedMutex&) = delete;
+
+	void lock();
+	bool try_lock() { return mtx_.try_lock(); }
+	void unlock() { mtx_.unlock(); }
+
+private:
+	std::mutex mtx_;
+	XLockStats& stats_;
+};
@@ -0,0 +1,354 @@
+// xlog.cpp
+#include "xlog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/log.h>
+#include <libavutil/error.h>
+}
+
+#pragma comment(lib, "avutil.lib")
+
+namespace {
+
+const int kRingSize = 256;			// ÿ̻߳Ϣ
+const int kTextSize = 232;
+const int kLimitBuckets = 32;		// Сõϣ
+const int kLimitPerSecond = 5;
+
+struct XLogEntry
+{
+	XLogLevel level;
+	int64_t time_us;
+	int thread_id;
+	char text[kTextSize];
+};
+
+struct XLogLimit
+{
+	const void* site{ nullptr };
+	int64_t second{ -1 };
+	int count{ 0 };
+	int suppressed{ 0 };
+};
+
+int64_t NowMicroseconds()
+{
+	static const auto start = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+const char* LevelName(XLogLevel level)
+{
+	switch (level)
+	{
+	case XLogLevel::Debug: return "D";
+	case XLogLevel::Info: return "I";
+	case XLogLevel::Warning: return "W";
+	default: return "E";
+	}
+}
+
+}
+
+// ߣ̣߳/ ߣ̨̣߳λ
+struct XLogRing
+{
+	XLogEntry entries[kRingSize];
+	std::atomic<uint32_t> head{ 0 };	// һдλãֻ޸
+	std::atomic<uint32_t> tail{ 0 };	// һȡλãֻ޸
+	std::atomic<int64_t> dropped{ 0 };
+	std::atomic<bool> in_use{ false };
+	int thread_id{ 0 };
+	XLogLimit limits[kLimitBuckets];	// ֻ߷
+	int text_offset{ 0 };				// Begin() дǰ׺
+
+	//  false ʾڸõõѳ޶
+	bool Allow(const void* site, int64_t now_us, int* suppressed)
+	{
+		XLogLimit& limit = limits[((uintptr_t)site >> 4) % kLimitBuckets];
+		int64_t second = now_us / 1000000;
+		*suppressed = 0;
+		if (limit.site != site || limit.second != second)
+		{
+			*suppressed = (limit.site == site) ? limit.suppressed : 0;
+			limit.site = site;
+			limit.second = second;
+			limit.count = 0;
+			limit.suppressed = 0;
+		}
+		if (limit.count >= kLimitPerSecond)
+		{
+			limit.suppressed++;
+			return false;
+		}
+		limit.count++;
+		return true;
+	}
+
+	// ʱ nullptr
+	XLogEntry* Reserve()
+	{
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= (uint32_t)kRingSize)
+		{
+			dropped++;
+			return nullptr;
+		}
+		return &entries[h % kRingSize];
+	}
+
+	void Commit()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool Pop(XLogEntry& entry)
+	{
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) return false;
+		entry = entries[t % kRingSize];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+// ߳˳ʱͷŻ壬֮߳ʹ
+struct XLogThreadSlot
+{
+	XLogRing* ring{ nullptr };
+	~XLogThreadSlot()
+	{
+		if (ring) ring->in_use = false;
+	}
+};
+
+XLog& XLog::Instance()
+{
+	static XLog log;
+	return log;
+}
+
+XLog::XLog()
+{
+	flusher_ = std::thread(&XLog::FlushLoop, this);
+}
+
+XLog::~XLog()
+{
+	running_ = false;
+	if (flusher_.joinable()) flusher_.join();
+	Drain();
+}
+
+void XLog::SetOutput(std::ostream* os)
+{
+	std::lock_guard<std::mutex> lock(drain_mtx_);
+	output_ = os ? os : &std::cerr;
+}
+
+XLogRing* XLog::ThreadRing()
+{
+	thread_local XLogThreadSlot slot;
+	if (slot.ring) return slot.ring;
+
+	std::lock_guard<std::mutex> lock(rings_mtx_);
+	static std::atomic<int> next_thread_id{ 0 };
+	for (auto& ring : rings_)
+	{
+		bool expected = false;
+		if (ring->in_use.compare_exchange_strong(expected, true))
+		{
+			slot.ring = ring.get();
+			break;
+		}
+	}
+	if (!slot.ring)
+	{
+		rings_.push_back(std::make_unique<XLogRing>());
+		slot.ring = rings_.back().get();
+		slot.ring->in_use = true;
+	}
+	slot.ring->thread_id = next_thread_id++;
+	// õĻ岻̳һ̵߳״̬
+	for (auto& limit : slot.ring->limits) limit = XLogLimit();
+	return slot.ring;
+}
+
+XLogRing* XLog::Begin(XLogLevel level, const char* site, const void* limit_key)
+{
+	if ((int)level < level_) return nullptr;
+	XLogRing* ring = ThreadRing();
+	int64_t now = NowMicroseconds();
+
+	int suppressed = 0;
+	bool allow = !limit_key || ring->Allow(limit_key, now, &suppressed);
+	if (suppressed > 0)
+	{
+		XLogEntry* entry = ring->Reserve();
+		if (entry)
+		{
+			entry->level = level;
+			entry->time_us = now;
+			entry->thread_id = ring->thread_id;
+			snprintf(entry->text, kTextSize, "%s: %d similar messages suppressed", site, suppressed);
+			ring->Commit();
+		}
+	}
+	if (!allow) return nullptr;
+
+	XLogEntry* entry = ring->Reserve();
+	if (!entry) return nullptr;
+	entry->level = level;
+	entry->time_us = now;
+	entry->thread_id = ring->thread_id;
+	int len = snprintf(entry->text, kTextSize, "%s: ", site);
+	ring->text_offset = (len < 0 || len >= kTextSize) ? 0 : len;
+	return ring;
+}
+
+void XLog::WriteV(XLogLevel level, const char* site, const char* fmt, va_list args)
+{
+	XLogRing* ring = Begin(level, site, site);
+	if (!ring) return;
+	XLogEntry* entry = ring->Reserve();
+	vsnprintf(entry->text + ring->text_offset, kTextSize - ring->text_offset, fmt, args);
+	ring->Commit();
+}
+
+void XLog::Write(XLogLevel level, const char* site, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	WriteV(level, site, fmt, args);
+	va_end(args);
+}
+
+void XLog::WriteAvError(XLogLevel level, const char* site, const char* what, int errnum)
+{
+	XLogRing* ring = Begin(level, site, site);
+	if (!ring) return;
+	XLogEntry* entry = ring->Reserve();
+	char* text = entry->text + ring->text_offset;
+	int size = kTextSize - ring->text_offset;
+	int len = snprintf(text, size, "%s: ", what);
+	if (len < 0 || len >= size) len = 0;
+	av_strerror(errnum, text + len, size - len);
+	ring->Commit();
+}
+
+void XLog::WriteText(XLogLevel level, const char* site, const void* limit_key, const char* text)
+{
+	XLogRing* ring = Begin(level, site, limit_key);
+	if (!ring) return;
+	XLogEntry* entry = ring->Reserve();
+	snprintf(entry->text + ring->text_offset, kTextSize - ring->text_offset, "%s", text);
+	ring->Commit();
+}
+
+int64_t XLog::dropped() const
+{
+	int64_t total = 0;
+	std::lock_guard<std::mutex> lock(rings_mtx_);
+	for (const auto& ring : rings_) total += ring->dropped;
+	return total;
+}
+
+void XLog::FlushLoop()
+{
+	while (running_)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		Drain();
+	}
+}
+
+int XLog::Drain()
+{
+	std::lock_guard<std::mutex> drain_lock(drain_mtx_);
+	std::vector<XLogEntry> batch;
+	{
+		std::lock_guard<std::mutex> lock(rings_mtx_);
+		XLogEntry entry;
+		for (auto& ring : rings_)
+		{
+			while (ring->Pop(entry)) batch.push_back(entry);
+		}
+	}
+	if (batch.empty()) return 0;
+
+	std::stable_sort(batch.begin(), batch.end(), [](const XLogEntry& a, const XLogEntry& b) {
+		return a.time_us < b.time_us;
+	});
+	for (const auto& entry : batch)
+	{
+		char prefix[64];
+		snprintf(prefix, sizeof(prefix), "[%s %.6f t%d] ", LevelName(entry.level),
+			entry.time_us / 1e6, entry.thread_id);
+		*output_ << prefix << entry.text << "\n";
+	}
+	output_->flush();
+	return (int)batch.size();
+}
+
+void XLog::Flush()
+{
+	Drain();
+}
+
+// av_log ص FFmpeg ӳ䡣һпɶ av_log ƴɣ av_dump_format
+// ߳ƴӵһʹԸеһεĸʽΪϢ
+static void FFmpegLogCallback(void* avcl, int level, const char* fmt, va_list args)
+{
+	XLogLevel xlevel;
+	if (level <= AV_LOG_ERROR) xlevel = XLogLevel::Error;
+	else if (level <= AV_LOG_WARNING) xlevel = XLogLevel::Warning;
+	else if (level <= AV_LOG_INFO) xlevel = XLogLevel::Info;
+	else if (level <= AV_LOG_DEBUG) xlevel = XLogLevel::Debug;
+	else return;	// AV_LOG_TRACE
+	XLog& log = XLog::Instance();
+	if ((int)xlevel < (int)log.level()) return;
+
+	// ߳δУprint_prefix  av_log_format_line2 άײż "[h264 @ 0x...]" ǰ׺
+	thread_local char pending[kTextSize];
+	thread_local size_t pending_len = 0;
+	thread_local int print_prefix = 1;
+	thread_local const char* pending_fmt = nullptr;
+	thread_local XLogLevel pending_level = XLogLevel::Debug;
+
+	if (pending_len == 0)
+	{
+		pending_fmt = fmt;
+		pending_level = xlevel;
+	}
+	else if ((int)xlevel > (int)pending_level)
+	{
+		pending_level = xlevel;
+	}
+	av_log_format_line2(avcl, level, fmt, args, pending + pending_len, sizeof(pending) - pending_len, &print_prefix);
+	pending_len += strlen(pending + pending_len);
+	// ʱһĽضϣ
+	bool line_end = print_prefix != 0 || pending_len + 1 >= sizeof(pending);
+	if (!line_end) return;
+
+	while (pending_len > 0 && (pending[pending_len - 1] == '\n' || pending[pending_len - 1] == '\r')) pending[--pending_len] = '\0';
+	if (pending_len > 0)
+	{
+		const void* limit_key = (int)pending_level >= (int)XLogLevel::Warning ? pending_fmt : nullptr;
+		log.WriteText(pending_level, "ffmpeg", limit_key, pending);
+	}
+	pending_len = 0;
+	pending[0] = '\0';
+}
+
+void XLog::RouteFFmpegLog()
+{
+	static std::once_flag once;
+	std::call_once(once, []() {
+		av_log_set_callback(FFmpegLogCallback);
+	});
+}
@@ -0,0 +1,88 @@
+// xlog.h
+#pragma once
+#include <cstdint>
+#include <cstdarg>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+
+struct XLogRing;
+
+enum class XLogLevel
+{
+	Debug,
+	Info,
+	Warning,
+	Error
+};
+
+/**
+ * @brief 첽־ֻ߳ѸʽϢд뱾̵߳Ļλ壬̨߳ͳһ
+ *
+ * - ÿ߳һ/߻λ壬дڴ棬ʱ
+ * - ͬһõÿ 5 һһʡ N 
+ * - ̨߳ÿ 20ms ȡлеϢʱд
+ * - RouteFFmpegLog()  FFmpeg ڲ av_log Ҳ뱾־ֶε av_log ƴӵΪֹ
+ *   ʹ󰴸ʽϢav_dump_formatͳƣ
+ *
+ * װڼڱʱʹñ־ֱд std::cerr
+ */
+class XLog
+{
+public:
+	static XLog& Instance();
+	~XLog();
+
+	// ڸüϢֱӶĬ Info
+	void SetLevel(XLogLevel level) { level_ = (int)level; }
+	XLogLevel level() const { return (XLogLevel)level_.load(); }
+	// Ĭ std::cerrڳ˳ǰЧ
+	void SetOutput(std::ostream* os);
+
+	// site Ϊõʶַ
+	void Write(XLogLevel level, const char* site, const char* fmt, ...);
+	void WriteV(XLogLevel level, const char* site, const char* fmt, va_list args);
+	// FFmpeg 룬ֻϢᱻʱŵ av_strerror
+	void WriteAvError(XLogLevel level, const char* site, const char* what, int errnum);
+	// Ѹʽģlimit_key Ϊ av_log ĸʽnullptr ʱ
+	void WriteText(XLogLevel level, const char* site, const void* limit_key, const char* text);
+
+	// ȴдϢȫ
+	void Flush();
+
+	// ӹ av_log ظã
+	static void RouteFFmpegLog();
+
+	// 򻺳Ϣ
+	int64_t dropped() const;
+
+private:
+	XLog();
+	// ǰ̵߳Ļλ壨״εʱǼǣ߳˳̸߳ã
+	XLogRing* ThreadRing();
+	//  limit_keynullptr ռ䶼ͨʱر̻߳壬
+	// Ԥһдõõǰ׺÷дĺ Commit()򷵻 nullptr
+	XLogRing* Begin(XLogLevel level, const char* site, const void* limit_key);
+	void FlushLoop();
+	// ȡлеϢ
+	int Drain();
+
+private:
+	std::atomic<int> level_{ (int)XLogLevel::Info };
+	std::ostream* output_{ &std::cerr };
+
+	mutable std::mutex rings_mtx_;		// ֻڵǼ̺߳ʱʹãд־
+	std::vector<std::unique_ptr<XLogRing>> rings_;
+
+	std::mutex drain_mtx_;
+	std::thread flusher_;
+	std::atomic<bool> running_{ true };
+};
+
+#define XLOG_DEBUG(site, ...) XLog::Instance().Write(XLogLevel::Debug, site, __VA_ARGS__)
+#define XLOG_INFO(site, ...) XLog::Instance().Write(XLogLevel::Info, site, __VA_ARGS__)
+#define XLOG_WARNING(site, ...) XLog::Instance().Write(XLogLevel::Warning, site, __VA_ARGS__)
+#define XLOG_ERROR(site, ...) XLog::Instance().Write(XLogLevel::Error, site, __VA_ARGS__)
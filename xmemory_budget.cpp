@@ -0,0 +1,51 @@
+// xmemory_budget.cpp
+#include "xmemory_budget.h"
+#include <chrono>
+#include <thread>
+
+void XMemoryCounter::Add(int64_t bytes)
+{
+	if (bytes == 0) return;
+	int64_t value = current_.fetch_add(bytes) + bytes;
+	int64_t peak = peak_.load();
+	while (value > peak && !peak_.compare_exchange_weak(peak, value))
+	{
+	}
+	if (parent_) parent_->Add(bytes);
+}
+
+void XMemoryCounter::Set(int64_t bytes)
+{
+	int64_t old_value = current_.exchange(bytes);
+	int64_t peak = peak_.load();
+	while (bytes > peak && !peak_.compare_exchange_weak(peak, bytes))
+	{
+	}
+	if (parent_ && bytes != old_value) parent_->Add(bytes - old_value);
+}
+
+XMemoryBudget& XMemoryBudget::Instance()
+{
+	static XMemoryBudget budget;
+	return budget;
+}
+
+bool XMemoryBudget::Exceeded() const
+{
+	int64_t limit = limit_;
+	return limit > 0 && counter_.current() > limit;
+}
+
+int64_t XMemoryBudget::WaitForRoom(int64_t own_bytes, int max_wait_ms, const std::atomic<bool>* cancel)
+{
+	auto start = std::chrono::steady_clock::now();
+	int64_t waited_ms = 0;
+	while (Exceeded() && counter_.current() > own_bytes && waited_ms < max_wait_ms)
+	{
+		if (cancel && cancel->load(std::memory_order_relaxed)) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		waited_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count();
+	}
+	return waited_ms;
+}
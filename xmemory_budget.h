@@ -0,0 +1,60 @@
+// xmemory_budget.h
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief ڴǰֵֽͬʱϼ
+ *
+ * 㼶/װ -> תĽ׶ -> ת -> Ԥ㣬
+ * ÿһ㶼Եȡǰֵͷֵϼڱ֮ǰá
+ */
+class XMemoryCounter
+{
+public:
+	void SetParent(XMemoryCounter* parent) { parent_ = parent; }
+
+	void Add(int64_t bytes);
+	void Sub(int64_t bytes) { Add(-bytes); }
+	// Ϊ bytesֵϼ
+	void Set(int64_t bytes);
+
+	int64_t current() const { return current_; }
+	int64_t peak() const { return peak_; }
+	void ResetPeak() { peak_ = current_.load(); }
+
+private:
+	std::atomic<int64_t> current_{ 0 };
+	std::atomic<int64_t> peak_{ 0 };
+	XMemoryCounter* parent_{ nullptr };
+};
+
+/**
+ * @brief ڴԤ㣺ת񻺴֡Ͱһ
+ *
+ * Ԥʱеͣȡ루װ
+ * ܾΪ 0 ʾƣֻͳơ
+ */
+class XMemoryBudget
+{
+public:
+	static XMemoryBudget& Instance();
+
+	void SetLimit(int64_t bytes) { limit_ = bytes > 0 ? bytes : 0; }
+	int64_t limit() const { return limit_; }
+
+	// ļϼ
+	XMemoryCounter& counter() { return counter_; }
+	bool Exceeded() const;
+
+	// ԤҲռڴʱȴ䣬 max_wait_ms 룬ʵʵȴĺ
+	// own_bytes ΪԼֻбռʱȴнֱӷ
+	// cancel ǿұλʱ
+	int64_t WaitForRoom(int64_t own_bytes, int max_wait_ms, const std::atomic<bool>* cancel = nullptr);
+
+private:
+	XMemoryBudget() = default;
+
+	std::atomic<int64_t> limit_{ 0 };
+	XMemoryCounter counter_;
+};
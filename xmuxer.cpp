@@ -1,16 +1,188 @@
 #include <iostream>
+#include <cstdio>
+#include <cstring>
 #include "xmuxer.h"
+#include "xlog.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/buffer.h>
+#include <libavutil/opt.h>
+}
+
+// moov 㣺ÿռõֽڣstsz 4 + stts 8 + stsc 12 + co64 8Ƶ ctts 8stss 4
+static const int64_t kMoovVideoSampleBytes = 44;
+static const int64_t kMoovAudioSampleBytes = 32;
+// mvhdudta ÿ trak Ĺ̶֣ extradata
+static const int64_t kMoovBaseBytes = 4096;
+static const int64_t kMoovTrackBytes = 2048;
+
+bool XMuxer::SetSegmentMode(SegmentMode mode, int segment_seconds)
+{
+	std::lock_guard<XCountedMutex> lock(mtx_);
+	if (fmt_ctx_)
+	{
+		std::cerr << "Error: segment mode should be set before Open()!" << std::endl;
+		return false;
+	}
+	if (mode != SegmentMode::None && segment_seconds <= 0) return false;
+	segment_mode_ = mode;
+	segment_seconds_ = segment_seconds;
+	return true;
+}
+
+bool XMuxer::SetFormatOpt(const std::string& key, const std::string& value)
+{
+	std::lock_guard<XCountedMutex> lock(mtx_);
+	return av_dict_set(&opts_, key.c_str(), value.c_str(), 0) >= 0;
+}
+
+bool XMuxer::SetFastStart(bool enable, double expected_seconds)
+{
+	std::lock_guard<XCountedMutex> lock(mtx_);
+	if (fmt_ctx_)
+	{
+		std::cerr << "Error: fast start should be set before Open()!" << std::endl;
+		return false;
+	}
+	fast_start_ = enable;
+	expected_seconds_ = expected_seconds;
+	return true;
+}
+
+void XMuxer::SetupSegmentOpts(const std::string& file)
+{
+	if (segment_mode_ == SegmentMode::FragmentedMP4)
+	{
+		// frag_keyframeÿؼ֡ʼһ·Ƭڷֶα߽ǿƹؼ֡
+		// empty_moovļͷֻд moovд꼴ɲţʱд
+		av_dict_set(&opts_, "movflags", "frag_keyframe+empty_moov+default_base_moof", AV_DICT_DONT_OVERWRITE);
+	}
+	else if (segment_mode_ == SegmentMode::HLS)
+	{
+		// ֶļ벥бͬĿ¼<>_init.mp4<>_00000.m4s ...
+		std::string base = file;
+		size_t slash = base.find_last_of("/\\");
+		size_t dot = base.find_last_of('.');
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		{
+			base = base.substr(0, dot);
+		}
+		std::string name = (slash == std::string::npos) ? base : base.substr(slash + 1);
+
+		av_dict_set(&opts_, "hls_segment_type", "fmp4", AV_DICT_DONT_OVERWRITE);
+		av_dict_set(&opts_, "hls_time", std::to_string(segment_seconds_).c_str(), AV_DICT_DONT_OVERWRITE);
+		// event  + бȣÿдһξ׷ӵ m3u8ɵĶʼձ
+		av_dict_set(&opts_, "hls_playlist_type", "event", AV_DICT_DONT_OVERWRITE);
+		av_dict_set(&opts_, "hls_list_size", "0", AV_DICT_DONT_OVERWRITE);
+		av_dict_set(&opts_, "hls_flags", "independent_segments", AV_DICT_DONT_OVERWRITE);
+		av_dict_set(&opts_, "hls_segment_filename", (base + "_%05d.m4s").c_str(), AV_DICT_DONT_OVERWRITE);
+		// init ļڲбĿ¼
+		av_dict_set(&opts_, "hls_fmp4_init_filename", (name + "_init.mp4").c_str(), AV_DICT_DONT_OVERWRITE);
+	}
+}
+
+int64_t XMuxer::MoovBound(const std::vector<int64_t>& samples) const
+{
+	int64_t bytes = kMoovBaseBytes;
+	AVDictionaryEntry* entry = nullptr;
+	while ((entry = av_dict_get(fmt_ctx_->metadata, "", entry, AV_DICT_IGNORE_SUFFIX)))
+	{
+		bytes += 16 + strlen(entry->key) + strlen(entry->value);
+	}
+	for (unsigned int i = 0; i < fmt_ctx_->nb_streams && i < samples.size(); i++)
+	{
+		const AVCodecParameters* par = fmt_ctx_->streams[i]->codecpar;
+		int64_t per_sample = (par->codec_type == AVMEDIA_TYPE_VIDEO) ? kMoovVideoSampleBytes : kMoovAudioSampleBytes;
+		bytes += kMoovTrackBytes + par->extradata_size + samples[i] * per_sample;
+	}
+	return bytes;
+}
+
+void XMuxer::SetupFastStartOpts()
+{
+	moov_reserved_ = 0;
+	fast_start_shifted_ = false;
+	samples_.clear();
+	if (!fast_start_ || segment_mode_ != SegmentMode::None) return;
+
+	const char* name = fmt_ctx_->oformat->name;
+	if (strcmp(name, "mp4") != 0 && strcmp(name, "mov") != 0 && strcmp(name, "ipod") != 0 &&
+		strcmp(name, "3gp") != 0 && strcmp(name, "3g2") != 0)
+	{
+		std::cerr << "Warning: fast start is only supported for MP4/MOV output, ignored" << std::endl;
+		return;
+	}
+
+	// Ԥʱ 1 룩Ƶ֡ʣƵÿ֡
+	std::vector<int64_t> expected(fmt_ctx_->nb_streams, 0);
+	for (unsigned int i = 0; i < fmt_ctx_->nb_streams && expected_seconds_ > 0; i++)
+	{
+		const AVStream* st = fmt_ctx_->streams[i];
+		double rate = 0;
+		if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+		{
+			rate = (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0) ? av_q2d(st->avg_frame_rate) : 60;
+		}
+		else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+		{
+			int frame_size = st->codecpar->frame_size > 0 ? st->codecpar->frame_size : 1024;
+			rate = st->codecpar->sample_rate / (double)frame_size;
+		}
+		expected[i] = (int64_t)((expected_seconds_ + 1) * rate) + 1;
+	}
+	int64_t reserve = MoovBound(expected);
+	reserve += reserve / 20;
+
+	if (expected_seconds_ > 0 && reserve < INT32_MAX)
+	{
+		// װ ftyp ֮ moov_size ֽڣʱ moov дʣಿдΪ free 
+		moov_reserved_ = reserve;
+		samples_.assign(fmt_ctx_->nb_streams, 0);
+		av_dict_set(&opts_, "moov_size", std::to_string(reserve).c_str(), AV_DICT_DONT_OVERWRITE);
+		return;
+	}
+
+	// ʱδ֪ʱ
+	AVDictionaryEntry* entry = av_dict_get(opts_, "movflags", nullptr, 0);
+	std::string flags = entry ? std::string(entry->value) + "+faststart" : "+faststart";
+	av_dict_set(&opts_, "movflags", flags.c_str(), 0);
+}
+
+bool XMuxer::MarkReservedSpace()
+{
+	//  ftyp СȷǷװĿհ
+	AVIOContext* pb = fmt_ctx_->pb;
+	avio_flush(pb);
+	int64_t end = avio_tell(pb);
+	FILE* file = fopen(fmt_ctx_->url, "rb");
+	if (!file) return false;
+	uint8_t head[8]{ 0 };
+	uint8_t gap[8]{ 0 };
+	bool ok = fread(head, 1, 8, file) == 8 && memcmp(head + 4, "ftyp", 4) == 0;
+	int64_t ftyp_size = ((int64_t)head[0] << 24) | (head[1] << 16) | (head[2] << 8) | head[3];
+	ok = ok && ftyp_size >= 8 && fseek(file, (long)ftyp_size, SEEK_SET) == 0 && fread(gap, 1, 8, file) == 8;
+	fclose(file);
+	static const uint8_t zero[8]{ 0 };
+	if (!ok || memcmp(gap, zero, 8) != 0 || ftyp_size + moov_reserved_ > end) return false;
+
+	// ԤдΪ free У˻ʱݺƵ moov ֮ļȻϷ
+	avio_seek(pb, ftyp_size, SEEK_SET);
+	avio_wb32(pb, (unsigned int)moov_reserved_);
+	avio_write(pb, (const unsigned char*)"free", 4);
+	avio_seek(pb, end, SEEK_SET);
+	avio_flush(pb);
+	return true;
 }
 
 bool XMuxer::Open(std::string file, AVCodecContext* video_enc_ctx, AVCodecContext* audio_enc_ctx)
 {
 	if (!video_enc_ctx && !audio_enc_ctx) return false;
-    // ʽ
-    if (avformat_alloc_output_context2(&fmt_ctx_, nullptr, nullptr, file.c_str()) < 0) {
+    // ʽģHLS ļΪ m3u8 бʽָʽ
+	const char* format_name = (segment_mode_ == SegmentMode::HLS) ? "hls" : nullptr;
+    if (avformat_alloc_output_context2(&fmt_ctx_, nullptr, format_name, file.c_str()) < 0) {
         std::cerr << "Error: Failed to allocate output context" << std::endl;
         return false;
     }
@@ -37,6 +209,12 @@ bool XMuxer::Open(std::string file, AVCodecContext* video_enc_ctx, AVCodecContex
 		out_audio_stream->time_base = { 1, audio_enc_ctx->sample_rate };
 	}
 
+	SetupSegmentOpts(file);
+	SetupFastStartOpts();
+
+	// HLS ȷװд򿪷ֶļͲбҪ avio_open
+	if (fmt_ctx_->oformat->flags & AVFMT_NOFILE) return true;
+
 	int ret = avio_open(&fmt_ctx_->pb, file.c_str(), AVIO_FLAG_WRITE);
 	if (ret < 0)
 	{
@@ -53,7 +231,7 @@ bool XMuxer::Open(std::string file, AVCodecContext* video_enc_ctx, AVCodecContex
 // stream_index Ƶenc_ctxƵ
 bool XMuxer::CopyPara(int stream_index, AVCodecContext* enc_ctx)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (stream_index < 0 || enc_ctx == nullptr) return false;
 	AVStream* stream = fmt_ctx_->streams[stream_index];
 	if (avcodec_parameters_from_context(stream->codecpar, enc_ctx) < 0)
@@ -67,27 +245,72 @@ bool XMuxer::CopyPara(int stream_index, AVCodecContext* enc_ctx)
 
 bool XMuxer::WriteHeader()
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!fmt_ctx_) return false;
-	if (avformat_write_header(fmt_ctx_, nullptr) < 0)
+	if (avformat_write_header(fmt_ctx_, &opts_) < 0)
 	{
 		std::cerr << "Error: Failed to write header" << std::endl;
 		return false;
 	}
+
+	// װδʶѡֵ
+	AVDictionaryEntry* entry = nullptr;
+	while ((entry = av_dict_get(opts_, "", entry, AV_DICT_IGNORE_SUFFIX)))
+	{
+		std::cerr << "Warning: unused format option '" << entry->key << "'" << std::endl;
+	}
+	av_dict_free(&opts_);
+
+	if (moov_reserved_ > 0 && !MarkReservedSpace())
+	{
+		std::cerr << "Warning: cannot mark reserved moov space, fast start fallback may produce an invalid file" << std::endl;
+	}
     return true;
 }
 
+// ڽеļðװ滻 pkt->bufװͷŸðʱ۳
+struct XTrackedPacket
+{
+	AVBufferRef* buf;
+	XMemoryCounter* counter;
+	int64_t bytes;
+};
+
+static void ReleaseTrackedPacket(void* opaque, uint8_t* /*data*/)
+{
+	XTrackedPacket* tracked = (XTrackedPacket*)opaque;
+	tracked->counter->Sub(tracked->bytes);
+	av_buffer_unref(&tracked->buf);
+	delete tracked;
+}
+
 bool XMuxer::Write(AVPacket* pkt)
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!fmt_ctx_) return false;
+	if (pkt->stream_index >= 0 && pkt->stream_index < (int)samples_.size()) samples_[pkt->stream_index]++;
+	if (pkt->buf)
+	{
+		// ԭã¡İʱװֻ
+		// װΪԾ͵޸ģĵ𴦹
+		int flags = av_buffer_is_writable(pkt->buf) ? 0 : AV_BUFFER_FLAG_READONLY;
+		XTrackedPacket* tracked = new XTrackedPacket{ pkt->buf, &memory_, (int64_t)pkt->buf->size };
+		AVBufferRef* wrapped = av_buffer_create(pkt->buf->data, pkt->buf->size,
+			ReleaseTrackedPacket, tracked, flags);
+		if (wrapped)
+		{
+			pkt->buf = wrapped;
+			memory_.Add(tracked->bytes);
+		}
+		else
+		{
+			delete tracked;
+		}
+	}
 	int ret = av_interleaved_write_frame(fmt_ctx_, pkt);
 	if (ret < 0)
 	{
-		char buff[1024]{ 0 };
-		av_strerror(ret, buff, sizeof(buff));
-		std::cerr << "Error: Failed to write" << std::endl;
-		std::cerr << buff << std::endl;
+		XLog::Instance().WriteAvError(XLogLevel::Error, "XMuxer::Write", "av_interleaved_write_frame failed", ret);
 		return false;
 	}
 	return true;
@@ -95,8 +318,16 @@ bool XMuxer::Write(AVPacket* pkt)
 
 bool XMuxer::WriteTrailer()
 {
-	std::lock_guard<std::mutex> lock(mtx_);
+	std::lock_guard<XCountedMutex> lock(mtx_);
 	if (!fmt_ctx_) return false;
+	if (moov_reserved_ > 0 && MoovBound(samples_) + 8 > moov_reserved_)
+	{
+		// 㣺Ϊװ faststartԤƺ moov дļͷ
+		std::cerr << "Warning: reserved moov space may be too small, moving data to place moov at the front" << std::endl;
+		av_opt_set(fmt_ctx_->priv_data, "moov_size", "0", 0);
+		av_opt_set(fmt_ctx_->priv_data, "movflags", "+faststart", 0);
+		fast_start_shifted_ = true;
+	}
 	if (av_write_trailer(fmt_ctx_) < 0)
 	{
 		std::cerr << "Error: Failed to write trailer" << std::endl;
@@ -112,5 +343,7 @@ bool XMuxer::Close()
 	// avformat_free_context() avio_close()
 	avformat_free_context(fmt_ctx_);
 	fmt_ctx_ = nullptr;
+	av_dict_free(&opts_);
+	samples_.clear();
 	return true;
 }
@@ -1,15 +1,44 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
 #include "xavformat.h"
+#include "xmemory_budget.h"
 
 struct AVPacket;
 struct AVCodecContext;
+struct AVDictionary;
 
 class XMuxer :
     public XAvFormat
 {
 public:
+    // ʽ
+    enum class SegmentMode {
+        None,           // ͨļmoov ļβ
+        FragmentedMP4,  // Ƭ MP4moof+mdatÿ GOP һƬ߱߿ɶ
+        HLS             // HLS/CMAFfMP4 ֶ + m3u8 бÿдһμб
+    };
+
+public:
+    // ֶβ Open() ǰã
+    // segment_seconds Ϊֶ/Ƭʱ谴ʱǿƹؼ֡
+    bool SetSegmentMode(SegmentMode mode, int segment_seconds = 4);
+    SegmentMode segment_mode() { return segment_mode_; }
+    int segment_seconds() { return segment_seconds_; }
+
+    // װ˽ѡ movflagshls_timeWriteHeader() ʱЧ
+    bool SetFormatOpt(const std::string& key, const std::string& value);
+
+    // MP4/MOV  moov ļͷ Open() ǰãֶʱԣ
+    // ԤʱļͷԤ moov ռ䣬ʱ moov ֱдԤдһļ
+    // ʵʱ˻طװ faststartƣexpected_seconds <= 0 ʱֱʹ faststart
+    bool SetFastStart(bool enable, double expected_seconds = 0);
+    // Ԥ moov ֽ0 ΪδԤ
+    int64_t fast_start_reserved() { return moov_reserved_; }
+    // WriteTrailer() ʱԤ㣬˻
+    bool fast_start_shifted() { return fast_start_shifted_; }
+
     bool Open(std::string file, AVCodecContext* video_enc_ctx, AVCodecContext* audio_enc_ctx);
     //  в -> װв
     //  -> 
@@ -18,5 +47,29 @@ public:
     bool Write(AVPacket* pkt);
     bool WriteTrailer();
     bool Close();
-};
 
+    // װеȴдİWrite() ʵдļǰ
+    XMemoryCounter& memory() { return memory_; }
+
+private:
+    // ݷֶηʽĬϵķװѡûõĲǣ
+    void SetupSegmentOpts(const std::string& file);
+    // ùԤС faststart
+    void SetupFastStartOpts();
+    // Ԥд free ͷװֻ
+    bool MarkReservedSpace();
+    //  moov Сޣÿϲƣ
+    int64_t MoovBound(const std::vector<int64_t>& samples) const;
+
+private:
+    SegmentMode segment_mode_{ SegmentMode::None };
+    int segment_seconds_{ 4 };
+    AVDictionary* opts_{ nullptr };
+    XMemoryCounter memory_;
+
+    bool fast_start_{ false };
+    double expected_seconds_{ 0 };
+    int64_t moov_reserved_{ 0 };
+    bool fast_start_shifted_{ false };
+    std::vector<int64_t> samples_;      // Ԥʱдİ
+};
@@ -0,0 +1,144 @@
+// xnuma.cpp
+#include "xnuma.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+//  Linux cpulist ʽ "0-15,32-47"
+static std::vector<int> ParseCpuList(const std::string& text)
+{
+	std::vector<int> cpus;
+	size_t pos = 0;
+	while (pos < text.size())
+	{
+		size_t end = text.find(',', pos);
+		if (end == std::string::npos) end = text.size();
+		std::string item = text.substr(pos, end - pos);
+		size_t dash = item.find('-');
+		int first = atoi(item.c_str());
+		int last = (dash == std::string::npos) ? first : atoi(item.c_str() + dash + 1);
+		for (int cpu = first; cpu <= last && !item.empty(); cpu++) cpus.push_back(cpu);
+		pos = end + 1;
+	}
+	return cpus;
+}
+
+XNuma& XNuma::Instance()
+{
+	static XNuma numa;
+	return numa;
+}
+
+XNuma::XNuma()
+{
+#ifdef _WIN32
+	ULONG highest = 0;
+	if (GetNumaHighestNodeNumber(&highest))
+	{
+		for (ULONG node = 0; node <= highest; node++)
+		{
+			GROUP_AFFINITY affinity{};
+			if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity)) continue;
+			std::vector<int> cpus;
+			for (int bit = 0; bit < 64; bit++)
+			{
+				if (affinity.Mask & ((KAFFINITY)1 << bit)) cpus.push_back(affinity.Group * 64 + bit);
+			}
+			if (!cpus.empty()) node_cpus_.push_back(cpus);
+		}
+	}
+#elif defined(__linux__)
+	for (int node = 0; ; node++)
+	{
+		std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		if (!ifs) break;
+		std::string text;
+		std::getline(ifs, text);
+		std::vector<int> cpus = ParseCpuList(text);
+		// ֻڴû CPU Ľڵ㣨 CXL ڴ棩
+		if (!cpus.empty()) node_cpus_.push_back(cpus);
+	}
+#endif
+	node_jobs_.resize(node_cpus_.size(), 0);
+}
+
+int XNuma::AcquireNode()
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	if (node_jobs_.empty()) return -1;
+	int best = 0;
+	for (int node = 1; node < (int)node_jobs_.size(); node++)
+	{
+		if (node_jobs_[node] < node_jobs_[best]) best = node;
+	}
+	node_jobs_[best]++;
+	return best;
+}
+
+void XNuma::ReleaseNode(int node)
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	if (node < 0 || node >= (int)node_jobs_.size()) return;
+	if (node_jobs_[node] > 0) node_jobs_[node]--;
+}
+
+bool XNumaBinding::Bind(int node)
+{
+	Unbind();
+	XNuma& numa = XNuma::Instance();
+	if (node < 0 || node >= numa.node_count()) return false;
+	const std::vector<int>& cpus = numa.NodeCpus(node);
+
+#ifdef _WIN32
+	GROUP_AFFINITY affinity{};
+	GROUP_AFFINITY previous{};
+	affinity.Group = (WORD)(cpus[0] / 64);
+	for (int cpu : cpus)
+	{
+		if (cpu / 64 == affinity.Group) affinity.Mask |= (KAFFINITY)1 << (cpu % 64);
+	}
+	if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, &previous)) return false;
+	saved_.assign((unsigned char*)&previous, (unsigned char*)&previous + sizeof(previous));
+#elif defined(__linux__)
+	cpu_set_t previous;
+	CPU_ZERO(&previous);
+	if (pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) != 0) return false;
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	for (int cpu : cpus)
+	{
+		if (cpu < CPU_SETSIZE) CPU_SET(cpu, &mask);
+	}
+	if (pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0) return false;
+	saved_.assign((unsigned char*)&previous, (unsigned char*)&previous + sizeof(previous));
+#else
+	return false;
+#endif
+	node_ = node;
+	return true;
+}
+
+void XNumaBinding::Unbind()
+{
+	if (node_ < 0) return;
+#ifdef _WIN32
+	GROUP_AFFINITY previous{};
+	memcpy(&previous, saved_.data(), sizeof(previous));
+	SetThreadGroupAffinity(GetCurrentThread(), &previous, nullptr);
+#elif defined(__linux__)
+	cpu_set_t previous;
+	memcpy(&previous, saved_.data(), sizeof(previous));
+	pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+#endif
+	saved_.clear();
+	node_ = -1;
+}
@@ -0,0 +1,55 @@
+// xnuma.h
+#pragma once
+#include <vector>
+#include <mutex>
+
+/**
+ * @brief NUMA ڵϢ
+ *
+ * תڴ򿪱֮ǰѵǰ̰߳󶨵һڵ CPU ϣ
+ * FFmpeg  avcodec_open2() дĽ/̼̳߳и׺ԣڵǰִ߳У
+ * ֡Щ߳״д룬ϵͳĬϵıطͬһڵڴС
+ * 񰴸ڵе䣬ɢнڵ㡣
+ *
+ * ڵֵ֧ƽ̨вΪղ
+ */
+class XNuma
+{
+public:
+	static XNuma& Instance();
+
+	int node_count() const { return (int)node_cpus_.size(); }
+	// ڵϵ CPU 
+	const std::vector<int>& NodeCpus(int node) const { return node_cpus_[node]; }
+
+	// ѡٵĽڵ㲢ʱ ReleaseNode()
+	int AcquireNode();
+	void ReleaseNode(int node);
+
+private:
+	XNuma();
+
+	std::vector<std::vector<int>> node_cpus_;
+	std::vector<int> node_jobs_;
+	std::mutex mtx_;
+};
+
+/**
+ * @brief ѵǰ̰߳󶨵 NUMA ڵ㣬ʱָԭ׺
+ */
+class XNumaBinding
+{
+public:
+	XNumaBinding() = default;
+	~XNumaBinding() { Unbind(); }
+	XNumaBinding(const XNumaBinding&) = delete;
+	XNumaBinding& operator=(const XNumaBinding&) = delete;
+
+	bool Bind(int node);
+	void Unbind();
+	int node() const { return node_; }
+
+private:
+	int node_{ -1 };
+	std::vector<unsigned char> saved_;	// ǰ׺ԣƽ̨صԭʼݣ
+};
@@ -0,0 +1,359 @@
+// xpacket_trace.cpp
+#include "xpacket_trace.h"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/mem.h>
+}
+
+#pragma comment(lib, "avformat.lib")
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4996)
+#endif
+
+// ﵽʱд̣߳򰴼д
+static const size_t kBatchRecords = 256;
+static const int kFlushIntervalMs = 500;
+
+// ׷ļܳ 2GB
+static bool Seek(FILE* file, int64_t offset, int origin)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, origin) == 0;
+#else
+	return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+}
+
+static int64_t Tell(FILE* file)
+{
+#ifdef _WIN32
+	return _ftelli64(file);
+#else
+	return (int64_t)ftello(file);
+#endif
+}
+
+static void WriteStream(FILE* file, const XTraceStreamInfo& info)
+{
+	XTraceStream stream = info.stream;
+	stream.extradata_size = (uint32_t)info.extradata.size();
+	fwrite(&stream, sizeof(stream), 1, file);
+	if (!info.extradata.empty()) fwrite(info.extradata.data(), 1, info.extradata.size(), file);
+}
+
+XTraceStreamInfo XTraceStreamInfo::FromParameters(const AVCodecParameters* par, AVRational time_base, AVRational frame_rate)
+{
+	XTraceStreamInfo info;
+	info.stream.media_type = par->codec_type;
+	info.stream.codec_id = par->codec_id;
+	info.stream.format = par->format;
+	info.stream.width = par->width;
+	info.stream.height = par->height;
+	info.stream.sample_rate = par->sample_rate;
+	info.stream.channels = par->ch_layout.nb_channels;
+	info.stream.time_base_num = time_base.num;
+	info.stream.time_base_den = time_base.den;
+	info.stream.frame_rate_num = frame_rate.num;
+	info.stream.frame_rate_den = frame_rate.den;
+	info.stream.bit_rate = par->bit_rate;
+	if (par->extradata && par->extradata_size > 0)
+	{
+		info.extradata.assign(par->extradata, par->extradata + par->extradata_size);
+	}
+	return info;
+}
+
+XTraceStreamInfo XTraceStreamInfo::FromContext(const AVCodecContext* ctx)
+{
+	XTraceStreamInfo info;
+	if (!ctx) return info;
+	info.stream.media_type = ctx->codec_type;
+	info.stream.codec_id = ctx->codec_id;
+	info.stream.format = (ctx->codec_type == AVMEDIA_TYPE_VIDEO) ? (int)ctx->pix_fmt : (int)ctx->sample_fmt;
+	info.stream.width = ctx->width;
+	info.stream.height = ctx->height;
+	info.stream.sample_rate = ctx->sample_rate;
+	info.stream.channels = ctx->ch_layout.nb_channels;
+	info.stream.time_base_num = ctx->time_base.num;
+	info.stream.time_base_den = ctx->time_base.den;
+	info.stream.frame_rate_num = ctx->framerate.num;
+	info.stream.frame_rate_den = ctx->framerate.den;
+	info.stream.bit_rate = ctx->bit_rate;
+	if (ctx->extradata && ctx->extradata_size > 0)
+	{
+		info.extradata.assign(ctx->extradata, ctx->extradata + ctx->extradata_size);
+	}
+	return info;
+}
+
+bool XTraceStreamInfo::ToParameters(AVCodecParameters* par) const
+{
+	par->codec_type = (AVMediaType)stream.media_type;
+	par->codec_id = (AVCodecID)stream.codec_id;
+	par->format = stream.format;
+	par->width = stream.width;
+	par->height = stream.height;
+	par->sample_rate = stream.sample_rate;
+	par->bit_rate = stream.bit_rate;
+	av_channel_layout_uninit(&par->ch_layout);
+	if (stream.channels > 0) av_channel_layout_default(&par->ch_layout, stream.channels);
+
+	av_freep(&par->extradata);
+	par->extradata_size = 0;
+	if (!extradata.empty())
+	{
+		par->extradata = (uint8_t*)av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+		if (!par->extradata) return false;
+		memcpy(par->extradata, extradata.data(), extradata.size());
+		par->extradata_size = (int)extradata.size();
+	}
+	return true;
+}
+
+XPacketTraceWriter::~XPacketTraceWriter()
+{
+	Close();
+}
+
+bool XPacketTraceWriter::Open(const std::string& path, const XTraceHeader& header,
+	const std::vector<XTraceStreamInfo>& inputs, const XTraceStreamInfo outputs[2], bool with_data)
+{
+	Close();
+	index_ = 0;
+	file_ = fopen(path.c_str(), "wb");
+	if (!file_)
+	{
+		std::cerr << "Error: cannot open packet trace file '" << path << "'" << std::endl;
+		return false;
+	}
+	setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+
+	XTraceHeader head = header;
+	head.magic = kPacketTraceMagic;
+	head.version = kPacketTraceVersion;
+	head.flags = with_data ? kPacketTraceHasData : 0;
+	head.input_streams = (int32_t)inputs.size();
+	fwrite(&head, sizeof(head), 1, file_);
+	for (const XTraceStreamInfo& info : inputs) WriteStream(file_, info);
+	WriteStream(file_, outputs[0]);
+	WriteStream(file_, outputs[1]);
+
+	with_data_ = with_data;
+	start_us_ = 0;
+	start_us_ = Now();
+	stopping_ = false;
+	pending_.reserve(kBatchRecords * 2);
+	writer_ = std::thread(&XPacketTraceWriter::WriterLoop, this);
+	return true;
+}
+
+bool XPacketTraceWriter::Open(const std::string& path, const AVFormatContext* in_fmt, int video_index, int audio_index,
+	const AVCodecContext* video_enc, const AVCodecContext* audio_enc, bool with_data)
+{
+	XTraceHeader header{};
+	header.video_index = video_index;
+	header.audio_index = audio_index;
+
+	std::vector<XTraceStreamInfo> inputs;
+	for (unsigned int i = 0; i < in_fmt->nb_streams; i++)
+	{
+		const AVStream* st = in_fmt->streams[i];
+		inputs.push_back(XTraceStreamInfo::FromParameters(st->codecpar, st->time_base, st->avg_frame_rate));
+	}
+	XTraceStreamInfo outputs[2] = {
+		XTraceStreamInfo::FromContext(video_enc),
+		XTraceStreamInfo::FromContext(audio_enc)
+	};
+	return Open(path, header, inputs, outputs, with_data);
+}
+
+void XPacketTraceWriter::Close()
+{
+	if (writer_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			stopping_ = true;
+		}
+		cv_.notify_one();
+		writer_.join();
+	}
+	if (file_)
+	{
+		fclose(file_);
+		file_ = nullptr;
+	}
+	for (Pending& p : pending_) av_packet_free(&p.pkt);
+	pending_.clear();
+}
+
+int64_t XPacketTraceWriter::Now() const
+{
+	if (!file_) return 0;
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() - start_us_;
+}
+
+void XPacketTraceWriter::Write(XTraceRecord rec, const AVPacket* pkt)
+{
+	if (!file_) return;
+	rec.index = index_++;
+	rec.data_size = 0;
+	AVPacket* ref = nullptr;
+	if (with_data_ && pkt && pkt->size > 0)
+	{
+		// ð壬д߳дͷ
+		ref = av_packet_alloc();
+		if (ref && av_packet_ref(ref, pkt) < 0) av_packet_free(&ref);
+		if (ref) rec.data_size = ref->size;
+	}
+
+	bool notify = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		pending_.push_back({ rec, ref });
+		notify = pending_.size() >= kBatchRecords;
+	}
+	if (notify) cv_.notify_one();
+}
+
+void XPacketTraceWriter::Write(const AVPacket* pkt, int64_t read_start, int64_t read_end, int64_t done, int64_t encode_us, int frames)
+{
+	if (!file_) return;
+	XTraceRecord rec{};
+	rec.stream = pkt->stream_index;
+	rec.flags = pkt->flags;
+	rec.pts = pkt->pts;
+	rec.dts = pkt->dts;
+	rec.duration = pkt->duration;
+	rec.size = pkt->size;
+	rec.time_us = read_start;
+	rec.read_us = (int32_t)(read_end - read_start);
+	rec.decode_us = (int32_t)(done - read_end - encode_us);
+	rec.encode_us = (int32_t)encode_us;
+	rec.frames = frames;
+	Write(rec, pkt);
+}
+
+void XPacketTraceWriter::WriterLoop()
+{
+	std::vector<Pending> batch;
+	batch.reserve(kBatchRecords * 2);
+	while (true)
+	{
+		bool stop = false;
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+				[this]() { return stopping_ || pending_.size() >= kBatchRecords; });
+			batch.swap(pending_);
+			stop = stopping_;
+		}
+
+		for (Pending& p : batch)
+		{
+			fwrite(&p.rec, sizeof(p.rec), 1, file_);
+			if (p.pkt)
+			{
+				fwrite(p.pkt->data, 1, p.rec.data_size, file_);
+				av_packet_free(&p.pkt);
+			}
+		}
+		batch.clear();
+		fflush(file_);
+		if (stop) break;
+	}
+}
+
+XPacketTraceReader::~XPacketTraceReader()
+{
+	Close();
+}
+
+bool XPacketTraceReader::ReadStream(XTraceStreamInfo& info)
+{
+	if (fread(&info.stream, sizeof(info.stream), 1, file_) != 1) return false;
+	info.extradata.resize(info.stream.extradata_size);
+	return info.extradata.empty() ||
+		fread(info.extradata.data(), 1, info.extradata.size(), file_) == info.extradata.size();
+}
+
+bool XPacketTraceReader::Open(const std::string& path)
+{
+	Close();
+	file_ = fopen(path.c_str(), "rb");
+	if (!file_)
+	{
+		std::cerr << "Error: cannot open packet trace file '" << path << "'" << std::endl;
+		return false;
+	}
+	setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+
+	bool ok = fread(&header_, sizeof(header_), 1, file_) == 1 &&
+		header_.magic == kPacketTraceMagic && header_.version == kPacketTraceVersion &&
+		header_.input_streams >= 0 && header_.input_streams < 1024;
+	if (ok)
+	{
+		inputs_.resize(header_.input_streams);
+		for (XTraceStreamInfo& info : inputs_) ok = ok && ReadStream(info);
+		ok = ok && ReadStream(outputs_[0]) && ReadStream(outputs_[1]);
+	}
+	if (!ok)
+	{
+		std::cerr << "Error: '" << path << "' is not a packet trace file" << std::endl;
+		Close();
+		return false;
+	}
+	records_offset_ = Tell(file_);
+	return true;
+}
+
+void XPacketTraceReader::Close()
+{
+	if (file_)
+	{
+		fclose(file_);
+		file_ = nullptr;
+	}
+	inputs_.clear();
+}
+
+bool XPacketTraceReader::Next(XTraceRecord& rec, AVPacket* pkt)
+{
+	if (!file_ || fread(&rec, sizeof(rec), 1, file_) != 1) return false;
+	if (rec.data_size < 0) return false;
+	if (!pkt || rec.data_size == 0)
+	{
+		return rec.data_size == 0 || Seek(file_, rec.data_size, SEEK_CUR);
+	}
+
+	av_packet_unref(pkt);
+	if (av_new_packet(pkt, rec.data_size) < 0) return false;
+	if (fread(pkt->data, 1, rec.data_size, file_) != (size_t)rec.data_size)
+	{
+		av_packet_unref(pkt);
+		return false;
+	}
+	pkt->stream_index = rec.stream;
+	pkt->pts = rec.pts;
+	pkt->dts = rec.dts;
+	pkt->duration = rec.duration;
+	pkt->flags = rec.flags;
+	return true;
+}
+
+bool XPacketTraceReader::Rewind()
+{
+	return file_ && Seek(file_, records_offset_, SEEK_SET);
+}
+
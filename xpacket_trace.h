@@ -0,0 +1,178 @@
+// xpacket_trace.h
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+struct AVPacket;
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVCodecParameters;
+
+/**
+ * ׷ļ֣ƣֽ򣩣
+ *
+ *   [XTraceHeader]
+ *   [XTraceStream + extradata] x input_streams	
+ *   [XTraceStream + extradata] x 2				תƵƵcodec_id Ϊ 0 ʾûУ
+ *   [XTraceRecord + ] ...						װ˳ÿһ data_size ֽ
+ *
+ * ¼̬ʱСؼ֡͸׶κʱѡ¼ݡ
+ * ¼ݵ׷ļƬԴݣ xtrace_replay synth ̬ͬĺϳɸغطš
+ */
+static const uint32_t kPacketTraceMagic = 0x43525458;	// "XTRC"
+static const uint32_t kPacketTraceVersion = 1;
+static const uint32_t kPacketTraceHasData = 1;			// XTraceHeader::flags
+
+struct XTraceHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	int32_t input_streams;
+	int32_t video_index;		// תƵ/ƵţûΪ -1
+	int32_t audio_index;
+	int32_t reserved[2];
+};
+
+struct XTraceStream
+{
+	int32_t media_type;			// AVMediaType
+	int32_t codec_id;			// AVCodecID
+	int32_t format;				// ظʽ / ʽ
+	int32_t width;
+	int32_t height;
+	int32_t sample_rate;
+	int32_t channels;
+	int32_t time_base_num;		// ʱʱʱ
+	int32_t time_base_den;
+	int32_t frame_rate_num;
+	int32_t frame_rate_den;
+	int32_t reserved;
+	int64_t bit_rate;
+	uint32_t extradata_size;
+	uint32_t reserved2;
+};
+
+struct XTraceRecord
+{
+	int64_t index;				// 
+	int32_t stream;				// 
+	int32_t flags;				// AVPacket::flags
+	int64_t pts;				// ʱΪ AV_NOPTS_VALUE
+	int64_t dts;
+	int64_t duration;
+	int32_t size;
+	int32_t data_size;			// ¼ĸֽ¼ʱΪ 0
+	int64_t time_us;			// ʼðʱ̣׷ٿʼ
+	int32_t read_us;			// װ
+	int32_t decode_us;			// Ͱȡ֡
+	int32_t encode_us;			// ð֡ĺ˾š롢װ
+	int32_t frames;				// ð֡
+};
+
+//  extradata
+struct XTraceStreamInfo
+{
+	XTraceStream stream{};
+	std::vector<uint8_t> extradata;
+
+	static XTraceStreamInfo FromParameters(const AVCodecParameters* par, AVRational time_base, AVRational frame_rate);
+	static XTraceStreamInfo FromContext(const AVCodecContext* ctx);
+	// дextradata Ƶ par
+	bool ToParameters(AVCodecParameters* par) const;
+	AVRational time_base() const { return { stream.time_base_num, stream.time_base_den }; }
+	AVRational frame_rate() const { return { stream.frame_rate_num, stream.frame_rate_den }; }
+};
+
+/**
+ * @brief ׷дˣתֻ߳Ѽ¼Ͱã׷ӵڴ滺壬ɺ̨߳дļ
+ *
+ * ¼ʱаãƣдͷţ̸ʱ
+ */
+class XPacketTraceWriter
+{
+public:
+	~XPacketTraceWriter();
+
+	// inputs Ϊoutputs ΪƵƵûеգwith_data ¼
+	bool Open(const std::string& path, const XTraceHeader& header,
+		const std::vector<XTraceStreamInfo>& inputs, const XTraceStreamInfo outputs[2], bool with_data);
+	// װѴ򿪵ıдļͷ
+	bool Open(const std::string& path, const AVFormatContext* in_fmt, int video_index, int audio_index,
+		const AVCodecContext* video_enc, const AVCodecContext* audio_enc, bool with_data);
+	// дʣļ¼رļ
+	void Close();
+	bool is_open() const { return file_ != nullptr; }
+
+	// ׷ʱӣ΢룩δʱ 0 Ҳʱ
+	int64_t Now() const;
+
+	// rec.index  rec.data_size ддpkt Ϊü¼İֻڼ¼ʱʹã
+	void Write(XTraceRecord rec, const AVPacket* pkt);
+	// תѭãread_start/read_end/done Ϊ Now() ķֵencode_us Ϊð֡ʱ
+	void Write(const AVPacket* pkt, int64_t read_start, int64_t read_end, int64_t done, int64_t encode_us, int frames);
+
+	int64_t records() const { return index_; }
+
+private:
+	struct Pending {
+		XTraceRecord rec;
+		AVPacket* pkt;		// ¼ʱΪãΪ nullptr
+	};
+
+	void WriterLoop();
+
+private:
+	FILE* file_{ nullptr };
+	bool with_data_{ false };
+	int64_t index_{ 0 };
+	int64_t start_us_{ 0 };
+
+	std::thread writer_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::vector<Pending> pending_;
+	bool stopping_{ false };
+};
+
+/**
+ * @brief ׷ٶˣ¼˳ȡذ AVPacket
+ */
+class XPacketTraceReader
+{
+public:
+	~XPacketTraceReader();
+
+	bool Open(const std::string& path);
+	void Close();
+
+	const XTraceHeader& header() const { return header_; }
+	bool has_data() const { return (header_.flags & kPacketTraceHasData) != 0; }
+	const std::vector<XTraceStreamInfo>& inputs() const { return inputs_; }
+	// 0 ΪƵ1 ΪƵ
+	const XTraceStreamInfo& output(int i) const { return outputs_[i]; }
+
+	// һ¼pkt Ϊиʱ pktdatasizeʱflags
+	bool Next(XTraceRecord& rec, AVPacket* pkt = nullptr);
+	// صһ¼
+	bool Rewind();
+
+private:
+	bool ReadStream(XTraceStreamInfo& info);
+
+private:
+	FILE* file_{ nullptr };
+	XTraceHeader header_{};
+	std::vector<XTraceStreamInfo> inputs_;
+	XTraceStreamInfo outputs_[2];
+	int64_t records_offset_{ 0 };
+};
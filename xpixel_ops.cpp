@@ -0,0 +1,272 @@
+// xpixel_ops.cpp
+#include "xpixel_ops.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XPIXEL_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define XPIXEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+const char* XPixelOps::Isa()
+{
+#if defined(XPIXEL_SSE2)
+	return "sse2";
+#elif defined(XPIXEL_NEON)
+	return "neon";
+#else
+	return "c";
+#endif
+}
+
+void XPixelOps::Downsample2x(const uint8_t* src, int src_stride,
+	int width, int height,
+	uint8_t* dst, int dst_stride)
+{
+	int dst_width = width / 2;
+	int dst_height = height / 2;
+	for (int y = 0; y < dst_height; y++)
+	{
+		const uint8_t* r0 = src + (2 * y) * src_stride;
+		const uint8_t* r1 = r0 + src_stride;
+		uint8_t* d = dst + y * dst_stride;
+		int x = 0;
+
+#if defined(XPIXEL_SSE2)
+		const __m128i mask = _mm_set1_epi16(0x00FF);
+		const __m128i one = _mm_set1_epi16(1);
+		for (; x + 16 <= dst_width; x += 16)
+		{
+			// ֱֵֽ
+			__m128i v0 = _mm_avg_epu8(
+				_mm_loadu_si128((const __m128i*)(r0 + 2 * x)),
+				_mm_loadu_si128((const __m128i*)(r1 + 2 * x)));
+			__m128i v1 = _mm_avg_epu8(
+				_mm_loadu_si128((const __m128i*)(r0 + 2 * x + 16)),
+				_mm_loadu_si128((const __m128i*)(r1 + 2 * x + 16)));
+			// ˮƽֽڣżֵ
+			__m128i h0 = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(
+				_mm_and_si128(v0, mask), _mm_srli_epi16(v0, 8)), one), 1);
+			__m128i h1 = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(
+				_mm_and_si128(v1, mask), _mm_srli_epi16(v1, 8)), one), 1);
+			_mm_storeu_si128((__m128i*)(d + x), _mm_packus_epi16(h0, h1));
+		}
+#elif defined(XPIXEL_NEON)
+		for (; x + 16 <= dst_width; x += 16)
+		{
+			uint8x16_t v0 = vrhaddq_u8(vld1q_u8(r0 + 2 * x), vld1q_u8(r1 + 2 * x));
+			uint8x16_t v1 = vrhaddq_u8(vld1q_u8(r0 + 2 * x + 16), vld1q_u8(r1 + 2 * x + 16));
+			uint8x8_t h0 = vrshrn_n_u16(vpaddlq_u8(v0), 1);
+			uint8x8_t h1 = vrshrn_n_u16(vpaddlq_u8(v1), 1);
+			vst1q_u8(d + x, vcombine_u8(h0, h1));
+		}
+#endif
+		for (; x < dst_width; x++)
+		{
+			int a = (r0[2 * x] + r1[2 * x] + 1) >> 1;
+			int b = (r0[2 * x + 1] + r1[2 * x + 1] + 1) >> 1;
+			d[x] = (uint8_t)((a + b + 1) >> 1);
+		}
+	}
+}
+
+void XPixelOps::BlockSad8x8(const uint8_t* a, int a_stride,
+	const uint8_t* b, int b_stride,
+	int width, int height,
+	uint32_t* block_sad)
+{
+	int blocks_x = width / 8;
+	int blocks_y = height / 8;
+	for (int by = 0; by < blocks_y; by++)
+	{
+		uint32_t* out = block_sad + by * blocks_x;
+		for (int bx = 0; bx < blocks_x; bx++) out[bx] = 0;
+
+		for (int y = by * 8; y < by * 8 + 8; y++)
+		{
+			const uint8_t* pa = a + y * a_stride;
+			const uint8_t* pb = b + y * b_stride;
+			int bx = 0;
+#if defined(XPIXEL_SSE2)
+			// һδ飺psadbw ĵ/ 64 λֱǰ/ 8 ֽڵ SAD
+			for (; bx + 2 <= blocks_x; bx += 2)
+			{
+				__m128i sad = _mm_sad_epu8(
+					_mm_loadu_si128((const __m128i*)(pa + bx * 8)),
+					_mm_loadu_si128((const __m128i*)(pb + bx * 8)));
+				out[bx] += (uint32_t)_mm_cvtsi128_si32(sad);
+				out[bx + 1] += (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+			}
+#elif defined(XPIXEL_NEON)
+			for (; bx + 2 <= blocks_x; bx += 2)
+			{
+				uint8x16_t diff = vabdq_u8(vld1q_u8(pa + bx * 8), vld1q_u8(pb + bx * 8));
+				uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(diff)));
+				out[bx] += (uint32_t)vgetq_lane_u64(sum, 0);
+				out[bx + 1] += (uint32_t)vgetq_lane_u64(sum, 1);
+			}
+#endif
+			for (; bx < blocks_x; bx++)
+			{
+				uint32_t sum = 0;
+				for (int x = bx * 8; x < bx * 8 + 8; x++)
+				{
+					int d = pa[x] - pb[x];
+					sum += (uint32_t)(d < 0 ? -d : d);
+				}
+				out[bx] += sum;
+			}
+		}
+	}
+}
+
+uint64_t XPixelOps::SumSquaredError(const uint8_t* a, int a_stride,
+	const uint8_t* b, int b_stride,
+	int width, int height)
+{
+	uint64_t total = 0;
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t* pa = a + y * a_stride;
+		const uint8_t* pb = b + y * b_stride;
+		int x = 0;
+		// ÿ 32 λۼӣпС 26 زβ 64 λ
+		uint64_t row = 0;
+#if defined(XPIXEL_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = _mm_setzero_si128();
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)(pa + x));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(pb + x));
+			__m128i d0 = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+			__m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+			acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(d0, d0), _mm_madd_epi16(d1, d1)));
+		}
+		uint32_t lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, acc);
+		row = (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(XPIXEL_NEON)
+		uint32x4_t acc = vdupq_n_u32(0);
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16_t diff = vabdq_u8(vld1q_u8(pa + x), vld1q_u8(pb + x));
+			uint16x8_t lo = vmull_u8(vget_low_u8(diff), vget_low_u8(diff));
+			uint16x8_t hi = vmull_u8(vget_high_u8(diff), vget_high_u8(diff));
+			acc = vpadalq_u16(acc, lo);
+			acc = vpadalq_u16(acc, hi);
+		}
+		row = vaddvq_u32(acc);
+#endif
+		for (; x < width; x++)
+		{
+			int d = pa[x] - pb[x];
+			row += (uint64_t)(d * d);
+		}
+		total += row;
+	}
+	return total;
+}
+
+// 8x8  sum(a)sum(b)sum(a*a)sum(b*b)sum(a*b)
+static void BlockStats8x8(const uint8_t* a, int a_stride,
+	const uint8_t* b, int b_stride, uint32_t s[5])
+{
+	s[0] = s[1] = s[2] = s[3] = s[4] = 0;
+	int y = 0;
+#if defined(XPIXEL_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum_a = _mm_setzero_si128();
+	__m128i sum_b = _mm_setzero_si128();
+	__m128i sum_aa = _mm_setzero_si128();
+	__m128i sum_bb = _mm_setzero_si128();
+	__m128i sum_ab = _mm_setzero_si128();
+	for (; y < 8; y++)
+	{
+		__m128i va8 = _mm_loadl_epi64((const __m128i*)(a + y * a_stride));
+		__m128i vb8 = _mm_loadl_epi64((const __m128i*)(b + y * b_stride));
+		sum_a = _mm_add_epi64(sum_a, _mm_sad_epu8(va8, zero));
+		sum_b = _mm_add_epi64(sum_b, _mm_sad_epu8(vb8, zero));
+		__m128i va = _mm_unpacklo_epi8(va8, zero);
+		__m128i vb = _mm_unpacklo_epi8(vb8, zero);
+		sum_aa = _mm_add_epi32(sum_aa, _mm_madd_epi16(va, va));
+		sum_bb = _mm_add_epi32(sum_bb, _mm_madd_epi16(vb, vb));
+		sum_ab = _mm_add_epi32(sum_ab, _mm_madd_epi16(va, vb));
+	}
+	s[0] = (uint32_t)_mm_cvtsi128_si32(sum_a);
+	s[1] = (uint32_t)_mm_cvtsi128_si32(sum_b);
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, sum_aa);
+	s[2] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm_storeu_si128((__m128i*)lanes, sum_bb);
+	s[3] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm_storeu_si128((__m128i*)lanes, sum_ab);
+	s[4] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(XPIXEL_NEON)
+	uint32x4_t sum_a = vdupq_n_u32(0);
+	uint32x4_t sum_b = vdupq_n_u32(0);
+	uint32x4_t sum_aa = vdupq_n_u32(0);
+	uint32x4_t sum_bb = vdupq_n_u32(0);
+	uint32x4_t sum_ab = vdupq_n_u32(0);
+	for (; y < 8; y++)
+	{
+		uint8x8_t va = vld1_u8(a + y * a_stride);
+		uint8x8_t vb = vld1_u8(b + y * b_stride);
+		sum_a = vpadalq_u16(sum_a, vmovl_u8(va));
+		sum_b = vpadalq_u16(sum_b, vmovl_u8(vb));
+		sum_aa = vpadalq_u16(sum_aa, vmull_u8(va, va));
+		sum_bb = vpadalq_u16(sum_bb, vmull_u8(vb, vb));
+		sum_ab = vpadalq_u16(sum_ab, vmull_u8(va, vb));
+	}
+	s[0] = vaddvq_u32(sum_a);
+	s[1] = vaddvq_u32(sum_b);
+	s[2] = vaddvq_u32(sum_aa);
+	s[3] = vaddvq_u32(sum_bb);
+	s[4] = vaddvq_u32(sum_ab);
+#endif
+	for (; y < 8; y++)
+	{
+		const uint8_t* pa = a + y * a_stride;
+		const uint8_t* pb = b + y * b_stride;
+		for (int x = 0; x < 8; x++)
+		{
+			s[0] += pa[x];
+			s[1] += pb[x];
+			s[2] += pa[x] * pa[x];
+			s[3] += pb[x] * pb[x];
+			s[4] += pa[x] * pb[x];
+		}
+	}
+}
+
+double XPixelOps::Ssim8x8(const uint8_t* a, int a_stride,
+	const uint8_t* b, int b_stride,
+	int width, int height)
+{
+	// SSIM C1 = (0.01 * 255)^2C2 = (0.03 * 255)^2
+	const double c1 = 6.5025;
+	const double c2 = 58.5225;
+	int blocks_x = width / 8;
+	int blocks_y = height / 8;
+	if (blocks_x <= 0 || blocks_y <= 0) return 1.0;
+
+	double total = 0;
+	uint32_t s[5];
+	for (int by = 0; by < blocks_y; by++)
+	{
+		for (int bx = 0; bx < blocks_x; bx++)
+		{
+			BlockStats8x8(a + by * 8 * a_stride + bx * 8, a_stride,
+				b + by * 8 * b_stride + bx * 8, b_stride, s);
+			double mu_a = s[0] / 64.0;
+			double mu_b = s[1] / 64.0;
+			double var_a = s[2] / 64.0 - mu_a * mu_a;
+			double var_b = s[3] / 64.0 - mu_b * mu_b;
+			double cov = s[4] / 64.0 - mu_a * mu_b;
+			total += ((2 * mu_a * mu_b + c1) * (2 * cov + c2)) /
+				((mu_a * mu_a + mu_b * mu_b + c1) * (var_a + var_b + c2));
+		}
+	}
+	return total / ((double)blocks_x * blocks_y);
+}
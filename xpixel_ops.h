@@ -0,0 +1,36 @@
+// xpixel_ops.h
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief ںˣSSE2 / NEON ƽ̨ʹñʵ֣
+ *
+ * кֻ 8 λƽݣͨΪƽ棩ʵһ¡
+ */
+class XPixelOps
+{
+public:
+	// 2x2 ֵdst ߴΪ (width/2) x (height/2)ͬ _mm_avg_epu8
+	static void Downsample2x(const uint8_t* src, int src_stride,
+		int width, int height,
+		uint8_t* dst, int dst_stride);
+
+	// 8x8  SADblock_sad  (width/8) x (height/8) Ľ 8 ıԵ
+	static void BlockSad8x8(const uint8_t* a, int a_stride,
+		const uint8_t* b, int b_stride,
+		int width, int height,
+		uint32_t* block_sad);
+
+	// ƽͣPSNR ãwidth Ϊֽ
+	static uint64_t SumSquaredError(const uint8_t* a, int a_stride,
+		const uint8_t* b, int b_stride,
+		int width, int height);
+
+	// ƽ SSIMص 8x8 ȡƽ 8 ıԵԣʱ 1
+	static double Ssim8x8(const uint8_t* a, int a_stride,
+		const uint8_t* b, int b_stride,
+		int width, int height);
+
+	// ǰʹõָƣ"sse2" / "neon" / "c"
+	static const char* Isa();
+};
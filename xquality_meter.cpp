@@ -0,0 +1,304 @@
+// xquality_meter.cpp
+#include "xquality_meter.h"
+#include "xdecoder.h"
+#include "xpixel_ops.h"
+#include "xlog.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+
+// ѹĴʱ´
+static const size_t kMaxQueuedItems = 256;
+
+XQualityMeter::~XQualityMeter()
+{
+	Close();
+}
+
+bool XQualityMeter::Open(const AVCodecContext* enc_ctx, int interval_frames, int window_frames)
+{
+	Close();
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stats_ = XQualityStats();
+	}
+	psnr_sum_ = 0;
+	ssim_sum_ = 0;
+	if (!enc_ctx) return false;
+
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(enc_ctx->pix_fmt);
+	if (!desc || desc->comp[0].depth != 8)
+	{
+		std::cerr << "Warning: quality meter supports 8-bit formats only, disabled" << std::endl;
+		return false;
+	}
+
+	decoder_ = new XDecoder();
+	AVCodecParameters* par = avcodec_parameters_alloc();
+	bool ok = decoder_->Create(enc_ctx->codec_id, false) &&
+		par && avcodec_parameters_from_context(par, enc_ctx) >= 0 &&
+		avcodec_parameters_to_context(decoder_->GetContext(), par) >= 0;
+	avcodec_parameters_free(&par);
+	if (ok)
+	{
+		// 룺̣߳֡ӳ
+		decoder_->GetContext()->thread_count = 1;
+		decoder_->GetContext()->pkt_timebase = enc_ctx->time_base;
+		ok = decoder_->Open();
+	}
+	if (!ok)
+	{
+		std::cerr << "Error: open quality meter decoder failed!" << std::endl;
+		decoder_->Close();
+		delete decoder_;
+		decoder_ = nullptr;
+		return false;
+	}
+
+	interval_frames_ = interval_frames > 0 ? interval_frames : 250;
+	window_frames_ = window_frames > 0 ? window_frames : 1;
+	if (window_frames_ > interval_frames_) window_frames_ = interval_frames_;
+	frame_index_ = 0;
+	window_left_ = 0;
+	wait_key_ = false;
+	forwarding_ = false;
+	window_pts_.clear();
+	stopping_ = false;
+	decoded_ = av_frame_alloc();
+	worker_ = std::thread(&XQualityMeter::WorkerLoop, this);
+	return true;
+}
+
+void XQualityMeter::Close()
+{
+	if (worker_.joinable())
+	{
+		// δĴڰύİȫ˳
+		if (wait_key_ || forwarding_) Push(Item{ nullptr, nullptr, true });
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			stopping_ = true;
+		}
+		cv_.notify_one();
+		worker_.join();
+	}
+	for (auto& item : queue_)
+	{
+		av_frame_free(&item.source);
+		av_packet_free(&item.packet);
+	}
+	queue_.clear();
+	ClearSources();
+	av_frame_free(&decoded_);
+	if (decoder_)
+	{
+		decoder_->Close();
+		delete decoder_;
+		decoder_ = nullptr;
+	}
+	wait_key_ = false;
+	forwarding_ = false;
+}
+
+void XQualityMeter::OnSourceFrame(AVFrame* frame)
+{
+	if (!decoder_ || !frame) return;
+
+	if (window_left_ == 0 && frame_index_ % interval_frames_ == 0)
+	{
+		bool busy = false;
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			busy = queue_.size() > kMaxQueuedItems;
+		}
+		if (busy)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			stats_.skipped_windows++;
+		}
+		else if (frame->pts != AV_NOPTS_VALUE)
+		{
+			// һڻûȵȫİδҪؼ֡
+			if (wait_key_ || forwarding_) Push(Item{ nullptr, nullptr, true });
+			window_left_ = window_frames_;
+			window_key_pts_ = frame->pts;
+			window_pts_.clear();
+			wait_key_ = true;
+			forwarding_ = false;
+			// ڴӹؼ֡ʼҪ֮ǰĲο֡
+			frame->pict_type = AV_PICTURE_TYPE_I;
+		}
+	}
+	frame_index_++;
+
+	if (window_left_ > 0)
+	{
+		window_left_--;
+		AVFrame* source = av_frame_alloc();
+		if (source && av_frame_ref(source, frame) == 0)
+		{
+			window_pts_.insert(frame->pts);
+			Push(Item{ source, nullptr, false });
+		}
+		else
+		{
+			av_frame_free(&source);
+		}
+	}
+}
+
+void XQualityMeter::OnPacket(const AVPacket* pkt)
+{
+	if (!decoder_ || !pkt) return;
+
+	if (wait_key_)
+	{
+		if (pkt->pts != window_key_pts_ || !(pkt->flags & AV_PKT_FLAG_KEY)) return;
+		wait_key_ = false;
+		forwarding_ = true;
+	}
+	if (!forwarding_) return;
+
+	// ˳תֱÿһ֡İתB ֡õĺο֡ڴ֮ǰת
+	AVPacket* packet = av_packet_clone(pkt);
+	if (packet) Push(Item{ nullptr, packet, false });
+	window_pts_.erase(pkt->pts);
+	if (window_pts_.empty() && window_left_ == 0)
+	{
+		forwarding_ = false;
+		Push(Item{ nullptr, nullptr, true });
+	}
+}
+
+XQualityStats XQualityMeter::stats()
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	return stats_;
+}
+
+void XQualityMeter::Push(Item item)
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		queue_.push_back(item);
+	}
+	cv_.notify_one();
+}
+
+void XQualityMeter::WorkerLoop()
+{
+	while (true)
+	{
+		Item item;
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+			if (queue_.empty()) return;
+			item = queue_.front();
+			queue_.pop_front();
+		}
+
+		if (item.source)
+		{
+			AVFrame*& slot = sources_[item.source->pts];
+			av_frame_free(&slot);
+			slot = item.source;
+		}
+		else if (item.packet)
+		{
+			Decode(item.packet);
+			av_packet_free(&item.packet);
+		}
+		else if (item.window_end)
+		{
+			// ȡʣ֡úȴһڵĹؼ֡
+			Decode(nullptr);
+			decoder_->Flush();
+			ClearSources();
+		}
+	}
+}
+
+void XQualityMeter::Decode(AVPacket* pkt)
+{
+	if (decoder_->SendPacket(pkt) == XDecoder::SendResult::Failed)
+	{
+		// ʧܣؿ仯ʣ֡
+		decoder_->Flush();
+		ClearSources();
+		return;
+	}
+	while (true)
+	{
+		av_frame_unref(decoded_);
+		if (decoder_->ReceiveFrame(decoded_) != XDecoder::ReceiveResult::Success) break;
+		auto it = sources_.find(decoded_->pts);
+		if (it == sources_.end()) continue;
+		Measure(it->second, decoded_);
+		av_frame_free(&it->second);
+		sources_.erase(it);
+	}
+}
+
+void XQualityMeter::Measure(const AVFrame* source, const AVFrame* decoded)
+{
+	if (source->format != decoded->format ||
+		source->width != decoded->width || source->height != decoded->height)
+	{
+		return;
+	}
+	AVPixelFormat fmt = (AVPixelFormat)source->format;
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+	if (!desc || desc->comp[0].depth != 8) return;
+
+	// PSNRȫƽƽ / ͬ ffmpeg psnr ˾ƽֵ
+	uint64_t sse = 0;
+	int64_t samples = 0;
+	int planes = av_pix_fmt_count_planes(fmt);
+	for (int i = 0; i < planes; i++)
+	{
+		int bytes = av_image_get_linesize(fmt, source->width, i);
+		int shift_h = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+		int height = (source->height + (1 << shift_h) - 1) >> shift_h;
+		if (bytes <= 0) continue;
+		sse += XPixelOps::SumSquaredError(source->data[i], source->linesize[i],
+			decoded->data[i], decoded->linesize[i], bytes, height);
+		samples += (int64_t)bytes * height;
+	}
+	double psnr = 100.0;	// ȫͬʱ 100dB 
+	if (sse > 0 && samples > 0)
+	{
+		double mse = (double)sse / samples;
+		psnr = std::min(100.0, 10.0 * std::log10(255.0 * 255.0 / mse));
+	}
+	double ssim = XPixelOps::Ssim8x8(source->data[0], source->linesize[0],
+		decoded->data[0], decoded->linesize[0], source->width, source->height);
+
+	std::lock_guard<std::mutex> lock(mtx_);
+	stats_.frames++;
+	psnr_sum_ += psnr;
+	ssim_sum_ += ssim;
+	stats_.psnr_avg = psnr_sum_ / stats_.frames;
+	stats_.ssim_avg = ssim_sum_ / stats_.frames;
+	if (stats_.frames == 1 || psnr < stats_.psnr_min) stats_.psnr_min = psnr;
+	if (stats_.frames == 1 || ssim < stats_.ssim_min) stats_.ssim_min = ssim;
+}
+
+void XQualityMeter::ClearSources()
+{
+	for (auto& it : sources_)
+	{
+		av_frame_free(&it.second);
+	}
+	sources_.clear();
+}
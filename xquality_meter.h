@@ -0,0 +1,84 @@
+// xquality_meter.h
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "xstats.h"
+
+struct AVFrame;
+struct AVPacket;
+struct AVCodecContext;
+class XDecoder;
+
+/**
+ * @brief תгPSNR / SSIMҪĽԱȹ
+ *
+ * ÿ interval_frames ֡ȡһڣڵһ֡ǿΪؼ֡ window_frames ֡ı
+ * ź󣩱ãӸùؼ֡ʼı͵̣߳ɵ߳룬
+ *  pts 뱣֡ԣں˼ PSNRȫƽ棩 SSIMȣ
+ * ڽˢý֮İ룬ȡ
+ * ̻߳ѹʱ´ڣת롣ֻ֧ 8 λظʽ
+ */
+class XQualityMeter
+{
+public:
+	~XQualityMeter();
+
+	// enc_ctx Ѵ򿪣 extradata 
+	bool Open(const AVCodecContext* enc_ctx, int interval_frames, int window_frames);
+	// ύĴںֹͣ߳
+	void Close();
+	bool is_open() const { return decoder_ != nullptr; }
+
+	// ת̣֮߳֡ǰãframe->pts Ϊʱ㽫֡Ϊ I ֡
+	void OnSourceFrame(AVFrame* frame);
+	// ת̣߳ÿpts Ϊʱ
+	void OnPacket(const AVPacket* pkt);
+
+	// ɵͳƣ̵߳ã
+	XQualityStats stats();
+
+private:
+	struct Item {
+		AVFrame* source{ nullptr };	// ı֡
+		AVPacket* packet{ nullptr };	// ڵı
+		bool window_end{ false };	// ڽˢδԵ֡
+	};
+
+	void Push(Item item);
+	void WorkerLoop();
+	// ̣߳һnullptr ˢ
+	void Decode(AVPacket* pkt);
+	void Measure(const AVFrame* source, const AVFrame* decoded);
+	void ClearSources();
+
+private:
+	XDecoder* decoder_{ nullptr };
+	int interval_frames_{ 250 };
+	int window_frames_{ 4 };
+
+	// ת߳״̬
+	int64_t frame_index_{ 0 };
+	int window_left_{ 0 };			// ǰڻ豣֡
+	bool wait_key_{ false };		// ȴĹؼ֡
+	bool forwarding_{ false };		// תڵİ
+	int64_t window_key_pts_{ 0 };
+	std::set<int64_t> window_pts_;	// δĴ֡ pts
+
+	// ߳
+	std::thread worker_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::deque<Item> queue_;
+	bool stopping_{ false };
+	std::map<int64_t, AVFrame*> sources_;	//  pts ȴԵ֡
+	AVFrame* decoded_{ nullptr };
+
+	XQualityStats stats_;
+	double psnr_sum_{ 0 };
+	double ssim_sum_{ 0 };
+};
@@ -0,0 +1,357 @@
+// xsegment_coordinator.cpp
+#include "xsegment_coordinator.h"
+#include "xdemuxer.h"
+#include "xmuxer.h"
+#include "xnuma.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <chrono>
+#include <cstdlib>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+}
+
+#pragma comment(lib, "avformat.lib")
+#pragma comment(lib, "avcodec.lib")
+#pragma comment(lib, "avutil.lib")
+
+namespace fs = std::filesystem;
+
+XSegmentCoordinator::~XSegmentCoordinator()
+{
+	StopLocalWorkers();
+}
+
+bool XSegmentCoordinator::Transcode(
+	const std::string& input_file,
+	const std::string& output_file,
+	int output_width, int output_height,
+	AVCodecID output_codec_id,
+	int bitrate_kbps,
+	int fps)
+{
+	if (workdir_.empty()) workdir_ = output_file + ".work";
+
+	// һεworker Ծ·
+	std::error_code ec;
+	for (const char* sub : { "queue", "running", "done", "failed" })
+	{
+		fs::remove_all(fs::path(workdir_) / sub, ec);
+		fs::create_directories(fs::path(workdir_) / sub, ec);
+		if (ec)
+		{
+			std::cerr << "Error: create " << workdir_ << "/" << sub << " failed: " << ec.message() << std::endl;
+			return false;
+		}
+	}
+	fs::remove(fs::path(workdir_) / "STOP", ec);
+
+	std::vector<XSegmentJob> jobs;
+	if (!Split(input_file, jobs)) return false;
+	std::string input_path = fs::absolute(input_file, ec).string();
+	for (auto& job : jobs)
+	{
+		job.input = input_path;
+		job.width = output_width;
+		job.height = output_height;
+		job.codec_id = output_codec_id;
+		job.bitrate_kbps = bitrate_kbps;
+		job.fps = fps;
+		job.max_retries = max_retries_;
+	}
+	std::cout << "[coordinator] " << jobs.size() << " segments, "
+		<< local_workers_ << " local workers" << std::endl;
+
+	if (!Publish(jobs)) return false;
+	StartLocalWorkers();
+	bool ok = WaitForSegments(jobs);
+
+	// ֪ͨ workerڵ㣩˳
+	std::ofstream(fs::path(workdir_) / "STOP").put('\n');
+	StopLocalWorkers();
+
+	if (ok) ok = Concat(jobs, output_file);
+	if (ok)
+	{
+		for (const char* sub : { "queue", "running", "done", "failed" })
+		{
+			fs::remove_all(fs::path(workdir_) / sub, ec);
+		}
+	}
+	return ok;
+}
+
+bool XSegmentCoordinator::Split(const std::string& input_file, std::vector<XSegmentJob>& jobs)
+{
+	XDemuxer demuxer;
+	if (!demuxer.Open(input_file)) return false;
+	int video_index = demuxer.video_index();
+	if (video_index < 0)
+	{
+		std::cerr << "Error: segment transcode needs a video stream" << std::endl;
+		demuxer.Close();
+		return false;
+	}
+	input_time_base_ = demuxer.GetAVFormatContext()->streams[video_index]->time_base;
+	int64_t min_duration = av_rescale_q(segment_seconds_, { 1, 1 }, input_time_base_);
+
+	// зֵ㣺һзֵ಻ segment_seconds Ĺؼ֡
+	std::vector<int64_t> cuts;
+	int64_t last_cut = AV_NOPTS_VALUE;
+	AVPacket* pkt = av_packet_alloc();
+	while (demuxer.Read(pkt))
+	{
+		if (pkt->stream_index == video_index && (pkt->flags & AV_PKT_FLAG_KEY))
+		{
+			int64_t ts = (pkt->pts != AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+			if (ts != AV_NOPTS_VALUE)
+			{
+				if (last_cut == AV_NOPTS_VALUE)
+				{
+					input_start_ts_ = ts;
+					last_cut = ts;
+				}
+				else if (ts - last_cut >= min_duration)
+				{
+					cuts.push_back(ts);
+					last_cut = ts;
+				}
+			}
+		}
+		av_packet_unref(pkt);
+	}
+	av_packet_free(&pkt);
+	demuxer.Close();
+
+	// ׶δͷʼĩεβܹؼ֡ʱӰ
+	jobs.clear();
+	for (size_t i = 0; i <= cuts.size(); i++)
+	{
+		XSegmentJob job;
+		job.index = (int)i;
+		job.start_ts = (i == 0) ? AV_NOPTS_VALUE : cuts[i - 1];
+		job.end_ts = (i == cuts.size()) ? AV_NOPTS_VALUE : cuts[i];
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+bool XSegmentCoordinator::Publish(const std::vector<XSegmentJob>& jobs)
+{
+	for (const auto& job : jobs)
+	{
+		if (!job.Save((fs::path(workdir_) / "queue" / job.JobName()).string()))
+		{
+			std::cerr << "Error: failed to write job " << job.JobName() << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool XSegmentCoordinator::WaitForSegments(const std::vector<XSegmentJob>& jobs)
+{
+	size_t last_done = 0;
+	while (true)
+	{
+		std::error_code ec;
+		size_t done = 0;
+		for (const auto& job : jobs)
+		{
+			if (fs::exists(fs::path(workdir_) / "done" / job.SegmentName(), ec)) done++;
+		}
+		if (done != last_done)
+		{
+			std::cout << "[coordinator] " << done << "/" << jobs.size() << " segments done" << std::endl;
+			last_done = done;
+		}
+		if (done == jobs.size()) return true;
+
+		if (!fs::is_empty(fs::path(workdir_) / "failed", ec) && !ec)
+		{
+			std::cerr << "Error: segment failed after " << max_retries_ << " retries, see "
+				<< (fs::path(workdir_) / "failed") << std::endl;
+			return false;
+		}
+
+		ReclaimStaleJobs();
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	}
+}
+
+void XSegmentCoordinator::ReclaimStaleJobs()
+{
+	std::error_code ec;
+	auto now = fs::file_time_type::clock::now();
+	fs::path running_dir = fs::path(workdir_) / "running";
+	for (fs::directory_iterator it(running_dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		std::error_code time_ec;
+		auto mtime = fs::last_write_time(it->path(), time_ec);
+		if (time_ec || now - mtime < std::chrono::seconds(heartbeat_timeout_)) continue;
+
+		XSegmentJob job;
+		if (!job.Load(it->path().string())) continue;
+		// ɾļworker ʱѱջػᶪ
+		std::error_code remove_ec;
+		if (!fs::remove(it->path(), remove_ec)) continue;
+
+		job.attempt++;
+		const char* sub = (job.attempt > job.max_retries) ? "failed" : "queue";
+		std::cerr << "Warning: worker of segment " << job.index << " timed out ("
+			<< it->path().filename().string() << "), moved to " << sub << std::endl;
+		job.Save((fs::path(workdir_) / sub / job.JobName()).string());
+	}
+}
+
+void XSegmentCoordinator::StartLocalWorkers()
+{
+	stop_ = false;
+	int node_count = XNuma::Instance().node_count();
+	for (int i = 0; i < local_workers_; i++)
+	{
+		std::string command = "\"" + worker_command_ + "\" --worker \"" + workdir_ + "\"";
+		//  worker ̰󶨵ͬڵ㣬ɢнڵ
+		if (numa_spread_ && node_count > 1)
+		{
+			command += " --numa-node " + std::to_string(i % node_count);
+		}
+		workers_.emplace_back([this, command, i]() {
+			// worker ֻڳ STOP ʱ˳Ϊ
+			while (!stop_)
+			{
+				int ret = std::system(command.c_str());
+				if (stop_) break;
+				std::cerr << "Warning: local worker " << i << " exited (" << ret << "), restarting" << std::endl;
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+			}
+		});
+	}
+}
+
+void XSegmentCoordinator::StopLocalWorkers()
+{
+	stop_ = true;
+	for (auto& worker : workers_)
+	{
+		if (worker.joinable()) worker.join();
+	}
+	workers_.clear();
+}
+
+bool XSegmentCoordinator::Concat(const std::vector<XSegmentJob>& jobs, const std::string& output_file)
+{
+	bool ret = false;
+	XMuxer muxer;
+	XDemuxer demuxer;
+	AVCodecContext* video_ctx = nullptr;
+	AVCodecContext* audio_ctx = nullptr;
+	AVPacket* pkt = av_packet_alloc();
+	AVRational out_video_tb{ 1, 1 };
+	AVRational out_audio_tb{ 1, 1 };
+	int64_t last_video_dts = AV_NOPTS_VALUE;
+	int64_t last_audio_dts = AV_NOPTS_VALUE;
+	int64_t base_start = AV_NOPTS_VALUE;
+
+	for (const auto& job : jobs)
+	{
+		std::string segment_path = (fs::path(workdir_) / "done" / job.SegmentName()).string();
+		if (!demuxer.Open(segment_path)) goto cleanup;
+		AVFormatContext* fmt_ctx = demuxer.GetAVFormatContext();
+		int video_index = demuxer.video_index();
+		int audio_index = demuxer.audio_index();
+
+		// õһֶε
+		if (job.index == 0)
+		{
+			if (video_index >= 0)
+			{
+				video_ctx = avcodec_alloc_context3(nullptr);
+				demuxer.CopyPara(video_index, video_ctx);
+				video_ctx->time_base = fmt_ctx->streams[video_index]->time_base;
+				video_ctx->framerate = fmt_ctx->streams[video_index]->avg_frame_rate;
+			}
+			if (audio_index >= 0)
+			{
+				audio_ctx = avcodec_alloc_context3(nullptr);
+				demuxer.CopyPara(audio_index, audio_ctx);
+			}
+			if (!muxer.Open(output_file, video_ctx, audio_ctx)) goto cleanup;
+			if (!muxer.WriteHeader()) goto cleanup;
+			AVFormatContext* out_ctx = muxer.GetAVFormatContext();
+			if (muxer.video_index() >= 0) out_video_tb = out_ctx->streams[muxer.video_index()]->time_base;
+			if (muxer.audio_index() >= 0) out_audio_tb = out_ctx->streams[muxer.audio_index()]->time_base;
+		}
+
+		// ʱƫƣ΢룩ֶεһ֡뵽еλã׶βƫ
+		int64_t offset = 0;
+		if (video_index >= 0)
+		{
+			AVStream* st = fmt_ctx->streams[video_index];
+			int64_t seg_start = (st->start_time != AV_NOPTS_VALUE) ?
+				av_rescale_q(st->start_time, st->time_base, AV_TIME_BASE_Q) : 0;
+			if (job.index == 0)
+			{
+				base_start = seg_start;
+			}
+			else
+			{
+				int64_t expected = base_start +
+					av_rescale_q(job.start_ts - input_start_ts_, input_time_base_, AV_TIME_BASE_Q);
+				offset = expected - seg_start;
+			}
+		}
+
+		while (demuxer.Read(pkt))
+		{
+			bool is_video = (pkt->stream_index == video_index);
+			if (!is_video && pkt->stream_index != audio_index)
+			{
+				av_packet_unref(pkt);
+				continue;
+			}
+			AVRational in_tb = fmt_ctx->streams[pkt->stream_index]->time_base;
+			AVRational out_tb = is_video ? out_video_tb : out_audio_tb;
+			int64_t shift = av_rescale_q(offset, AV_TIME_BASE_Q, in_tb);
+			if (pkt->pts != AV_NOPTS_VALUE) pkt->pts += shift;
+			if (pkt->dts != AV_NOPTS_VALUE) pkt->dts += shift;
+			av_packet_rescale_ts(pkt, in_tb, out_tb);
+			pkt->stream_index = is_video ? muxer.video_index() : muxer.audio_index();
+			pkt->pos = -1;
+
+			// ֶνӷ촦 dts 뵥ƵصֶƵ˳
+			int64_t& last_dts = is_video ? last_video_dts : last_audio_dts;
+			if (pkt->dts != AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE && pkt->dts <= last_dts)
+			{
+				if (!is_video)
+				{
+					av_packet_unref(pkt);
+					continue;
+				}
+				pkt->dts = last_dts + 1;
+				if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < pkt->dts) pkt->pts = pkt->dts;
+			}
+			if (pkt->dts != AV_NOPTS_VALUE) last_dts = pkt->dts;
+
+			if (!muxer.Write(pkt)) goto cleanup;
+		}
+		demuxer.Close();
+	}
+	if (!muxer.WriteTrailer()) goto cleanup;
+	std::cout << "[coordinator] concatenated " << jobs.size() << " segments -> " << output_file << std::endl;
+	ret = true;
+
+cleanup:
+	demuxer.Close();
+	muxer.Close();
+	avcodec_free_context(&video_ctx);
+	avcodec_free_context(&audio_ctx);
+	av_packet_free(&pkt);
+	return ret;
+}
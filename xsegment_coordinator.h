@@ -0,0 +1,89 @@
+// xsegment_coordinator.h
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "xsegment_job.h"
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+/**
+ * @brief ֶתЭؼ֡гɶΣ worker תƴ
+ *
+ * Э worker ͨĿ¼񣨼 XSegmentJobĬڱ
+ * local_workers  worker ̣ͬһļϵͳĻֻҪͬһĿ¼
+ * `xtranscoder --worker <Ŀ¼>` ɼ롣
+ *
+ * ʧԣ
+ *  - worker תʧʱԼŻضУattempt + 1
+ *  - worker ̱ʱֹͣʱЭջ
+ *  -  worker 쳣˳ʱ
+ *  - һֶγԴתʧ
+ *
+ * ʹʾ
+ * @code
+ * XSegmentCoordinator coordinator;
+ * coordinator.SetWorkerCommand("./xtranscoder");
+ * coordinator.SetLocalWorkers(4);
+ * coordinator.Transcode("input.mp4", "output.mp4", 1280, 720, AV_CODEC_ID_HEVC);
+ * @endcode
+ */
+class XSegmentCoordinator
+{
+public:
+	~XSegmentCoordinator();
+
+	bool Transcode(
+		const std::string& input_file,
+		const std::string& output_file,
+		int output_width, int output_height,
+		AVCodecID output_codec_id = AV_CODEC_ID_H264,
+		int bitrate_kbps = 2000,
+		int fps = 25
+	);
+
+	// Ŀ¼Ĭ <ļ>.workԶ worker ͬ·
+	void SetWorkDir(const std::string& dir) { workdir_ = dir; }
+	//  worker 0 ʾֻڵϵ worker
+	void SetLocalWorkers(int count) { local_workers_ = count; }
+	//  worker Ŀִļ򣩣 `<command> --worker <Ŀ¼>` 
+	void SetWorkerCommand(const std::string& command) { worker_command_ = command; }
+	// ֶʱ룩ʵĵһؼ֡з
+	void SetSegmentSeconds(int seconds) { segment_seconds_ = seconds; }
+	void SetMaxRetries(int retries) { max_retries_ = retries; }
+	//  worker 󶨵 NUMA ڵ㣨ڵЧ
+	void SetNumaSpread(bool enable) { numa_spread_ = enable; }
+	// ʱ룩ʱδµΪ worker ʧЧ
+	void SetHeartbeatTimeout(int seconds) { heartbeat_timeout_ = seconds; }
+
+private:
+	// ȡƵؼ֡ɷֶ
+	bool Split(const std::string& input_file, std::vector<XSegmentJob>& jobs);
+	bool Publish(const std::vector<XSegmentJob>& jobs);
+	// ȴзֶɣڼջʱ
+	bool WaitForSegments(const std::vector<XSegmentJob>& jobs);
+	void ReclaimStaleJobs();
+	// ˳ƴӷֶΣʱ
+	bool Concat(const std::vector<XSegmentJob>& jobs, const std::string& output_file);
+
+	void StartLocalWorkers();
+	void StopLocalWorkers();
+
+private:
+	std::string workdir_;
+	std::string worker_command_{ "xtranscoder" };
+	int local_workers_{ 2 };
+	int segment_seconds_{ 10 };
+	int max_retries_{ 3 };
+	int heartbeat_timeout_{ 15 };
+	bool numa_spread_{ true };
+
+	int64_t input_start_ts_{ 0 };	// һƵʱƵʱ
+	AVRational input_time_base_{ 1, 1 };
+
+	std::vector<std::thread> workers_;
+	std::atomic<bool> stop_{ false };
+};
@@ -0,0 +1,69 @@
+// xsegment_job.cpp
+#include "xsegment_job.h"
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+
+bool XSegmentJob::Load(const std::string& path)
+{
+	std::ifstream ifs(path);
+	if (!ifs) return false;
+
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		size_t pos = line.find('=');
+		if (pos == std::string::npos) continue;
+		std::string key = line.substr(0, pos);
+		std::string value = line.substr(pos + 1);
+		if (key == "index") index = atoi(value.c_str());
+		else if (key == "input") input = value;
+		else if (key == "start_ts") start_ts = strtoll(value.c_str(), nullptr, 10);
+		else if (key == "end_ts") end_ts = strtoll(value.c_str(), nullptr, 10);
+		else if (key == "width") width = atoi(value.c_str());
+		else if (key == "height") height = atoi(value.c_str());
+		else if (key == "codec_id") codec_id = (AVCodecID)atoi(value.c_str());
+		else if (key == "bitrate_kbps") bitrate_kbps = atoi(value.c_str());
+		else if (key == "fps") fps = atoi(value.c_str());
+		else if (key == "attempt") attempt = atoi(value.c_str());
+		else if (key == "max_retries") max_retries = atoi(value.c_str());
+	}
+	return !input.empty();
+}
+
+bool XSegmentJob::Save(const std::string& path) const
+{
+	std::string tmp_path = path + ".tmp";
+	{
+		std::ofstream ofs(tmp_path, std::ios::trunc);
+		if (!ofs) return false;
+		ofs << "index=" << index << "\n"
+			<< "input=" << input << "\n"
+			<< "start_ts=" << start_ts << "\n"
+			<< "end_ts=" << end_ts << "\n"
+			<< "width=" << width << "\n"
+			<< "height=" << height << "\n"
+			<< "codec_id=" << (int)codec_id << "\n"
+			<< "bitrate_kbps=" << bitrate_kbps << "\n"
+			<< "fps=" << fps << "\n"
+			<< "attempt=" << attempt << "\n"
+			<< "max_retries=" << max_retries << "\n";
+		if (!ofs) return false;
+	}
+	std::remove(path.c_str());
+	return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+std::string XSegmentJob::JobName() const
+{
+	char buff[32];
+	snprintf(buff, sizeof(buff), "seg_%05d.job", index);
+	return buff;
+}
+
+std::string XSegmentJob::SegmentName() const
+{
+	char buff[32];
+	snprintf(buff, sizeof(buff), "seg_%05d.mp4", index);
+	return buff;
+}
@@ -0,0 +1,41 @@
+// xsegment_job.h
+#pragma once
+#include <string>
+#include <cstdint>
+
+extern "C" {
+#include <libavcodec/codec_id.h>
+}
+
+/**
+ * @brief ֲʽֶתkey=value ıļڹĿ¼У
+ *
+ * Ŀ¼ṹ
+ *   queue/     seg_00000.job
+ *   running/  ѱ worker ȡ seg_00000.job@<worker>worker ڸ޸ʱΪ
+ *   done/     תɵķֶ seg_00000.mp4
+ *   failed/   Դ
+ *   STOP      Эд룬worker ˳
+ */
+struct XSegmentJob
+{
+	int index{ 0 };
+	std::string input;				// ļнڵɼ·
+	int64_t start_ts{ 0 };			// ֶηΧ [start_ts, end_ts)Ƶʱ
+	int64_t end_ts{ 0 };			// ׶㡢ĩյΪ AV_NOPTS_VALUE
+	int width{ 0 };
+	int height{ 0 };
+	AVCodecID codec_id{ AV_CODEC_ID_H264 };
+	int bitrate_kbps{ 2000 };
+	int fps{ 25 };
+	int attempt{ 0 };				// ʧܴ
+	int max_retries{ 3 };
+
+	bool Load(const std::string& path);
+	// дʱļڵ㲻дһ
+	bool Save(const std::string& path) const;
+
+	// ļ / ֶļ
+	std::string JobName() const;
+	std::string SegmentName() const;
+};
@@ -0,0 +1,176 @@
+// xsegment_worker.cpp
+#include "xsegment_worker.h"
+#include "xfile_transcoder.h"
+#include <iostream>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+std::string XSegmentWorker::WorkerId()
+{
+	std::string host = "local";
+#ifdef _WIN32
+	const char* name = getenv("COMPUTERNAME");
+	if (name) host = name;
+	int pid = _getpid();
+#else
+	char name[256]{ 0 };
+	if (gethostname(name, sizeof(name) - 1) == 0 && name[0]) host = name;
+	int pid = (int)getpid();
+#endif
+	return host + "-" + std::to_string(pid);
+}
+
+bool XSegmentWorker::Run(const std::string& workdir)
+{
+	workdir_ = workdir;
+	bool all_ok = true;
+	std::cout << "[worker " << WorkerId() << "] " << workdir_ << std::endl;
+
+	std::error_code ec;
+	while (!fs::exists(fs::path(workdir_) / "STOP", ec))
+	{
+		std::string claimed_path;
+		XSegmentJob job;
+		if (!ClaimJob(claimed_path, job))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+			continue;
+		}
+		if (!RunJob(claimed_path, job)) all_ok = false;
+	}
+	return all_ok;
+}
+
+bool XSegmentWorker::ClaimJob(std::string& claimed_path, XSegmentJob& job)
+{
+	std::error_code ec;
+	fs::path queue_dir = fs::path(workdir_) / "queue";
+	fs::path running_dir = fs::path(workdir_) / "running";
+	for (fs::directory_iterator it(queue_dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (it->path().extension() != ".job") continue;
+		// ԭӵģֻһ worker ܳɹȡ
+		fs::path target = running_dir / (it->path().filename().string() + "@" + WorkerId());
+		fs::rename(it->path(), target, ec);
+		if (ec)
+		{
+			ec.clear();
+			continue;
+		}
+		claimed_path = target.string();
+		// ʱ޸ʱ䣬ڶеȴʱᱻЭջأȡ
+		fs::last_write_time(target, fs::file_time_type::clock::now(), ec);
+		ec.clear();
+		if (job.Load(claimed_path)) return true;
+
+		std::cerr << "Error: invalid job file " << target << std::endl;
+		fs::rename(target, fs::path(workdir_) / "failed" / it->path().filename(), ec);
+		return false;
+	}
+	return false;
+}
+
+bool XSegmentWorker::RunJob(const std::string& claimed_path, XSegmentJob& job)
+{
+	fs::path done_dir = fs::path(workdir_) / "done";
+	std::string part_path = (done_dir / (std::to_string(job.index) + "@" + WorkerId() + ".part.mp4")).string();
+	std::string segment_path = (done_dir / job.SegmentName()).string();
+	std::cout << "[worker " << WorkerId() << "] segment " << job.index
+		<< " attempt " << job.attempt + 1 << std::endl;
+
+	// תڼ䶨ڸļ޸ʱ䣨ȸһٵȴ
+	// ļѱЭջػ STOP ʱȡת룬ת
+	XFileTranscoder trans;
+	fs::path stop_path = fs::path(workdir_) / "STOP";
+	std::atomic<bool> running{ true };
+	std::atomic<bool> stopped{ false };
+	std::thread heartbeat([&]() {
+		int ticks = 0;
+		while (running)
+		{
+			if (ticks == 0)
+			{
+				std::error_code ec;
+				if (!fs::exists(claimed_path, ec) && !ec)
+				{
+					trans.Cancel();
+					break;
+				}
+				if (fs::exists(stop_path, ec))
+				{
+					stopped = true;
+					trans.Cancel();
+					break;
+				}
+				fs::last_write_time(claimed_path, fs::file_time_type::clock::now(), ec);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			if (++ticks >= heartbeat_interval_ * 10) ticks = 0;
+		}
+	});
+
+	trans.SetInputRange(job.start_ts, job.end_ts);
+	if (numa_node_ >= 0) trans.SetNumaPlacement(true, numa_node_);
+	bool ok = trans.Transcode(job.input, part_path, job.width, job.height,
+		job.codec_id, job.bitrate_kbps, job.fps);
+
+	running = false;
+	heartbeat.join();
+
+	std::error_code ec;
+	// ļѲڣ˵ʱЭջأ
+	if (!fs::exists(claimed_path, ec))
+	{
+		std::cerr << "Warning: segment " << job.index << " was reclaimed by coordinator" << std::endl;
+		fs::remove(part_path, ec);
+		return ok;
+	}
+	// Эֹͣת뱻ȡԭŻضУԴ´м
+	if (stopped && !ok)
+	{
+		fs::remove(part_path, ec);
+		ReleaseJob(claimed_path, job, false);
+		return true;
+	}
+	if (ok)
+	{
+		fs::rename(part_path, segment_path, ec);
+		if (ec)
+		{
+			std::cerr << "Error: rename " << part_path << " failed: " << ec.message() << std::endl;
+			ok = false;
+		}
+	}
+	if (!ok)
+	{
+		fs::remove(part_path, ec);
+		ReleaseJob(claimed_path, job);
+		return false;
+	}
+	fs::remove(claimed_path, ec);
+	return true;
+}
+
+void XSegmentWorker::ReleaseJob(const std::string& claimed_path, XSegmentJob& job, bool failed)
+{
+	std::error_code ec;
+	if (failed) job.attempt++;
+	fs::path dir = fs::path(workdir_) / (job.attempt > job.max_retries ? "failed" : "queue");
+	if (!job.Save((dir / job.JobName()).string()))
+	{
+		std::cerr << "Error: failed to release job " << job.JobName() << std::endl;
+		return;
+	}
+	fs::remove(claimed_path, ec);
+}
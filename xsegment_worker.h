@@ -0,0 +1,46 @@
+// xsegment_worker.h
+#pragma once
+#include <string>
+#include <atomic>
+#include "xsegment_job.h"
+
+/**
+ * @brief ֶת workerӹĿ¼ȡתһβطֶļ
+ *
+ * ȡǰ queue/ µļԭӸ running/̡̨ͬһļϵͳ
+ * ͬʱͬһĿ¼ȡתڼ䶨ڸ running/ ļ޸ʱ䣬
+ * Эݴж worker Ƿ񻹻šЭջػ STOP ļʱȡڽеת룬
+ *  STOP ļʱ˳
+ *
+ * ʹʾڵ㣩
+ * @code
+ * xtranscoder --worker /mnt/share/job.work
+ * @endcode
+ */
+class XSegmentWorker
+{
+public:
+	// ֱ STOP ļǷȡתɹ
+	bool Run(const std::string& workdir);
+
+	// 룩СЭʱ
+	void SetHeartbeatInterval(int seconds) { heartbeat_interval_ = seconds; }
+
+	// 󶨵 NUMA ڵ㣨Э worker ŷ䣩-1 ʾ
+	void SetNumaNode(int node) { numa_node_ = node; }
+
+	//  worker ıʶ<>-<̺>
+	static std::string WorkerId();
+
+private:
+	// ȡһclaimed_path Ϊ running/ µļ
+	bool ClaimJob(std::string& claimed_path, XSegmentJob& job);
+	bool RunJob(const std::string& claimed_path, XSegmentJob& job);
+	// תʧܣδԴʱŻضУƵ failed/failed Ϊ false ʱԭŻض
+	void ReleaseJob(const std::string& claimed_path, XSegmentJob& job, bool failed = true);
+
+private:
+	std::string workdir_;
+	int heartbeat_interval_{ 2 };
+	int numa_node_{ -1 };
+};
@@ -0,0 +1,112 @@
+// xspeed_controller.cpp
+#include "xspeed_controller.h"
+#include "xencoder.h"
+#include <cstdio>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// еλ B ֡ṹͬbframes=3b-pyramid
+// ؿ dts ƫƲ䣬 dts ֵ
+static const XSpeedController::Level kLevels[] = {
+	{ "medium",    40 },
+	{ "fast",      30 },
+	{ "faster",    20 },
+	{ "veryfast",  15 },
+	{ "superfast", 10 },
+};
+// ο֡д SPSmax_num_ref_frames / DPB С̶
+static const int kRefs = 3;
+// x265  preset ͬд SPS/PPS Ĳ̶Ϊ medium ȡֵ
+static const char* kX265FixedParams = "ctu=64:min-cu-size=8:amp=0:sao=1:weightp=1:tu-intra-depth=1:tu-inter-depth=1";
+static const int kLevelCount = sizeof(kLevels) / sizeof(kLevels[0]);
+
+// ʱ̵̫Ĵ֡ʶ
+static const double kMinWindowSeconds = 1.0;
+// ʵ֡ʳĿĸñŻ
+static const double kUpshiftMargin = 1.3;
+
+void XSpeedController::Start(double target_fps, int start_level)
+{
+	target_fps_ = target_fps;
+	level_ = start_level < 0 ? 0 : (start_level >= kLevelCount ? kLevelCount - 1 : start_level);
+	previous_level_ = level_;
+	pinned_ = false;
+	window_frames_ = 0;
+	window_fps_ = 0;
+	window_start_ = std::chrono::steady_clock::now();
+	skip_window_ = false;
+}
+
+bool XSpeedController::Evaluate()
+{
+	if (!enabled() || pinned_) return false;
+
+	auto now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - window_start_).count();
+	if (seconds < kMinWindowSeconds) return false;	// ۼƵһ GOP ߽
+
+	window_fps_ = window_frames_ / seconds;
+	window_frames_ = 0;
+	window_start_ = now;
+	if (skip_window_)
+	{
+		skip_window_ = false;
+		return false;
+	}
+
+	int next = level_;
+	if (window_fps_ < target_fps_ && level_ + 1 < kLevelCount)
+	{
+		next = level_ + 1;
+	}
+	else if (window_fps_ > target_fps_ * kUpshiftMargin && level_ > 0)
+	{
+		next = level_ - 1;
+	}
+	if (next == level_) return false;
+
+	previous_level_ = level_;
+	level_ = next;
+	skip_window_ = true;
+	return true;
+}
+
+void XSpeedController::Apply(XEncoder* encoder) const
+{
+	const Level& level = kLevels[level_];
+	AVCodecContext* ctx = encoder->GetContext();
+
+	// preset Ϊ x264/x265 ȱ˽ѡֵ֧ı
+	// x264  medium  superfast  CABAC8x8 任ȨԤⶼ̶ο֡
+	encoder->SetOpt("preset", level.preset);
+	ctx->max_b_frames = 3;
+
+	if (ctx->codec_id == AV_CODEC_ID_HEVC)
+	{
+		char params[192];
+		snprintf(params, sizeof(params), "rc-lookahead=%d:ref=%d:%s", level.lookahead, kRefs, kX265FixedParams);
+		encoder->SetOpt("x265-params", params);
+	}
+	else
+	{
+		encoder->SetOpt("rc-lookahead", level.lookahead);
+		ctx->refs = kRefs;
+	}
+}
+
+void XSpeedController::Pin()
+{
+	level_ = previous_level_;
+	pinned_ = true;
+}
+
+std::string XSpeedController::Describe() const
+{
+	const Level& level = kLevels[level_];
+	char buff[128];
+	snprintf(buff, sizeof(buff), "level %d (%s, lookahead %d)%s",
+		level_, level.preset, level.lookahead, pinned_ ? ", pinned" : "");
+	return buff;
+}
@@ -0,0 +1,60 @@
+// xspeed_controller.h
+#pragma once
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+class XEncoder;
+
+/**
+ * @brief ٶȿʵʱĿڱٶȵλ
+ *
+ * ֻ GOP ߽һڵʵ֡ʵĿ򻻵ĵλ
+ * ԸĿ򻻻ظʸãĵλ
+ * ɵ÷ɣſվɱ Apply() ´򿪡
+ *
+ * ƣװĽ׸ extradataSPS/PPSܸı
+ * ֻڲдѡ˶ʿǰհȣο֡x265  CTU
+ * AMPSAO д SPS/PPS Ĳ̶䡣Բһʱ÷Ӧ Pin() ˡ
+ */
+class XSpeedController
+{
+public:
+	// ٶȵλ±ԽԽ
+	struct Level {
+		const char* preset;		// x264/x265 presetдĲ Apply() ̶
+		int lookahead;			// ʿǰհ֡
+	};
+
+	// target_fpsҪﵽı֡ʣʵʱ  ֡ʣ<= 0 ʾر
+	void Start(double target_fps, int start_level = 0);
+	bool enabled() const { return target_fps_ > 0; }
+
+	// ÿһ֡һΣֻ
+	void OnFrame() { ++window_frames_; }
+
+	// GOP ߽ãҪʱ true
+	bool Evaluate();
+
+	// ǰλĲõ Open() ǰã
+	void Apply(XEncoder* encoder) const;
+
+	// صǰĵλ֮ٻı˲ʱã
+	void Pin();
+	bool pinned() const { return pinned_; }
+
+	int level() const { return level_; }
+	double window_fps() const { return window_fps_; }
+	double target_fps() const { return target_fps_; }
+	std::string Describe() const;
+
+private:
+	double target_fps_{ 0 };
+	int level_{ 0 };
+	int previous_level_{ 0 };
+	bool pinned_{ false };
+	int64_t window_frames_{ 0 };
+	double window_fps_{ 0 };
+	std::chrono::steady_clock::time_point window_start_;
+	bool skip_window_{ false };	// ׸ڰſտ
+};
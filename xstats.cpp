@@ -0,0 +1,44 @@
+// xstats.cpp
+#include "xstats.h"
+
+void XTranscodeStats::AddEvent(const std::string& event)
+{
+	events.push_back(event);
+	std::cout << "[stats] " << event << std::endl;
+}
+
+double XTranscodeStats::video_fps() const
+{
+	if (elapsed_seconds <= 0) return 0;
+	return video_frames / elapsed_seconds;
+}
+
+void XTranscodeStats::Print(std::ostream& os) const
+{
+	os << "[stats] video frames: " << video_frames
+		<< ", audio frames: " << audio_frames
+		<< ", duplicate frames: " << duplicate_frames
+		<< ", elapsed: " << elapsed_seconds << "s"
+		<< ", video fps: " << video_fps() << std::endl;
+	os << "[stats] memory peak (MB): decode " << decode_memory.peak / 1048576.0
+		<< ", encode " << encode_memory.peak / 1048576.0
+		<< ", mux " << mux_memory.peak / 1048576.0
+		<< ", job " << job_memory.peak / 1048576.0
+		<< ", throttled: " << throttled_seconds << "s" << std::endl;
+	if (quality.frames > 0)
+	{
+		os << "[stats] quality (" << quality.frames << " sampled frames): PSNR avg " << quality.psnr_avg
+			<< " dB, min " << quality.psnr_min << " dB; SSIM avg " << quality.ssim_avg
+			<< ", min " << quality.ssim_min;
+		if (quality.skipped_windows > 0) os << ", skipped windows: " << quality.skipped_windows;
+		os << std::endl;
+	}
+	if (numa_node >= 0)
+	{
+		os << "[stats] numa node: " << numa_node << std::endl;
+	}
+	for (const auto& event : events)
+	{
+		os << "[stats]   " << event << std::endl;
+	}
+}
@@ -0,0 +1,66 @@
+// xstats.h
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// ڴֽڣ
+struct XMemoryUsage
+{
+	int64_t current{ 0 };
+	int64_t peak{ 0 };
+};
+
+// תȣȻص
+struct XTranscodeProgress
+{
+	int64_t video_frames{ 0 };		// Ƶ֡
+	double media_seconds{ 0 };		// Ѵýʱ䣨㣩
+	double duration_seconds{ 0 };	// Ҫʱ0 ʾδ֪
+	double elapsed_seconds{ 0 };
+	double fps{ 0 };				// һصڵı֡
+	double speed{ 0 };				// ʵʱ٣ýʱ / ʱ
+	double percent{ -1 };			// -1 ʾδ֪
+	double eta_seconds{ -1 };		// Ԥʣʱ䣬-1 ʾδ֪
+};
+
+// Աȣ
+struct XQualityStats
+{
+	int64_t frames{ 0 };			// ֡
+	double psnr_avg{ 0 };			// dBȫƽ
+	double psnr_min{ 0 };
+	double ssim_avg{ 0 };			// 
+	double ssim_min{ 0 };
+	int64_t skipped_windows{ 0 };	// ̻߳ѹĳ
+};
+
+// תͳϢÿ Transcode() ¼
+struct XTranscodeStats
+{
+	int64_t video_frames{ 0 };		// Ƶ֡
+	int64_t audio_frames{ 0 };		// Ƶ֡
+	int64_t duplicate_frames{ 0 };	// ⵽ظ֡Ѷط
+	double elapsed_seconds{ 0 };	// תʱ룩
+	bool cache_hit{ false };		// Ի棬δת
+	bool cancelled{ false };		//  Cancel() ȡ
+
+	// ֡Ͱռõڴ棺׶μϼ
+	XMemoryUsage decode_memory;		// ڻ֡
+	XMemoryUsage encode_memory;		// ڻ֡lookahead ȣ
+	XMemoryUsage mux_memory;		// װеİ
+	XMemoryUsage job_memory;
+	double throttled_seconds{ 0 };	// ڴԤʱͣȡʱ
+	int numa_node{ -1 };			// 󶨵 NUMA ڵ㣬-1 ʾδ
+	XQualityStats quality;			// SetQualityMeter() ʱЧ
+
+	// йеĵ¼ٶȻ˳򱣴
+	std::vector<std::string> events;
+
+	// ¼һͬʱ std::cout
+	void AddEvent(const std::string& event);
+
+	double video_fps() const;
+	void Print(std::ostream& os) const;
+};
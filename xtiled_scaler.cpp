@@ -0,0 +1,167 @@
+// xtiled_scaler.cpp
+#include "xtiled_scaler.h"
+#include <iostream>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+#pragma comment(lib, "swscale.lib")
+
+XTiledScaler::~XTiledScaler()
+{
+	Close();
+}
+
+bool XTiledScaler::Open(int src_width, int src_height, AVPixelFormat src_pix_fmt,
+	int dst_width, int dst_height, AVPixelFormat dst_pix_fmt, int flags, int tiles)
+{
+	if (is_open() && src_width == src_width_ && src_height == src_height_ && src_pix_fmt == src_pix_fmt_ &&
+		dst_width == dst_width_ && dst_height == dst_height_ && dst_pix_fmt == dst_pix_fmt_ &&
+		flags == flags_ && tiles == this->tiles())
+	{
+		return true;
+	}
+	Close();
+	if (tiles < 2) return false;
+
+	SwsContext* first = sws_getContext(src_width, src_height, src_pix_fmt,
+		dst_width, dst_height, dst_pix_fmt, flags, nullptr, nullptr, nullptr);
+	if (!first) return false;
+	contexts_.push_back(first);
+
+	// ߽簴Ҫж루ɫȴֱд߶Ⱦ
+	int align = (int)sws_receive_slice_alignment(first);
+	if (align < 1) align = 1;
+	int band = (dst_height + tiles - 1) / tiles;
+	band = (band + align - 1) / align * align;
+	for (int start = 0; start < dst_height; start += band) band_start_.push_back(start);
+	band_start_.push_back(dst_height);
+	int count = (int)band_start_.size() - 1;
+	if (count < 2)
+	{
+		// ֻֿ̫֡û
+		Close();
+		return false;
+	}
+
+	for (int i = 1; i < count; i++)
+	{
+		SwsContext* ctx = sws_getContext(src_width, src_height, src_pix_fmt,
+			dst_width, dst_height, dst_pix_fmt, flags, nullptr, nullptr, nullptr);
+		if (!ctx)
+		{
+			Close();
+			return false;
+		}
+		contexts_.push_back(ctx);
+	}
+
+	src_width_ = src_width;
+	src_height_ = src_height;
+	src_pix_fmt_ = src_pix_fmt;
+	dst_width_ = dst_width;
+	dst_height_ = dst_height;
+	dst_pix_fmt_ = dst_pix_fmt;
+	flags_ = flags;
+	dst_view_ = av_frame_alloc();
+
+	// ̴߳ 0 飬һפ߳
+	stopping_ = false;
+	generation_ = 0;
+	pending_ = 0;
+	for (int i = 1; i < count; i++)
+	{
+		workers_.emplace_back(&XTiledScaler::WorkerLoop, this, i);
+	}
+	return true;
+}
+
+void XTiledScaler::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stopping_ = true;
+	}
+	work_cv_.notify_all();
+	for (std::thread& t : workers_) t.join();
+	workers_.clear();
+
+	for (SwsContext* ctx : contexts_) sws_freeContext(ctx);
+	contexts_.clear();
+	band_start_.clear();
+	av_frame_free(&dst_view_);
+}
+
+bool XTiledScaler::Scale(const AVFrame* src, AVFrame* dst, uint8_t* const dst_data[4])
+{
+	if (!is_open() || !src || !dst) return false;
+
+	// ͼ dst Ļ壨ݴ˲䣩ָָ
+	av_frame_unref(dst_view_);
+	if (av_frame_ref(dst_view_, dst) < 0) return false;
+	if (dst_data)
+	{
+		for (int i = 0; i < 4; i++) dst_view_->data[i] = dst_data[i];
+	}
+	dst_view_->width = dst_width_;
+	dst_view_->height = dst_height_;
+	src_ = src;
+
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		generation_++;
+		pending_ = (int)workers_.size();
+		failed_ = false;
+	}
+	work_cv_.notify_all();
+
+	bool ok = ScaleTile(0);
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		done_cv_.wait(lock, [this]() { return pending_ == 0; });
+		ok = ok && !failed_;
+	}
+
+	src_ = nullptr;
+	av_frame_unref(dst_view_);
+	if (!ok) std::cerr << "Error: tiled scaling failed!" << std::endl;
+	return ok;
+}
+
+bool XTiledScaler::ScaleTile(int index)
+{
+	SwsContext* ctx = contexts_[index];
+	int start = band_start_[index];
+	int height = band_start_[index + 1] - start;
+	if (sws_frame_start(ctx, dst_view_, src_) < 0) return false;
+	bool ok = sws_send_slice(ctx, 0, src_height_) >= 0 &&
+		sws_receive_slice(ctx, start, height) >= 0;
+	sws_frame_end(ctx);
+	return ok;
+}
+
+void XTiledScaler::WorkerLoop(int index)
+{
+	uint64_t seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			work_cv_.wait(lock, [this, seen]() { return stopping_ || generation_ != seen; });
+			if (stopping_) return;
+			seen = generation_;
+		}
+
+		bool ok = ScaleTile(index);
+
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (!ok) failed_ = true;
+			last = (--pending_ == 0);
+		}
+		if (last) done_cv_.notify_one();
+	}
+}
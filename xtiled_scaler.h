@@ -0,0 +1,67 @@
+// xtiled_scaler.h
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+struct AVFrame;
+struct SwsContext;
+
+/**
+ * @brief ֿ鲢ţ水дֳ tiles 飬ÿһ߳Լ SwsContext 
+ *
+ * 鶼ȡ֡루sws_send_sliceֻԼдsws_receive_slice
+ * ֱ˲߽ȡУ֮ûнӷ졣ֱдĿ֡м֡
+ * ÿڴֻпл壬ֿȣ滭߶
+ * ̴߳ 0 飬ɳפ̴߳Scale() ʱ֡ɡ
+ */
+class XTiledScaler
+{
+public:
+	~XTiledScaler();
+
+	// Ѵ򿪵ͬʱãҪ֡޷дʱ false
+	bool Open(int src_width, int src_height, AVPixelFormat src_pix_fmt,
+		int dst_width, int dst_height, AVPixelFormat dst_pix_fmt, int flags, int tiles);
+	void Close();
+	bool is_open() const { return !contexts_.empty(); }
+	int tiles() const { return (int)contexts_.size(); }
+
+	// ֡dst ṩ壬dst_data ΪʱΪ dst еʼַʱ
+	bool Scale(const AVFrame* src, AVFrame* dst, uint8_t* const dst_data[4] = nullptr);
+
+private:
+	bool ScaleTile(int index);
+	void WorkerLoop(int index);
+
+private:
+	std::vector<SwsContext*> contexts_;
+	std::vector<int> band_start_;		// ʼУһΪ߶ȣ
+
+	int src_width_{ 0 };
+	int src_height_{ 0 };
+	AVPixelFormat src_pix_fmt_{ AV_PIX_FMT_NONE };
+	int dst_width_{ 0 };
+	int dst_height_{ 0 };
+	AVPixelFormat dst_pix_fmt_{ AV_PIX_FMT_NONE };
+	int flags_{ 0 };
+
+	// ǰ֡Scale() ڼЧ
+	const AVFrame* src_{ nullptr };
+	AVFrame* dst_view_{ nullptr };		//  dst Ļ壬ָָ
+
+	std::vector<std::thread> workers_;
+	std::mutex mtx_;
+	std::condition_variable work_cv_;
+	std::condition_variable done_cv_;
+	uint64_t generation_{ 0 };			// ÿ֡һ߳̾ݴ˿ʼ
+	int pending_{ 0 };					// δɵĹ߳̿
+	bool failed_{ false };
+	bool stopping_{ false };
+};
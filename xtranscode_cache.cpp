@@ -0,0 +1,324 @@
+// xtranscode_cache.cpp
+#include "xtranscode_cache.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// ʽ 64 λϣXXH64 㷨·ۼӣٶȽӽڴ
+class XHash64
+{
+public:
+	explicit XHash64(uint64_t seed = 0)
+	{
+		v_[0] = seed + kP1 + kP2;
+		v_[1] = seed + kP2;
+		v_[2] = seed;
+		v_[3] = seed - kP1;
+		seed_ = seed;
+	}
+
+	void Update(const uint8_t* data, size_t size)
+	{
+		total_ += size;
+		// ȲϴʣµĲ 32 ֽڵĲ
+		if (buffered_ > 0)
+		{
+			size_t n = 32 - buffered_;
+			if (n > size) n = size;
+			memcpy(buffer_ + buffered_, data, n);
+			buffered_ += n;
+			data += n;
+			size -= n;
+			if (buffered_ < 32) return;
+			Stripe(buffer_);
+			buffered_ = 0;
+		}
+		while (size >= 32)
+		{
+			Stripe(data);
+			data += 32;
+			size -= 32;
+		}
+		if (size > 0)
+		{
+			memcpy(buffer_, data, size);
+			buffered_ = size;
+		}
+	}
+
+	uint64_t Final() const
+	{
+		uint64_t h;
+		if (total_ >= 32)
+		{
+			h = Rotl(v_[0], 1) + Rotl(v_[1], 7) + Rotl(v_[2], 12) + Rotl(v_[3], 18);
+			for (int i = 0; i < 4; i++)
+			{
+				h ^= Round(0, v_[i]);
+				h = h * kP1 + kP4;
+			}
+		}
+		else
+		{
+			h = seed_ + kP5;
+		}
+		h += total_;
+
+		const uint8_t* p = buffer_;
+		size_t left = buffered_;
+		while (left >= 8)
+		{
+			h ^= Round(0, Read64(p));
+			h = Rotl(h, 27) * kP1 + kP4;
+			p += 8;
+			left -= 8;
+		}
+		if (left >= 4)
+		{
+			uint32_t k;
+			memcpy(&k, p, 4);
+			h ^= (uint64_t)k * kP1;
+			h = Rotl(h, 23) * kP2 + kP3;
+			p += 4;
+			left -= 4;
+		}
+		while (left > 0)
+		{
+			h ^= (*p) * kP5;
+			h = Rotl(h, 11) * kP1;
+			p++;
+			left--;
+		}
+
+		h ^= h >> 33;
+		h *= kP2;
+		h ^= h >> 29;
+		h *= kP3;
+		h ^= h >> 32;
+		return h;
+	}
+
+private:
+	static const uint64_t kP1 = 11400714785074694791ULL;
+	static const uint64_t kP2 = 14029467366897019727ULL;
+	static const uint64_t kP3 = 1609587929392839161ULL;
+	static const uint64_t kP4 = 9650029242287828579ULL;
+	static const uint64_t kP5 = 2870177450012600261ULL;
+
+	static uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	static uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+	static uint64_t Round(uint64_t acc, uint64_t input)
+	{
+		acc += input * kP2;
+		acc = Rotl(acc, 31);
+		return acc * kP1;
+	}
+	void Stripe(const uint8_t* p)
+	{
+		v_[0] = Round(v_[0], Read64(p));
+		v_[1] = Round(v_[1], Read64(p + 8));
+		v_[2] = Round(v_[2], Read64(p + 16));
+		v_[3] = Round(v_[3], Read64(p + 24));
+	}
+
+	uint64_t v_[4];
+	uint64_t seed_{ 0 };
+	uint64_t total_{ 0 };
+	uint8_t buffer_[32];
+	size_t buffered_{ 0 };
+};
+
+static std::string ToHex(uint64_t value)
+{
+	char buff[17];
+	snprintf(buff, sizeof(buff), "%016llx", (unsigned long long)value);
+	return buff;
+}
+
+bool XTranscodeCache::Open(const std::string& dir, int64_t max_bytes)
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	std::error_code ec;
+	fs::create_directories(dir, ec);
+	if (!fs::is_directory(dir, ec))
+	{
+		std::cerr << "Error: Cannot create cache directory '" << dir << "'" << std::endl;
+		return false;
+	}
+	dir_ = dir;
+	max_bytes_ = max_bytes;
+	LoadIndex();
+	Evict();
+	return true;
+}
+
+std::string XTranscodeCache::MakeKey(const std::string& input_file, const std::string& params)
+{
+	std::ifstream ifs(input_file, std::ios::binary);
+	if (!ifs) return "";
+
+	XHash64 content_hash;
+	std::vector<char> buffer(1 << 20);
+	while (ifs)
+	{
+		ifs.read(buffer.data(), buffer.size());
+		std::streamsize n = ifs.gcount();
+		if (n <= 0) break;
+		content_hash.Update((const uint8_t*)buffer.data(), (size_t)n);
+	}
+	if (ifs.bad()) return "";
+
+	XHash64 params_hash;
+	params_hash.Update((const uint8_t*)params.data(), params.size());
+	return ToHex(content_hash.Final()) + ToHex(params_hash.Final());
+}
+
+bool XTranscodeCache::Fetch(const std::string& key, const std::string& output_file)
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	if (dir_.empty()) return false;
+	// 벻ɶʱΪգͬΪδ
+	if (key.empty())
+	{
+		misses_++;
+		return false;
+	}
+
+	auto it = entries_.find(key);
+	if (it == entries_.end() || !fs::exists(fs::path(dir_) / it->second.file))
+	{
+		if (it != entries_.end())
+		{
+			// ļⲿɾĿ
+			total_bytes_ -= it->second.size;
+			entries_.erase(it);
+			SaveIndex();
+		}
+		misses_++;
+		return false;
+	}
+
+	if (!LinkOrCopy((fs::path(dir_) / it->second.file).string(), output_file))
+	{
+		misses_++;
+		return false;
+	}
+	it->second.last_used = ++tick_;
+	hits_++;
+	SaveIndex();
+	return true;
+}
+
+bool XTranscodeCache::Store(const std::string& key, const std::string& output_file)
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	if (dir_.empty() || key.empty()) return false;
+
+	std::error_code ec;
+	int64_t size = (int64_t)fs::file_size(output_file, ec);
+	if (ec) return false;
+	if (max_bytes_ > 0 && size > max_bytes_) return false;	// ޣ
+
+	Entry entry;
+	entry.size = size;
+	entry.last_used = ++tick_;
+	entry.file = key + fs::path(output_file).extension().string();
+	std::string cache_file = (fs::path(dir_) / entry.file).string();
+	fs::remove(cache_file, ec);
+	if (!LinkOrCopy(output_file, cache_file)) return false;
+
+	auto it = entries_.find(key);
+	if (it != entries_.end()) total_bytes_ -= it->second.size;
+	entries_[key] = entry;
+	total_bytes_ += size;
+
+	Evict();
+	SaveIndex();
+	return true;
+}
+
+void XTranscodeCache::Evict()
+{
+	while (max_bytes_ > 0 && total_bytes_ > max_bytes_ && !entries_.empty())
+	{
+		auto oldest = entries_.begin();
+		for (auto it = entries_.begin(); it != entries_.end(); ++it)
+		{
+			if (it->second.last_used < oldest->second.last_used) oldest = it;
+		}
+		std::error_code ec;
+		fs::remove(fs::path(dir_) / oldest->second.file, ec);
+		total_bytes_ -= oldest->second.size;
+		entries_.erase(oldest);
+		evictions_++;
+	}
+}
+
+bool XTranscodeCache::LinkOrCopy(const std::string& src, const std::string& dst)
+{
+	std::error_code ec;
+	// ɾĿ꣺ĿһĿӲӣֱӸдĻ
+	fs::remove(dst, ec);
+	fs::create_hard_link(src, dst, ec);
+	if (!ec) return true;
+
+	ec.clear();
+	fs::copy_file(src, dst, fs::copy_options::overwrite_existing, ec);
+	if (ec)
+	{
+		std::cerr << "Error: cache copy '" << src << "' -> '" << dst << "' failed: " << ec.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool XTranscodeCache::LoadIndex()
+{
+	entries_.clear();
+	total_bytes_ = 0;
+	tick_ = 0;
+
+	std::ifstream ifs(fs::path(dir_) / "index.txt");
+	if (!ifs) return false;
+
+	// ÿУ С ʹ ļ
+	std::string line;
+	while (std::getline(ifs, line))
+	{
+		std::istringstream iss(line);
+		std::string key;
+		Entry entry;
+		if (!(iss >> key >> entry.size >> entry.last_used >> entry.file)) continue;
+		std::error_code ec;
+		if (!fs::exists(fs::path(dir_) / entry.file, ec)) continue;
+		entries_[key] = entry;
+		total_bytes_ += entry.size;
+		if (entry.last_used > tick_) tick_ = entry.last_used;
+	}
+	return true;
+}
+
+bool XTranscodeCache::SaveIndex()
+{
+	fs::path index_path = fs::path(dir_) / "index.txt";
+	fs::path tmp_path = fs::path(dir_) / "index.txt.tmp";
+	{
+		std::ofstream ofs(tmp_path, std::ios::trunc);
+		if (!ofs) return false;
+		for (const auto& kv : entries_)
+		{
+			ofs << kv.first << " " << kv.second.size << " "
+				<< kv.second.last_used << " " << kv.second.file << "\n";
+		}
+		if (!ofs) return false;
+	}
+	std::error_code ec;
+	fs::rename(tmp_path, index_path, ec);
+	return !ec;
+}
@@ -0,0 +1,58 @@
+// xtranscode_cache.h
+#pragma once
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * @brief ת棺ݹϣ + Ϊʱֱ/ϴε
+ *
+ * Ŀ¼ÿĿһļindex.txt ¼ĿСʹţ
+ * ܴСʱʹãLRṶתԹͬһ
+ */
+class XTranscodeCache
+{
+public:
+	// dirĿ¼򴴽max_bytesܴС
+	bool Open(const std::string& dir, int64_t max_bytes);
+
+	// 㻺ļݵ 64 λϣ + ַĹϣȡʧܷؿմ
+	std::string MakeKey(const std::string& input_file, const std::string& params);
+
+	// ʱӲӣ豸ʱƣ output_file true
+	bool Fetch(const std::string& key, const std::string& output_file);
+
+	// תɹ뻺棬 LRU ̭޵Ŀ
+	bool Store(const std::string& key, const std::string& output_file);
+
+	int64_t hits() { std::lock_guard<std::mutex> lock(mtx_); return hits_; }
+	int64_t misses() { std::lock_guard<std::mutex> lock(mtx_); return misses_; }
+	int64_t evictions() { std::lock_guard<std::mutex> lock(mtx_); return evictions_; }
+	int64_t total_bytes() { std::lock_guard<std::mutex> lock(mtx_); return total_bytes_; }
+
+private:
+	struct Entry {
+		int64_t size{ 0 };
+		uint64_t last_used{ 0 };	// ʹţԽԽ
+		std::string file;			// Ŀ¼еļ
+	};
+
+	bool LoadIndex();
+	bool SaveIndex();
+	void Evict();
+	// Ӳ src  dstʧʱ
+	static bool LinkOrCopy(const std::string& src, const std::string& dst);
+
+private:
+	std::string dir_;
+	int64_t max_bytes_{ 0 };
+	std::map<std::string, Entry> entries_;
+	int64_t total_bytes_{ 0 };
+	uint64_t tick_{ 0 };
+
+	int64_t hits_{ 0 };
+	int64_t misses_{ 0 };
+	int64_t evictions_{ 0 };
+	std::mutex mtx_;
+};
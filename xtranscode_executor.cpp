@@ -0,0 +1,171 @@
+// xtranscode_executor.cpp
+#include "xtranscode_executor.h"
+#include "xfile_transcoder.h"
+
+void XTranscodeTask::Cancel()
+{
+	cancel_requested_ = true;
+	std::lock_guard<std::mutex> lock(mtx_);
+	if (transcoder_) transcoder_->Cancel();
+}
+
+XTranscodeExecutor::XTranscodeExecutor(int threads)
+{
+	if (threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency() / 2;
+		if (threads <= 0) threads = 1;
+	}
+	for (int i = 0; i < threads; i++)
+	{
+		workers_.emplace_back(&XTranscodeExecutor::WorkerLoop, this);
+	}
+}
+
+XTranscodeExecutor::~XTranscodeExecutor()
+{
+	Shutdown();
+}
+
+void XTranscodeExecutor::SetPoster(std::function<void(std::function<void()>)> poster)
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	poster_ = poster;
+}
+
+std::shared_ptr<XTranscodeTask> XTranscodeExecutor::Submit(
+	XTranscodeJob job,
+	std::function<void(const XTranscodeResult&)> on_complete,
+	std::function<void(const XTranscodeProgress&)> on_progress,
+	int progress_interval_ms)
+{
+	auto task = std::make_shared<XTranscodeTask>();
+	task->job_ = std::move(job);
+	task->on_complete_ = on_complete;
+	task->on_progress_ = on_progress;
+	task->progress_interval_ms_ = progress_interval_ms;
+	task->future_ = task->promise_.get_future().share();
+
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (!stopping_)
+		{
+			queue_.push_back(task);
+			cv_.notify_one();
+			return task;
+		}
+	}
+	// ѹرգֱȡ
+	XTranscodeResult result;
+	result.cancelled = true;
+	Complete(task, result);
+	return task;
+}
+
+size_t XTranscodeExecutor::pending() const
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	return queue_.size();
+}
+
+void XTranscodeExecutor::Shutdown()
+{
+	std::deque<std::shared_ptr<XTranscodeTask>> cancelled;
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stopping_ = true;
+		cancelled.swap(queue_);
+	}
+	cv_.notify_all();
+	for (auto& task : cancelled)
+	{
+		XTranscodeResult result;
+		result.cancelled = true;
+		Complete(task, result);
+	}
+	for (auto& worker : workers_)
+	{
+		if (worker.joinable()) worker.join();
+	}
+	workers_.clear();
+}
+
+void XTranscodeExecutor::WorkerLoop()
+{
+	while (true)
+	{
+		std::shared_ptr<XTranscodeTask> task;
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+			if (queue_.empty()) return;
+			task = queue_.front();
+			queue_.pop_front();
+		}
+		Run(task);
+	}
+}
+
+void XTranscodeExecutor::Run(const std::shared_ptr<XTranscodeTask>& task)
+{
+	XTranscodeResult result;
+	if (task->cancel_requested_)
+	{
+		result.cancelled = true;
+		Complete(task, result);
+		return;
+	}
+
+	running_++;
+	XFileTranscoder transcoder;
+	if (task->job_.configure) task->job_.configure(transcoder);
+	// Transcode() ʼʱȡ־Ǽתõ֮ Cancel() ɽȻص
+	std::weak_ptr<XTranscodeTask> weak = task;
+	XFileTranscoder* self = &transcoder;
+	transcoder.SetProgressCallback([this, weak, self](const XTranscodeProgress& progress) {
+		auto task = weak.lock();
+		if (!task) return;
+		if (task->cancel_requested_) self->Cancel();
+		// ȰֵͶݣת̲߳ȴصִ
+		if (task->on_progress_) Post([task, progress]() { task->on_progress_(progress); });
+	}, task->progress_interval_ms_);
+	{
+		std::lock_guard<std::mutex> lock(task->mtx_);
+		task->transcoder_ = &transcoder;
+	}
+
+	const XTranscodeJob& job = task->job_;
+	result.ok = transcoder.Transcode(job.input_file, job.output_file,
+		job.output_width, job.output_height, job.output_codec_id,
+		job.bitrate_kbps, job.fps);
+
+	{
+		std::lock_guard<std::mutex> lock(task->mtx_);
+		task->transcoder_ = nullptr;
+	}
+	result.stats = transcoder.GetStats();
+	result.cancelled = result.stats.cancelled;
+	running_--;
+	Complete(task, result);
+}
+
+void XTranscodeExecutor::Complete(const std::shared_ptr<XTranscodeTask>& task, XTranscodeResult result)
+{
+	task->done_ = true;
+	task->promise_.set_value(result);
+	if (task->on_complete_)
+	{
+		Post([task, result]() { task->on_complete_(result); });
+	}
+}
+
+void XTranscodeExecutor::Post(std::function<void()> fn)
+{
+	std::function<void(std::function<void()>)> poster;
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		poster = poster_;
+	}
+	if (poster) poster(std::move(fn));
+	else fn();
+}
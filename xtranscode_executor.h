@@ -0,0 +1,122 @@
+// xtranscode_executor.h
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "xstats.h"
+
+extern "C" {
+#include <libavcodec/codec_id.h>
+}
+
+class XFileTranscoder;
+
+// һתĲ XFileTranscoder::Transcode() Ӧ
+struct XTranscodeJob
+{
+	std::string input_file;
+	std::string output_file;
+	int output_width{ 0 };
+	int output_height{ 0 };
+	AVCodecID output_codec_id{ AV_CODEC_ID_H264 };
+	int bitrate_kbps{ 2000 };
+	int fps{ 25 };
+	// Transcode() ǰתãֶƵȣڹ߳е
+	std::function<void(XFileTranscoder&)> configure;
+};
+
+struct XTranscodeResult
+{
+	bool ok{ false };
+	bool cancelled{ false };
+	XTranscodeStats stats;
+};
+
+/**
+ * @brief ύľѯ״̬ȴȡ
+ */
+class XTranscodeTask
+{
+public:
+	// ɡʧܻȡʱ
+	std::shared_future<XTranscodeResult> future() const { return future_; }
+	bool done() const { return done_; }
+	// ŶеִУеһ֡ǰֹͣ
+	void Cancel();
+
+private:
+	friend class XTranscodeExecutor;
+
+	XTranscodeJob job_;
+	std::function<void(const XTranscodeResult&)> on_complete_;
+	std::function<void(const XTranscodeProgress&)> on_progress_;
+	int progress_interval_ms_{ 500 };
+
+	std::promise<XTranscodeResult> promise_;
+	std::shared_future<XTranscodeResult> future_;
+	std::atomic<bool> cancel_requested_{ false };
+	std::atomic<bool> done_{ false };
+	std::mutex mtx_;
+	XFileTranscoder* transcoder_{ nullptr };	// ʱЧ
+};
+
+/**
+ * @brief 첽תִŶӣɹ̶Ĺִ߳
+ *
+ * ÷ҪΪÿռһ̣߳ŶӵֻǶеһͬʱύǧ
+ * ͨ std::shared_future ȡͨ/Ȼص֪ͨ
+ *  poster ص poster Ͷݵ÷¼ѭִ߳Уڹֱ߳ӵá
+ *
+ * ʹʾ
+ * @code
+ * XTranscodeExecutor executor(4);
+ * executor.SetPoster([&loop](std::function<void()> fn) { loop.post(std::move(fn)); });
+ * auto task = executor.Submit(job, [](const XTranscodeResult& r) { ... });
+ * @endcode
+ */
+class XTranscodeExecutor
+{
+public:
+	// threads Ϊͬʱе<= 0 ʱȡ CPU һ루ÿڲб̣߳
+	explicit XTranscodeExecutor(int threads = 0);
+	// ȡŶе񣬵ȴе
+	~XTranscodeExecutor();
+
+	void SetPoster(std::function<void(std::function<void()>)> poster);
+
+	std::shared_ptr<XTranscodeTask> Submit(
+		XTranscodeJob job,
+		std::function<void(const XTranscodeResult&)> on_complete = nullptr,
+		std::function<void(const XTranscodeProgress&)> on_progress = nullptr,
+		int progress_interval_ms = 500
+	);
+
+	size_t pending() const;
+	int running() const { return running_; }
+
+	// ٽȡŶе񣬵ȴ߳˳
+	void Shutdown();
+
+private:
+	void WorkerLoop();
+	void Run(const std::shared_ptr<XTranscodeTask>& task);
+	// ýɻص
+	void Complete(const std::shared_ptr<XTranscodeTask>& task, XTranscodeResult result);
+	void Post(std::function<void()> fn);
+
+private:
+	std::vector<std::thread> workers_;
+	std::deque<std::shared_ptr<XTranscodeTask>> queue_;
+	mutable std::mutex mtx_;
+	std::condition_variable cv_;
+	bool stopping_{ false };
+	std::atomic<int> running_{ 0 };
+	std::function<void(std::function<void()>)> poster_;
+};